@@ -0,0 +1,10 @@
+#pragma once
+
+#include "harness.h"
+
+// Stateless decode and execute handlers of every instruction class
+void runInstructionBenchmarks(bench::harness& harness);
+// Unrolled guest programs and single opcode streams run by every execution
+// mode, reports guest MIPS, TSC ticks, host hardware counters and peak RSS
+// per case, counters are divided by retired guest instructions
+void runWorkloadBenchmarks(bench::harness& harness, const double minTime);
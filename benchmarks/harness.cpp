@@ -0,0 +1,80 @@
+#include <ctime>
+#include <thread>
+#include <iomanip>
+
+#include "harness.h"
+
+namespace bench {
+
+namespace {
+
+std::string escape(const std::string& text)
+{
+    std::string escaped;
+    for (char symbol : text) {
+        if (symbol == '"' || symbol == '\\')
+            escaped += '\\';
+        escaped += symbol;
+    }
+    return escaped;
+}
+
+}
+
+harness::harness(const std::string& _filter, const double _minTime, const std::uint32_t _repetitions) :
+    filter(_filter), minTime(_minTime), repetitions(std::max<std::uint32_t>(_repetitions, 1)) {}
+
+void harness::add(const result& caseResult)
+{
+    if (isSelected(caseResult.name))
+        results.push_back(caseResult);
+}
+
+void harness::writeJson(std::ostream& out) const
+{
+    char date[32] = {};
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n    \"num_cpus\": "
+        << std::thread::hardware_concurrency() << ",\n    \"library_build_type\": \""
+#ifdef NDEBUG
+        << "release"
+#else
+        << "debug"
+#endif
+        << "\"\n  },\n  \"benchmarks\": [";
+    const char* separator = "";
+    for (const result& current : results) {
+        out << separator << "\n    {\n      \"name\": \"" << escape(current.name) << "\",\n      \"run_type\": \"iteration\""
+            << ",\n      \"iterations\": " << current.iterations
+            << ",\n      \"real_time\": " << current.nsPerOp << ",\n      \"cpu_time\": " << current.nsPerOp
+            << ",\n      \"min_time\": " << current.minNsPerOp << ",\n      \"time_unit\": \"ns\"";
+        for (const counter& extra : current.counters)
+            out << ",\n      \"" << escape(extra.name) << "\": " << extra.value;
+        out << "\n    }";
+        separator = ",";
+    }
+    out << "\n  ]\n}\n";
+}
+
+void harness::writeText(std::ostream& out) const
+{
+    std::size_t nameWidth = 10;
+    for (const result& current : results)
+        nameWidth = std::max(nameWidth, current.name.size());
+
+    out << std::left << std::setw(nameWidth + 2) << "benchmark" << std::right << std::setw(12) << "ns/op"
+        << std::setw(12) << "min ns/op" << std::setw(14) << "iterations" << '\n';
+    for (const result& current : results) {
+        out << std::left << std::setw(nameWidth + 2) << current.name << std::right << std::fixed << std::setprecision(2)
+            << std::setw(12) << current.nsPerOp << std::setw(12) << current.minNsPerOp
+            << std::setw(14) << current.iterations;
+        for (const counter& extra : current.counters)
+            out << "  " << extra.name << '=' << extra.value;
+        out << '\n';
+    }
+    out.unsetf(std::ios::floatfield);
+}
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <algorithm>
+
+// Self-contained timing harness. Case body is called in a loop, iterations
+// count is calibrated so one repetition takes at least minTime, reported
+// time is median of repetitions. JSON output uses field names of Google
+// Benchmark, so its compare tools can diff two runs, cpu_time repeats
+// wall clock real_time.
+namespace bench {
+
+// Keeps value and everything it depends on from being optimized away
+template <typename T>
+inline void doNotOptimize(T&& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct counter {
+    std::string name;
+    double value;
+};
+
+struct result {
+    std::string name;
+    std::uint64_t iterations;
+    double nsPerOp;     // median of repetitions
+    double minNsPerOp;
+    std::vector<counter> counters;
+};
+
+class harness {
+public:
+    harness(const std::string& _filter = "", const double _minTime = 0.05, const std::uint32_t _repetitions = 5);
+
+    // Skips cases which names do not contain filter
+    inline bool isSelected(const std::string& name) const { return name.find(filter) != std::string::npos; }
+
+    template <typename Body>
+    void run(const std::string& name, Body body);
+    // Case measured by caller, for workloads which are too long to repeat
+    void add(const result& caseResult);
+
+    void writeJson(std::ostream& out) const;
+    void writeText(std::ostream& out) const;
+    inline const std::vector<result>& getResults() const { return results; }
+private:
+    template <typename Body>
+    double measure(Body& body, const std::uint64_t iterations);
+
+    const std::string filter;
+    const double minTime; // in seconds
+    const std::uint32_t repetitions;
+    std::vector<result> results;
+};
+
+template <typename Body>
+double harness::measure(Body& body, const std::uint64_t iterations)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (std::uint64_t iteration = 0; iteration < iterations; ++iteration)
+        body();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename Body>
+void harness::run(const std::string& name, Body body)
+{
+    if (!isSelected(name))
+        return;
+
+    std::uint64_t iterations = 1;
+    double seconds = measure(body, iterations);
+    while (seconds < minTime && iterations < (1ull << 40)) {
+        const double scale = seconds > 0 ? std::min(10.0, 1.4 * minTime / seconds) : 10.0;
+        iterations = std::max<std::uint64_t>(iterations + 1, iterations * scale);
+        seconds = measure(body, iterations);
+    }
+
+    std::vector<double> samples(1, seconds);
+    for (std::uint32_t repetition = 1; repetition < repetitions; ++repetition)
+        samples.push_back(measure(body, iterations));
+    std::sort(samples.begin(), samples.end());
+    add({ name, iterations, samples[samples.size() / 2] * 1e9 / iterations, samples.front() * 1e9 / iterations, {} });
+}
+
+}
@@ -0,0 +1,97 @@
+#include <memory>
+
+#include "benchmarks.h"
+#include "instructions.h"
+
+namespace {
+
+using namespace instructions;
+
+template <typename Instruction>
+constexpr decode_handler makeDecoder()
+{
+    return Instruction::template decode<cpu_base_properties>;
+}
+
+// Form of instruction and register values it is measured with. Source and
+// base registers are never destination, so every iteration takes the same path.
+struct instruction_case {
+    const char* name;
+    decode_handler decoder;
+    cpu_register_t instruction;
+    cpu_register_t sourceValue; // value of register 1
+};
+
+class instruction_fixture {
+public:
+    instruction_fixture(const instruction_case& testCase) :
+        memory(new std::uint8_t[maxSupportedMemory]{}), registers(new cpu_register_t[properties.registersCount + vectorBankWords]{}),
+        memoryView(memory.get(), maxSupportedMemory), decoder(testCase.decoder), instruction(testCase.instruction)
+    {
+        registers[0] = 0x1234;
+        registers[1] = testCase.sourceValue;
+    }
+
+    inline decoded_instruction decode() const { return decoder(instruction, properties); }
+    inline status execute(const decoded_instruction& operands)
+    {
+        return operands.handler(operands, registers.get(), memoryView, properties);
+    }
+private:
+    const cpu_base_properties properties;
+    std::unique_ptr<std::uint8_t[]> memory;
+    std::unique_ptr<cpu_register_t[]> registers;
+    guest_memory memoryView;
+    const decode_handler decoder;
+    const cpu_register_t instruction;
+};
+
+const instruction_case cases[] = {
+    { "ld", makeDecoder<load>(), 0b0000'0000'0100'0010, 0x100 },                       // ld r0, [r1 + 2]
+    { "ld/near_end", makeDecoder<load>(), 0b0000'0000'0100'0010, 0xfffc },             // last whole word
+    { "ld/last_byte", makeDecoder<load>(), 0b0000'0000'0100'0010, 0xfffd },            // LAST_MEMORY_BYTE_WARNING
+    { "ld/out_of_memory", makeDecoder<load>(), 0b0000'0000'0100'0010, 0xffff },        // OUT_OF_MEMORY_ERROR
+    { "st", makeDecoder<store>(), 0b0001'0010'0000'0010, 0x100 },                      // st [r1 + 2], r0
+    { "st/near_end", makeDecoder<store>(), 0b0001'0010'0000'0010, 0xfffc },
+    { "st/last_byte", makeDecoder<store>(), 0b0001'0010'0000'0010, 0xfffd },
+    { "st/out_of_memory", makeDecoder<store>(), 0b0001'0010'0000'0010, 0xffff },
+    { "ldi/lower", makeDecoder<load_immediate>(), 0b0010'0000'0101'1010, 0 },
+    { "ldi/upper", makeDecoder<load_immediate>(), 0b0010'0001'0101'1010, 0 },
+    { "add/register", makeDecoder<addition>(), 0b0011'0000'0010'0000, 3 },             // add r0, r1
+    { "add/immediate", makeDecoder<addition>(), 0b0011'1000'0000'0011, 0 },            // add r0, 3
+    { "sub/register", makeDecoder<subtraction>(), 0b0100'0000'0010'0000, 3 },
+    { "sub/immediate", makeDecoder<subtraction>(), 0b0100'1000'0000'0011, 0 },
+    { "mul/register", makeDecoder<multiplication>(), 0b0101'0000'0010'0000, 3 },
+    { "mul/immediate", makeDecoder<multiplication>(), 0b0101'1000'0000'0011, 0 },
+    { "srl/register", makeDecoder<shift_right_logical>(), 0b0110'0000'0010'0000, 3 },
+    { "srl/immediate", makeDecoder<shift_right_logical>(), 0b0110'1000'0000'0011, 0 },
+    { "srl/invalid_amount", makeDecoder<shift_right_logical>(), 0b0110'1000'0001'0001, 0 }, // shift by 17
+    { "sll/register", makeDecoder<shift_left_logical>(), 0b0111'0000'0010'0000, 3 },
+    { "sll/immediate", makeDecoder<shift_left_logical>(), 0b0111'1000'0000'0011, 0 },
+    { "not", makeDecoder<bitwise_not>(), 0b1000'0000'0000'0000, 0 },
+    { "and", makeDecoder<bitwise_and>(), 0b1001'0000'0100'0000, 0xff0f },             // and r0, r1
+    { "or", makeDecoder<bitwise_or>(), 0b1010'0000'0100'0000, 0x00f0 },
+    { "xor", makeDecoder<bitwise_xor>(), 0b1011'0000'0100'0000, 0x5555 },
+    { "vadd", makeDecoder<return_from_call>(), 0b1111'0001'0000'0010, 0 },            // vadd v0, v1
+    { "vcmpeq", makeDecoder<return_from_call>(), 0b1111'0001'1010'0010, 0 },
+    { "vld", makeDecoder<return_from_call>(), 0b1111'0011'1100'0000, 0x100 },         // vld v0, [r1]
+    { "vst", makeDecoder<return_from_call>(), 0b1111'0011'1110'0000, 0x100 },         // vst [r1], v0
+};
+
+}
+
+void runInstructionBenchmarks(bench::harness& harness)
+{
+    for (const instruction_case& testCase : cases) {
+        instruction_fixture fixture(testCase);
+
+        harness.run(std::string("decode/") + testCase.name, [&fixture]() {
+            bench::doNotOptimize(fixture.decode());
+        });
+
+        const decoded_instruction operands = fixture.decode();
+        harness.run(std::string("execute/") + testCase.name, [&fixture, &operands]() {
+            bench::doNotOptimize(fixture.execute(operands));
+        });
+    }
+}
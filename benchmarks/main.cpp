@@ -0,0 +1,54 @@
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#include "benchmarks.h"
+
+// Options: --filter=<substring> --min-time=<seconds> --repetitions=<count>
+// --json=<path>, JSON goes to stdout if path is "-"
+int main(int argc, char** argv)
+{
+    std::string filter;
+    std::string jsonPath;
+    double minTime = 0.05;
+    std::uint32_t repetitions = 5;
+    for (int index = 1; index < argc; ++index) {
+        const std::string argument = argv[index];
+        const std::size_t split = argument.find('=');
+        const std::string option = argument.substr(0, split);
+        const std::string value = split == std::string::npos ? "" : argument.substr(split + 1);
+        if (option == "--filter")
+            filter = value;
+        else if (option == "--min-time")
+            minTime = std::atof(value.c_str());
+        else if (option == "--repetitions")
+            repetitions = std::atoi(value.c_str());
+        else if (option == "--json")
+            jsonPath = value;
+        else {
+            std::cerr << "Unknown option " << argument << std::endl;
+            return 1;
+        }
+    }
+
+    bench::harness harness(filter, minTime, repetitions);
+    runInstructionBenchmarks(harness);
+    runWorkloadBenchmarks(harness, std::max(minTime, 0.2));
+
+    if (jsonPath == "-") {
+        harness.writeJson(std::cout);
+        return 0;
+    }
+    harness.writeText(std::cout);
+    if (!jsonPath.empty()) {
+        std::ofstream file(jsonPath);
+        harness.writeJson(file);
+        if (!file) {
+            std::cerr << "Can not write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
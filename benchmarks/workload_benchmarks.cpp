@@ -0,0 +1,478 @@
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <numeric>
+#include <filesystem>
+#include <functional>
+
+#if defined(__unix__)
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#define WORKLOAD_ISOLATION
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define WORKLOAD_TSC
+#endif
+
+#include "benchmarks.h"
+#include "cpu.h"
+#include "batch_cpu.h"
+#include "perf_counters.h"
+
+namespace {
+
+// Encoders of guest instructions, offsets and immediates are truncated to
+// their fields
+namespace encode {
+
+enum opcode : cpu_register_t { LD = 0, ST, LDI, ADD, SUB, MUL, SRL, SLL, NOT, AND, OR, XOR };
+
+constexpr cpu_register_t ld(const cpu_register_t dst, const cpu_register_t base, const int offset)
+{
+    return LD << 12 | dst << 9 | base << 6 | (offset & 0x3f);
+}
+constexpr cpu_register_t st(const cpu_register_t base, const cpu_register_t src, const int offset)
+{
+    return ST << 12 | base << 9 | src << 6 | (offset & 0x3f);
+}
+constexpr cpu_register_t ldi(const cpu_register_t dst, const bool isUpper, const cpu_register_t value)
+{
+    return LDI << 12 | dst << 9 | isUpper << 8 | (value & 0xff);
+}
+constexpr cpu_register_t math(const opcode op, const cpu_register_t dst, const cpu_register_t src)
+{
+    return op << 12 | dst << 8 | src << 5;
+}
+constexpr cpu_register_t mathImmediate(const opcode op, const cpu_register_t dst, const int value)
+{
+    return op << 12 | 1 << 11 | dst << 8 | (value & 0xff);
+}
+constexpr cpu_register_t bitwise(const opcode op, const cpu_register_t dst, const cpu_register_t src)
+{
+    return op << 12 | dst << 9 | src << 6;
+}
+
+}
+
+constexpr std::uint32_t dataAddress = 0x8000;
+constexpr std::uint32_t secondDataAddress = 0xc000;
+
+// Loops are unrolled into straight code which fills memory below
+// dataAddress, so instructions count of a pass is known without running it. One pass runs the whole code once, prologue
+// resets registers, so passes can be repeated.
+class workload {
+public:
+    workload(const std::string& _name) : name(_name), image(maxSupportedMemory) {}
+
+    inline void emit(const cpu_register_t instruction) { code.push_back(instruction); }
+    void setRegister(const cpu_register_t index, const cpu_register_t value)
+    {
+        emit(encode::ldi(index, false, value));
+        emit(encode::ldi(index, true, value >> 8));
+    }
+    inline void setDataWord(const std::uint32_t address, const cpu_register_t value)
+    {
+        std::memcpy(&image[address], &value, sizeof(value));
+    }
+    // Places code into image, has to be called after the last emit
+    const std::vector<std::uint8_t>& getImage()
+    {
+        std::memcpy(image.data(), code.data(), code.size() * sizeof(cpu_register_t));
+        return image;
+    }
+
+    inline std::uint64_t getPassInstructions() const { return code.size(); }
+
+    const std::string name;
+private:
+    std::vector<cpu_register_t> code;
+    std::vector<std::uint8_t> image;
+};
+
+workload blockCopy()
+{
+    workload copy("workload/block_copy");
+    copy.setRegister(0, dataAddress);
+    copy.setRegister(1, secondDataAddress);
+    for (std::uint32_t block = 0; block < 448; ++block) {
+        for (int word = 0; word < 16; ++word) {
+            copy.emit(encode::ld(2, 0, word * 2));
+            copy.emit(encode::st(1, 2, word * 2));
+        }
+        copy.emit(encode::mathImmediate(encode::ADD, 0, 32));
+        copy.emit(encode::mathImmediate(encode::ADD, 1, 32));
+    }
+    for (std::uint32_t address = dataAddress; address < secondDataAddress; address += 2)
+        copy.setDataWord(address, address * 7);
+    return copy;
+}
+
+// Fletcher-like sums of data block
+workload checksum()
+{
+    workload sum("workload/checksum");
+    sum.setRegister(0, dataAddress);
+    sum.emit(encode::bitwise(encode::XOR, 3, 3));
+    sum.emit(encode::bitwise(encode::XOR, 4, 4));
+    for (std::uint32_t block = 0; block < 320; ++block) {
+        for (int word = 0; word < 16; ++word) {
+            sum.emit(encode::ld(2, 0, word * 2));
+            sum.emit(encode::math(encode::ADD, 3, 2));
+            sum.emit(encode::math(encode::ADD, 4, 3));
+        }
+        sum.emit(encode::mathImmediate(encode::ADD, 0, 32));
+    }
+    for (std::uint32_t address = dataAddress; address < maxSupportedMemory; address += 2)
+        sum.setDataWord(address, address ^ 0x5a5a);
+    return sum;
+}
+
+// Dot product of two vectors
+workload multiplyAccumulate()
+{
+    workload mac("workload/multiply_accumulate");
+    mac.setRegister(0, dataAddress);
+    mac.setRegister(1, secondDataAddress);
+    mac.emit(encode::bitwise(encode::XOR, 4, 4));
+    for (std::uint32_t block = 0; block < 240; ++block) {
+        for (int word = 0; word < 16; ++word) {
+            mac.emit(encode::ld(2, 0, word * 2));
+            mac.emit(encode::ld(3, 1, word * 2));
+            mac.emit(encode::math(encode::MUL, 2, 3));
+            mac.emit(encode::math(encode::ADD, 4, 2));
+        }
+        mac.emit(encode::mathImmediate(encode::ADD, 0, 32));
+        mac.emit(encode::mathImmediate(encode::ADD, 1, 32));
+    }
+    for (std::uint32_t address = dataAddress; address < maxSupportedMemory; address += 2)
+        mac.setDataWord(address, address * 3 + 1);
+    return mac;
+}
+
+// Shape of compiler output: constants built by ldi pairs and read-modify-write
+// of memory variables, pairs which interpreter fuses
+workload compiledCode()
+{
+    workload compiled("workload/compiled_code");
+    compiled.setRegister(1, dataAddress);
+    compiled.emit(encode::bitwise(encode::XOR, 3, 3));
+    for (std::uint32_t block = 0; block < 200; ++block) {
+        for (int word = 0; word < 8; ++word) {
+            compiled.emit(encode::ldi(2, false, block * 8 + word));
+            compiled.emit(encode::ldi(2, true, word));
+            compiled.emit(encode::math(encode::ADD, 3, 2));
+            compiled.emit(encode::ld(0, 1, word * 2));
+            compiled.emit(encode::math(encode::ADD, 0, 3));
+            compiled.emit(encode::st(1, 0, word * 2));
+            compiled.emit(encode::ld(0, 1, word * 2 + 16));
+            compiled.emit(encode::mathImmediate(encode::ADD, 0, 1));
+            compiled.emit(encode::st(1, 0, word * 2 + 16));
+        }
+        compiled.emit(encode::mathImmediate(encode::ADD, 1, 32));
+    }
+    return compiled;
+}
+
+// Register only population count steps and xorshift mixing
+workload bitManipulation()
+{
+    workload bits("workload/bit_manipulation");
+    bits.setRegister(0, 0x1234);
+    bits.setRegister(5, 0x5555);
+    bits.setRegister(6, 0x3333);
+    bits.setRegister(3, 0x9e37);
+    for (std::uint32_t block = 0; block < 1000; ++block) {
+        bits.emit(encode::bitwise(encode::XOR, 1, 1));
+        bits.emit(encode::bitwise(encode::OR, 1, 0));
+        bits.emit(encode::mathImmediate(encode::SRL, 1, 1));
+        bits.emit(encode::bitwise(encode::AND, 1, 5));
+        bits.emit(encode::math(encode::SUB, 0, 1));
+        bits.emit(encode::bitwise(encode::XOR, 2, 2));
+        bits.emit(encode::bitwise(encode::OR, 2, 0));
+        bits.emit(encode::bitwise(encode::AND, 2, 6));
+        bits.emit(encode::mathImmediate(encode::SRL, 0, 2));
+        bits.emit(encode::bitwise(encode::AND, 0, 6));
+        bits.emit(encode::math(encode::ADD, 0, 2));
+        bits.emit(encode::bitwise(encode::XOR, 3, 0));
+        bits.emit(encode::mathImmediate(encode::SLL, 3, 1));
+        bits.emit(encode::bitwise(encode::XOR, 0, 3));
+        bits.emit(encode::mathImmediate(encode::ADD, 0, 91));
+    }
+    return bits;
+}
+
+// Every word of data holds address of the next one, order is a random cycle
+workload pointerChase()
+{
+    workload chase("workload/pointer_chase");
+    chase.setRegister(0, dataAddress);
+    for (std::uint32_t step = 0; step < 16000; ++step)
+        chase.emit(encode::ld(0, 0, 0));
+
+    std::vector<std::uint32_t> order((maxSupportedMemory - dataAddress) / sizeof(cpu_register_t));
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin() + 1, order.end(), std::mt19937(42));
+    for (std::size_t index = 0; index < order.size(); ++index) {
+        const std::uint32_t next = order[(index + 1) % order.size()];
+        chase.setDataWord(dataAddress + order[index] * 2, dataAddress + next * 2);
+    }
+    return chase;
+}
+
+// Long stream of one instruction, shows cost of its dispatch and execution
+workload opcodeStream(const std::string& name, const cpu_register_t instruction)
+{
+    workload stream("opcode/" + name);
+    stream.setRegister(1, dataAddress);
+    stream.setRegister(6, 3);
+    for (std::uint32_t step = 0; step < 16000; ++step)
+        stream.emit(instruction);
+    return stream;
+}
+
+std::vector<workload> opcodeStreams()
+{
+    using namespace encode;
+    return {
+        opcodeStream("ld", ld(0, 1, 0)),
+        opcodeStream("st", st(1, 0, 0)),
+        opcodeStream("ldi", ldi(0, false, 0x5a)),
+        opcodeStream("add_register", math(ADD, 0, 6)),
+        opcodeStream("add_immediate", mathImmediate(ADD, 0, 3)),
+        opcodeStream("sub_register", math(SUB, 0, 6)),
+        opcodeStream("sub_immediate", mathImmediate(SUB, 0, 3)),
+        opcodeStream("mul_register", math(MUL, 0, 6)),
+        opcodeStream("mul_immediate", mathImmediate(MUL, 0, 3)),
+        opcodeStream("srl_register", math(SRL, 0, 6)),
+        opcodeStream("srl_immediate", mathImmediate(SRL, 0, 3)),
+        opcodeStream("sll_register", math(SLL, 0, 6)),
+        opcodeStream("sll_immediate", mathImmediate(SLL, 0, 3)),
+        opcodeStream("not", NOT << 12),
+        opcodeStream("and", bitwise(AND, 0, 6)),
+        opcodeStream("or", bitwise(OR, 0, 6)),
+        opcodeStream("xor", bitwise(XOR, 0, 6)),
+    };
+}
+
+struct measurement {
+    std::uint64_t retiredInstructions;
+    double seconds;
+    std::uint64_t cycles;
+    long peakRssKb;
+    bool isValid;
+    perf_sample counters;
+};
+
+inline std::uint64_t readCycles()
+{
+#ifdef WORKLOAD_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Repeats passes until minTime is spent
+measurement measure(const std::function<bool(std::uint64_t&)>& pass, const double minTime)
+{
+    measurement result = { 0, 0, 0, 0, true, {} };
+    perf_counters counters;
+    counters.start();
+    const std::uint64_t startCycles = readCycles();
+    const auto start = std::chrono::steady_clock::now();
+    while (result.seconds < minTime && result.isValid) {
+        result.isValid = pass(result.retiredInstructions);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    result.cycles = readCycles() - startCycles;
+    result.counters = counters.stop();
+    return result;
+}
+
+measurement runCpu(workload& current, const execution_tier tier, const double minTime,
+                   std::shared_ptr<const instructions::fusion_table> fusion = nullptr)
+{
+    cpu machine(tier);
+    machine.setFusionTable(std::move(fusion));
+    const std::vector<std::uint8_t>& image = current.getImage();
+    machine.getMemory().write(0, image.data(), image.size());
+    const std::uint64_t passInstructions = current.getPassInstructions();
+    return measure([&](std::uint64_t& retired) {
+        machine.setInstructionPtr(0);
+        run_result result = machine.run(passInstructions);
+        retired += result.retiredInstructions;
+        return result.reason == stop_reason::INSTRUCTIONS_LIMIT;
+    }, minTime);
+}
+
+// Interpreter with every retired instruction written to compressed trace
+measurement runTraced(workload& current, const double minTime)
+{
+    traced_cpu machine;
+    const std::vector<std::uint8_t>& image = current.getImage();
+    machine.getMemory().write(0, image.data(), image.size());
+    const std::string path = (std::filesystem::temp_directory_path() / "workload_trace.bin").string();
+    if (machine.getProfiler().open(path, machine.getRegisters()) != status::STATUS_OK)
+        return { 0, 0, 0, 0, false, {} };
+    const std::uint64_t passInstructions = current.getPassInstructions();
+    measurement result = measure([&](std::uint64_t& retired) {
+        machine.setInstructionPtr(0);
+        run_result result = machine.run(passInstructions);
+        retired += result.retiredInstructions;
+        return result.reason == stop_reason::INSTRUCTIONS_LIMIT;
+    }, minTime);
+    result.isValid = result.isValid && machine.getProfiler().close() == status::STATUS_OK;
+    std::filesystem::remove(path);
+    return result;
+}
+
+// Step API, every instruction goes through decodeInstruction and
+// executeInstruction with their handler calls
+measurement runStep(workload& current, const double minTime)
+{
+    cpu machine;
+    const std::vector<std::uint8_t>& image = current.getImage();
+    machine.getMemory().write(0, image.data(), image.size());
+    const std::uint32_t passEnd = current.getPassInstructions() * sizeof(cpu_register_t);
+    return measure([&](std::uint64_t& retired) {
+        for (std::uint32_t address = 0; address < passEnd; address += sizeof(cpu_register_t)) {
+            machine.setInstructionPtr(address);
+            if (machine.decodeInstruction() != status::STATUS_OK ||
+                machine.executeInstruction() < status::UNKNOWN_WARNING)
+                return false;
+            ++retired;
+        }
+        return true;
+    }, minTime);
+}
+
+measurement runBatch(workload& current, const std::uint32_t lanesCount, const double minTime)
+{
+    const std::vector<std::uint8_t>& image = current.getImage();
+    batch_cpu batch(lanesCount, image.data(), image.size());
+    const std::uint64_t passInstructions = current.getPassInstructions();
+    return measure([&](std::uint64_t& retired) {
+        for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+            batch.setInstructionPtr(lane, 0);
+        bool isValid = true;
+        for (const run_result& result : batch.run(passInstructions)) {
+            retired += result.retiredInstructions;
+            isValid = isValid && result.reason == stop_reason::INSTRUCTIONS_LIMIT;
+        }
+        return isValid;
+    }, minTime);
+}
+
+long getPeakRssKb()
+{
+#ifdef WORKLOAD_ISOLATION
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+// Runs case in child process, so peak RSS belongs to this case only, child
+// starts with RSS of the runner itself
+measurement isolate(const std::function<measurement()>& runCase)
+{
+#ifdef WORKLOAD_ISOLATION
+    int channel[2];
+    if (!pipe(channel)) {
+        const pid_t child = fork();
+        if (child == 0) {
+            close(channel[0]);
+            measurement result = runCase();
+            result.peakRssKb = getPeakRssKb();
+            const bool isWritten = write(channel[1], &result, sizeof(result)) == sizeof(result);
+            _exit(isWritten ? 0 : 1);
+        }
+        close(channel[1]);
+        measurement result = {};
+        const bool isRead = child > 0 && read(channel[0], &result, sizeof(result)) == sizeof(result);
+        close(channel[0]);
+        if (child > 0)
+            waitpid(child, nullptr, 0);
+        if (isRead)
+            return result;
+    }
+#endif
+    measurement result = runCase();
+    result.peakRssKb = getPeakRssKb();
+    return result;
+}
+
+}
+
+void runWorkloadBenchmarks(bench::harness& harness, const double minTime)
+{
+    constexpr std::uint32_t batchLanes = 16;
+    std::vector<workload> workloads = { blockCopy(), checksum(), multiplyAccumulate(), bitManipulation(), pointerChase(),
+                                     compiledCode() };
+    for (workload& stream : opcodeStreams())
+        workloads.push_back(std::move(stream));
+
+    bool isCountersReported = false;
+    for (workload& current : workloads) {
+        const std::string prefix = current.name + "/";
+        const std::pair<std::string, std::function<measurement()>> modes[] = {
+            { "step", [&]() { return runStep(current, minTime); } },
+            { "interpreter", [&]() { return runCpu(current, execution_tier::INTERPRETER, minTime); } },
+            { "fused", [&]() {
+                return runCpu(current, execution_tier::INTERPRETER, minTime, instructions::fusion_table::getDefault());
+            } },
+            { "jit", [&]() { return runCpu(current, execution_tier::JIT, minTime); } },
+            { "trace", [&]() { return runTraced(current, minTime); } },
+            { "batch" + std::to_string(batchLanes), [&]() { return runBatch(current, batchLanes, minTime); } },
+        };
+        for (const auto& [mode, runCase] : modes) {
+            const std::string name = prefix + mode;
+            if (!harness.isSelected(name))
+                continue;
+            const measurement result = isolate(runCase);
+            if (!result.isValid || !result.retiredInstructions) {
+                std::cerr << "Workload " << name << " stopped before the end of its code" << std::endl;
+                continue;
+            }
+            const double retired = result.retiredInstructions;
+            bench::result caseResult = { name, result.retiredInstructions, result.seconds * 1e9 / retired,
+                                         result.seconds * 1e9 / retired, {
+                { "mips", retired / result.seconds / 1e6 },
+                { "tsc_per_instruction", result.cycles / retired },
+                { "peak_rss_kb", (double)result.peakRssKb },
+            } };
+            for (std::uint32_t event = 0; event < perfEventsCount; ++event)
+                if (result.counters.isValid[event])
+                    caseResult.counters.push_back({ std::string(perf_counters::getEventName((perf_event)event)) +
+                                                    "_per_instruction", result.counters.values[event] / retired });
+            if (!isCountersReported && !result.counters.has(perf_event::CYCLES)) {
+                std::cerr << "Hardware counters are not available, only time and TSC are reported" << std::endl;
+                isCountersReported = true;
+            }
+            harness.add(caseResult);
+        }
+    }
+
+    // Short lived cpus, as started by cpu_fleet for every job: new instance
+    // against reset of a used one, both touch one page of memory
+    const cpu_register_t code = 0b0011'1000'0000'0001; // add, dst register 0, immediate value 1
+    harness.run("lifecycle/create", [code]() {
+        cpu machine;
+        machine.getMemory().writeWord(0, code);
+        bench::doNotOptimize(machine.run(1).retiredInstructions);
+    });
+    cpu reused;
+    harness.run("lifecycle/reset", [&reused, code]() {
+        reused.reset();
+        reused.getMemory().writeWord(0, code);
+        bench::doNotOptimize(reused.run(1).retiredInstructions);
+    });
+}
@@ -1,4 +1,3 @@
-#include <cmath>
 #include "base.h"
 
 // Max address space that can be indexed by cpu is depends on register
@@ -9,7 +8,39 @@ cpu_base_properties::cpu_base_properties(const std::uint32_t _maxInstructionsCou
     maxInstructionsCount(_maxInstructionsCount),
     registersCount(_registersCount),
     registerSize(_registerSize),
-    bitsPerInstruction(log2(maxInstructionsCount)),
-    bitsPerRegister(log2(registersCount)),
+    bitsPerInstruction(integerLog2(maxInstructionsCount)),
+    bitsPerRegister(integerLog2(registersCount)),
     instructionMask(0xffffffffffffffff << (registerSize - bitsPerInstruction)), // 0xff.. is long because of 64-bit cpu in future
     memorySize(maxSupportedMemory) {}
+
+const char* getStatusName(const status st)
+{
+    switch (st) {
+    case status::UNKNOWN_ERROR: return "UNKNOWN_ERROR";
+    case status::DECODE_UNKNOWN_INSTRUCTION: return "DECODE_UNKNOWN_INSTRUCTION";
+    case status::ATTEMPT_TO_EXECUTE_UNKNOWN_INSTRUCTION: return "ATTEMPT_TO_EXECUTE_UNKNOWN_INSTRUCTION";
+    case status::OUT_OF_MEMORY_ERROR: return "OUT_OF_MEMORY_ERROR";
+    case status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH:
+        return "SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH";
+    case status::FILE_ACCESS_ERROR: return "FILE_ACCESS_ERROR";
+    case status::FILE_FORMAT_ERROR: return "FILE_FORMAT_ERROR";
+    case status::FILE_CHECKSUM_ERROR: return "FILE_CHECKSUM_ERROR";
+    case status::FILE_STALE_ERROR: return "FILE_STALE_ERROR";
+    case status::UNSUPPORTED_INSTRUCTION_ERROR: return "UNSUPPORTED_INSTRUCTION_ERROR";
+    case status::UNKNOWN_WARNING: return "UNKNOWN_WARNING";
+    case status::LAST_MEMORY_BYTE_WARNING: return "LAST_MEMORY_BYTE_WARNING";
+    case status::STATUS_OK: return "STATUS_OK";
+    }
+    return "UNKNOWN";
+}
+
+std::uint64_t getContentHash(const void* const data, const std::size_t size, const std::uint64_t initial)
+{
+    const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+    std::uint64_t hash = initial;
+    for (std::size_t index = 0; index < size; ++index) {
+        hash ^= bytes[index];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 #define KB(a) (a * 1024)
@@ -17,23 +18,24 @@ enum class status : std::int32_t {
     ATTEMPT_TO_EXECUTE_UNKNOWN_INSTRUCTION,
     OUT_OF_MEMORY_ERROR,
     SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH,
+    FILE_ACCESS_ERROR,
+    FILE_FORMAT_ERROR,
+    FILE_CHECKSUM_ERROR,
+    FILE_STALE_ERROR, // file was made for other guest code
+    UNSUPPORTED_INSTRUCTION_ERROR, // valid instruction, but execution engine does not implement it
     UNKNOWN_WARNING = -500,
     LAST_MEMORY_BYTE_WARNING, // if load 64K - 1 byte, because load at least 2 bytes
     STATUS_OK = 0
 };
 
-#ifdef LOGGING
-#define LOG(function, code)                                         \
-    if ((int)(code) < 500)                                          \
-        std::cerr << "Error: " function ", " #code << std::endl;    \
-    else                                                            \
-        std::cerr << "Warning: " function ", " #code << std::endl;
-#else
-#define LOG(function, code)
-#endif
+const char* getStatusName(const status st);
+
+// 64-bit FNV-1a of data, used as key of guest code in caches
+std::uint64_t getContentHash(const void* const data, const std::size_t size,
+                             const std::uint64_t initial = 0xcbf29ce484222325);
 
 template <typename T>
-inline T getSignValue(T value, std::uint32_t lastBitIndex)
+constexpr T getSignValue(T value, std::uint32_t lastBitIndex)
 {
     T mainValueMask = (0x1 << lastBitIndex) - 1;
     T result = value & mainValueMask;
@@ -42,8 +44,46 @@ inline T getSignValue(T value, std::uint32_t lastBitIndex)
     return result;
 }
 
+constexpr std::uint32_t integerLog2(const std::uint32_t value)
+{
+    return value <= 1 ? 0 : 1 + integerLog2(value >> 1);
+}
+
+// Compile-time cpu geometry, has same members as cpu_base_properties, so
+// templated code accepts both of them.
+template <unsigned Regs, unsigned RegBits, unsigned OpBits>
+struct static_cpu_properties {
+    static_assert(Regs && (Regs & (Regs - 1)) == 0, "registers count has to be power of 2");
+    static_assert(RegBits == sizeof(cpu_register_t) * BITS_IN_BYTE, "register size has to match cpu_register_t");
+    static_assert(OpBits + 2 * integerLog2(Regs) + 1 < RegBits, "instruction fields do not fit into register");
+
+    static constexpr std::uint32_t maxInstructionsCount = 0x1 << OpBits;
+    static constexpr std::uint32_t registersCount = Regs;
+    static constexpr std::uint32_t registerSize = RegBits; // in bits
+
+    static constexpr std::uint32_t bitsPerInstruction = OpBits;
+    static constexpr std::uint32_t bitsPerRegister = integerLog2(Regs);
+
+    static constexpr cpu_register_t instructionMask = (cpu_register_t)(0xffffffffffffffff << (RegBits - OpBits));
+
+    static constexpr std::uint32_t memorySize = maxSupportedMemory;
+};
+
+using default_cpu_properties = static_cpu_properties<8, 16, 4>;
+
+template <typename Properties>
+struct is_static_cpu_properties { static constexpr bool value = false; };
+template <unsigned Regs, unsigned RegBits, unsigned OpBits>
+struct is_static_cpu_properties<static_cpu_properties<Regs, RegBits, OpBits>> { static constexpr bool value = true; };
+
+// Runtime configurable geometry
 struct cpu_base_properties {
-    cpu_base_properties(const std::uint32_t _maxInstructionsCount = 16, const std::uint32_t _registersCount = 8, const std::uint32_t _registerSize = 16);
+    cpu_base_properties(const std::uint32_t _maxInstructionsCount = default_cpu_properties::maxInstructionsCount,
+                        const std::uint32_t _registersCount = default_cpu_properties::registersCount,
+                        const std::uint32_t _registerSize = default_cpu_properties::registerSize);
+    template <unsigned Regs, unsigned RegBits, unsigned OpBits>
+    cpu_base_properties(const static_cpu_properties<Regs, RegBits, OpBits>&) :
+        cpu_base_properties(0x1 << OpBits, Regs, RegBits) {}
 
     const std::uint32_t maxInstructionsCount;
     const std::uint32_t registersCount;
@@ -0,0 +1,419 @@
+#include <algorithm>
+#include <cstring>
+
+#include "batch_cpu.h"
+#include "batch_kernels.h"
+
+namespace {
+
+cpu_register_t* alignRows(std::vector<cpu_register_t>& storage, const std::uint32_t rowsCount, const std::uint32_t stride)
+{
+    constexpr std::size_t alignment = batch_kernels::laneAlignment * sizeof(cpu_register_t);
+    const std::size_t rowsSize = (std::size_t)rowsCount * stride * sizeof(cpu_register_t);
+    storage.assign(rowsSize / sizeof(cpu_register_t) + batch_kernels::laneAlignment, 0);
+    void* rows = storage.data();
+    std::size_t space = storage.size() * sizeof(cpu_register_t);
+    return static_cast<cpu_register_t*>(std::align(alignment, rowsSize, rows, space));
+}
+
+}
+
+batch_cpu::batch_cpu(const std::uint32_t _lanesCount, const std::uint8_t* const program, const std::uint32_t programSize,
+                     const std::uint32_t loadAddress) :
+    lanesCount(_lanesCount),
+    lanesStride((_lanesCount + batch_kernels::laneAlignment - 1) / batch_kernels::laneAlignment * batch_kernels::laneAlignment),
+    cpuProperties(geometry()), instructionPtrs(lanesStride, loadAddress), retiredInstructions(lanesStride, 0),
+    warningRetired(lanesStride, 0), warningStatus(lanesStride, status::STATUS_OK), isConverged(false),
+    convergedPtr(loadAddress), convergedSteps(0), convergedBudget(0), runningLanes(0), isFlagsPending(false),
+    pendingFlags(),
+    code(new std::uint8_t[geometry::memorySize]{}),
+    memory(new std::uint8_t[(std::size_t)_lanesCount * geometry::memorySize]{}),
+    decodeTable(instructions::decode_table::getTable(cpuProperties))
+{
+    registers = alignRows(registersStorage, geometry::registersCount, lanesStride);
+    runningMask = alignRows(masksStorage, 3, lanesStride);
+    stepMask = runningMask + lanesStride;
+    errorsMask = stepMask + lanesStride;
+    flagsOp = alignRows(flagsStorage, 5, lanesStride);
+    flagsLeft = flagsOp + lanesStride;
+    flagsRight = flagsLeft + lanesStride;
+    flagsResult = flagsRight + lanesStride;
+    flagsScratch = flagsResult + lanesStride;
+
+    std::uint32_t size = loadAddress < geometry::memorySize ? std::min(programSize, geometry::memorySize - loadAddress) : 0;
+    if (size) {
+        std::memcpy(&code[loadAddress], program, size);
+        for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+            std::memcpy(&getMemory(lane)[loadAddress], program, size);
+    }
+}
+
+batch_cpu::~batch_cpu() {}
+
+const std::vector<run_result>& batch_cpu::run(const std::uint64_t maxInstructions)
+{
+    constexpr std::uint32_t lastWordAddress = geometry::memorySize - sizeof(cpu_register_t);
+    const instructions::decode_table& table = *decodeTable;
+
+    results.assign(lanesCount, { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK });
+    std::fill(retiredInstructions.begin(), retiredInstructions.end(), 0);
+    std::fill(warningRetired.begin(), warningRetired.end(), (std::uint64_t)-1);
+    for (std::uint32_t lane = 0; lane < lanesStride; ++lane)
+        runningMask[lane] = lane < lanesCount ? (cpu_register_t)-1 : 0;
+    runningLanes = maxInstructions ? lanesCount : 0;
+    isConverged = false;
+
+    while (runningLanes) {
+        if (!isConverged)
+            selectLanes(maxInstructions);
+        const cpu_register_t* const mask = isConverged ? runningMask : stepMask;
+
+        if (convergedPtr > lastWordAddress) {
+            stopMaskedLanes(mask, stop_reason::END_OF_MEMORY, status::OUT_OF_MEMORY_ERROR);
+            isConverged = false;
+            continue;
+        }
+
+        cpu_register_t instruction;
+        std::memcpy(&instruction, &code[convergedPtr], sizeof(instruction));
+        executeStep(table[instruction], mask);
+
+        if (isConverged) {
+            convergedPtr += sizeof(cpu_register_t);
+            ++convergedSteps;
+            if (--convergedBudget == 0 || runningLanes == 0) {
+                foldConvergedSteps();
+                for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+                    if (runningMask[lane] && retiredInstructions[lane] == maxInstructions)
+                        stopLane(lane, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK);
+            }
+            continue;
+        }
+
+        for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+            if (!(stepMask[lane] & runningMask[lane]))
+                continue;
+            instructionPtrs[lane] += sizeof(cpu_register_t);
+            if (++retiredInstructions[lane] == maxInstructions)
+                stopLane(lane, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK);
+        }
+    }
+
+    if (isFlagsPending)
+        materializeFlags();
+    return results;
+}
+
+// Picks running lanes with the lowest instructionPtr, so lanes which went
+// ahead wait for others and execution converges again at the same address.
+void batch_cpu::selectLanes(const std::uint64_t maxInstructions)
+{
+    std::uint32_t address = (std::uint32_t)-1;
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+        if (runningMask[lane])
+            address = std::min(address, instructionPtrs[lane]);
+
+    std::uint32_t selectedLanes = 0;
+    std::uint64_t maxRetired = 0;
+    for (std::uint32_t lane = 0; lane < lanesStride; ++lane) {
+        bool isSelected = runningMask[lane] && instructionPtrs[lane] == address;
+        stepMask[lane] = isSelected ? (cpu_register_t)-1 : 0;
+        if (isSelected) {
+            ++selectedLanes;
+            maxRetired = std::max(maxRetired, retiredInstructions[lane]);
+        }
+    }
+
+    convergedPtr = address;
+    if (selectedLanes == runningLanes) {
+        isConverged = true;
+        convergedSteps = 0;
+        convergedBudget = maxInstructions - maxRetired;
+    }
+}
+
+void batch_cpu::executeStep(const instructions::decoded_instruction& operands, const cpu_register_t* const mask)
+{
+    using instructions::operation;
+    using batch_kernels::kernel_op;
+
+    constexpr std::uint32_t registerSize = geometry::registerSize;
+    constexpr std::uint32_t halfRegisterSize = BITS_IN_BYTE * (sizeof(cpu_register_t) / 2);
+    constexpr cpu_register_t lowerHalfMask = (cpu_register_t)-1 >> halfRegisterSize;
+    constexpr status shiftError = status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
+
+    cpu_register_t* const dst = getRow(operands.dstRegisterIndex);
+    const cpu_register_t* const src = getRow(operands.srcRegisterIndex);
+    const cpu_register_t immediate = operands.immediate;
+    const bool isFlagSetting = instructions::lazy_flags::isFlagSetting(operands.op);
+    const bool isEveryLane = isConverged && runningLanes == lanesCount;
+    if (isFlagsPending && (!isEveryLane || isPendingFlagsChanged(operands)))
+        materializeFlags();
+    if (isFlagSetting)
+        for (std::uint32_t lane = 0; lane < lanesStride; ++lane)
+            flagsScratch[lane] = dst[lane];
+
+    switch (operands.op) {
+    case operation::LOAD:
+    case operation::STORE:
+        executeMemoryAccess(operands, mask);
+        break;
+    case operation::LOAD_IMMEDIATE_LOWER:
+        batch_kernels::merge(dst, ~lowerHalfMask, immediate, mask, lanesStride);
+        break;
+    case operation::LOAD_IMMEDIATE_UPPER:
+        batch_kernels::merge(dst, lowerHalfMask, immediate << halfRegisterSize, mask, lanesStride);
+        break;
+    case operation::ADD_REGISTER:
+        batch_kernels::applyRegister(kernel_op::ADD, dst, src, mask, lanesStride);
+        break;
+    case operation::ADD_IMMEDIATE:
+        batch_kernels::applyImmediate(kernel_op::ADD, dst, immediate, mask, lanesStride);
+        break;
+    case operation::SUB_REGISTER:
+        batch_kernels::applyRegister(kernel_op::SUB, dst, src, mask, lanesStride);
+        break;
+    case operation::SUB_IMMEDIATE:
+        batch_kernels::applyImmediate(kernel_op::SUB, dst, immediate, mask, lanesStride);
+        break;
+    case operation::MUL_REGISTER:
+        batch_kernels::applyRegister(kernel_op::MUL, dst, src, mask, lanesStride);
+        break;
+    case operation::MUL_IMMEDIATE:
+        batch_kernels::applyImmediate(kernel_op::MUL, dst, immediate, mask, lanesStride);
+        break;
+    case operation::SRL_REGISTER:
+    case operation::SLL_REGISTER: {
+        kernel_op op = operands.op == operation::SRL_REGISTER ? kernel_op::SRL : kernel_op::SLL;
+        if (batch_kernels::shiftRegister(op, dst, src, mask, errorsMask, lanesStride)) {
+            for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+                if (errorsMask[lane])
+                    stopLane(lane, stop_reason::ERROR, shiftError);
+            // Failed lanes keep flags
+            for (std::uint32_t lane = 0; lane < lanesStride; ++lane)
+                errorsMask[lane] = mask[lane] & ~errorsMask[lane];
+            recordFlags(operands, errorsMask);
+            return;
+        }
+        break;
+    }
+    case operation::SRL_IMMEDIATE:
+    case operation::SLL_IMMEDIATE: {
+        kernel_op op = operands.op == operation::SRL_IMMEDIATE ? kernel_op::SRL : kernel_op::SLL;
+        if (immediate > registerSize) {
+            stopMaskedLanes(mask, stop_reason::ERROR, shiftError);
+            return;
+        }
+        batch_kernels::applyImmediate(op, dst, immediate, mask, lanesStride);
+        break;
+    }
+    case operation::NOT:
+        batch_kernels::bitwiseNot(dst, mask, lanesStride);
+        break;
+    case operation::AND:
+        batch_kernels::applyRegister(kernel_op::AND, dst, src, mask, lanesStride);
+        break;
+    case operation::OR:
+        batch_kernels::applyRegister(kernel_op::OR, dst, src, mask, lanesStride);
+        break;
+    case operation::XOR:
+        batch_kernels::applyRegister(kernel_op::XOR, dst, src, mask, lanesStride);
+        break;
+    case operation::JUMP:
+    case operation::BRANCH_IF_SET:
+    case operation::BRANCH_IF_CLEAR:
+    case operation::CALL_REGISTER:
+    case operation::CALL_IMMEDIATE:
+    case operation::RETURN:
+        executeControlFlow(operands, mask);
+        break;
+    case operation::VECTOR_ADD:
+    case operation::VECTOR_SUB:
+    case operation::VECTOR_AND:
+    case operation::VECTOR_OR:
+    case operation::VECTOR_XOR:
+    case operation::VECTOR_COMPARE_EQUAL:
+    case operation::VECTOR_LOAD:
+    case operation::VECTOR_STORE:
+        stopMaskedLanes(mask, stop_reason::ERROR, status::UNSUPPORTED_INSTRUCTION_ERROR);
+        break;
+    default:
+        stopMaskedLanes(mask, stop_reason::ERROR, status::DECODE_UNKNOWN_INSTRUCTION);
+        break;
+    }
+
+    if (!isFlagSetting)
+        return;
+    if (isEveryLane) {
+        // Left operand of every lane is in scratch row, the rest stays in registers
+        std::swap(flagsLeft, flagsScratch);
+        pendingFlags = operands;
+        isFlagsPending = true;
+    }
+    else {
+        recordFlags(operands, mask);
+    }
+}
+
+// Flag setting instruction executed by every lane only replaces pending one,
+// except shifts by register, they fail in some lanes which keep old flags.
+// Other instructions read flags or may overwrite operands of pending one.
+bool batch_cpu::isPendingFlagsChanged(const instructions::decoded_instruction& operands) const
+{
+    using instructions::operation;
+
+    switch (operands.op) {
+    case operation::SRL_REGISTER:
+    case operation::SLL_REGISTER:
+        return true;
+    case operation::STORE:
+        return false;
+    default:
+        if (instructions::lazy_flags::isFlagSetting(operands.op))
+            return false;
+        if (instructions::isControlFlow(operands.op))
+            return true;
+        return operands.dstRegisterIndex == pendingFlags.dstRegisterIndex ||
+               operands.dstRegisterIndex == pendingFlags.srcRegisterIndex;
+    }
+}
+
+void batch_cpu::materializeFlags()
+{
+    const bool isImmediate = ((std::uint32_t)pendingFlags.op - (std::uint32_t)instructions::operation::ADD_REGISTER) % 2;
+    const cpu_register_t* const src = pendingFlags.srcRegisterIndex == pendingFlags.dstRegisterIndex ?
+        flagsLeft : getRow(pendingFlags.srcRegisterIndex);
+    const cpu_register_t* const dst = getRow(pendingFlags.dstRegisterIndex);
+    for (std::uint32_t lane = 0; lane < lanesStride; ++lane) {
+        flagsOp[lane] = (cpu_register_t)pendingFlags.op;
+        flagsRight[lane] = isImmediate ? pendingFlags.immediate : src[lane];
+        flagsResult[lane] = dst[lane];
+    }
+    isFlagsPending = false;
+}
+
+// Status register of lanes in mask takes operands of executed instruction
+void batch_cpu::recordFlags(const instructions::decoded_instruction& operands, const cpu_register_t* const mask)
+{
+    const bool isImmediate = ((std::uint32_t)operands.op - (std::uint32_t)instructions::operation::ADD_REGISTER) % 2;
+    const cpu_register_t* const src = operands.srcRegisterIndex == operands.dstRegisterIndex ?
+        flagsScratch : getRow(operands.srcRegisterIndex); // dst row is already changed
+    const cpu_register_t* const dst = getRow(operands.dstRegisterIndex);
+
+    batch_kernels::merge(flagsOp, 0, (cpu_register_t)operands.op, mask, lanesStride);
+    if (isImmediate)
+        batch_kernels::merge(flagsRight, 0, operands.immediate, mask, lanesStride);
+    else
+        batch_kernels::copy(flagsRight, src, mask, lanesStride);
+    batch_kernels::copy(flagsResult, dst, mask, lanesStride);
+    batch_kernels::copy(flagsLeft, flagsScratch, mask, lanesStride);
+}
+
+// Lanes may go to different targets, so they leave converged execution.
+// As in cpu::executeInstruction, instructionPtr is set one word before
+// target, run moves it to target like after any other instruction.
+void batch_cpu::executeControlFlow(const instructions::decoded_instruction& operands, const cpu_register_t* const mask)
+{
+    using instructions::operation;
+
+    if (isConverged) {
+        foldConvergedSteps();
+        std::memcpy(stepMask, runningMask, lanesStride * sizeof(cpu_register_t));
+    }
+
+    const std::uint32_t pc = convergedPtr;
+    const bool isBranch = operands.op == operation::BRANCH_IF_SET || operands.op == operation::BRANCH_IF_CLEAR;
+    const bool isCall = operands.op == operation::CALL_REGISTER || operands.op == operation::CALL_IMMEDIATE;
+    cpu_register_t* const registerRow = getRow(operands.srcRegisterIndex);
+    cpu_register_t* const linkRow = getRow(operands.dstRegisterIndex);
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+        if (!mask[lane])
+            continue;
+        std::uint32_t target = (cpu_register_t)(pc + operands.immediate);
+        if (operands.op == operation::CALL_REGISTER || operands.op == operation::RETURN)
+            target = registerRow[lane];
+        else if (isBranch && getFlags(lane).isSet(0x1 << operands.srcRegisterIndex) != (operands.op == operation::BRANCH_IF_SET))
+            target = pc + sizeof(cpu_register_t);
+        if (isCall)
+            linkRow[lane] = pc + sizeof(cpu_register_t);
+        instructionPtrs[lane] = target - sizeof(cpu_register_t);
+    }
+}
+
+// Every lane has its own memory, so accesses are done lane by lane
+void batch_cpu::executeMemoryAccess(const instructions::decoded_instruction& operands, const cpu_register_t* const mask)
+{
+    constexpr std::uint32_t lastWordAddress = geometry::memorySize - sizeof(cpu_register_t);
+
+    const bool isLoad = operands.op == instructions::operation::LOAD;
+    const cpu_register_t* const addresses = getRow(isLoad ? operands.srcRegisterIndex : operands.dstRegisterIndex);
+    cpu_register_t* const values = getRow(isLoad ? operands.dstRegisterIndex : operands.srcRegisterIndex);
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+        if (!mask[lane])
+            continue;
+        std::uint32_t address = instructions::getEfficientAddress(addresses[lane], operands.immediate);
+        if (address > lastWordAddress)
+            executeHandler(lane, operands);
+        else if (isLoad)
+            std::memcpy(&values[lane], &getMemory(lane)[address], sizeof(cpu_register_t));
+        else
+            std::memcpy(&getMemory(lane)[address], &values[lane], sizeof(cpu_register_t));
+    }
+}
+
+// Edge cases are left to the instruction handlers, they work with the
+// register file of one lane, so it is gathered from rows and scattered back
+void batch_cpu::executeHandler(const std::uint32_t lane, const instructions::decoded_instruction& operands)
+{
+    cpu_register_t laneRegisters[geometry::registersCount];
+    for (std::uint32_t index = 0; index < geometry::registersCount; ++index)
+        laneRegisters[index] = getRegister(lane, index);
+    guest_memory laneMemory(getMemory(lane), geometry::memorySize);
+    status st = operands.handler(operands, laneRegisters, laneMemory, cpuProperties);
+    for (std::uint32_t index = 0; index < geometry::registersCount; ++index)
+        setRegister(lane, index, laneRegisters[index]);
+
+    if (st < status::UNKNOWN_WARNING) {
+        stopLane(lane, stop_reason::ERROR, st);
+    }
+    else if (st != status::STATUS_OK) {
+        warningRetired[lane] = getRetired(lane) + 1;
+        warningStatus[lane] = st;
+    }
+}
+
+void batch_cpu::stopLane(const std::uint32_t lane, const stop_reason reason, const status st)
+{
+    run_result& result = results[lane];
+    result.retiredInstructions = getRetired(lane);
+    result.reason = reason;
+    result.lastStatus = st;
+    if (reason == stop_reason::INSTRUCTIONS_LIMIT) {
+        if (warningRetired[lane] == result.retiredInstructions)
+            result.lastStatus = warningStatus[lane];
+    }
+    else {
+        // Instruction ended with error is not retired
+        instructionPtrs[lane] = convergedPtr;
+    }
+    runningMask[lane] = 0;
+    --runningLanes;
+}
+
+void batch_cpu::stopMaskedLanes(const cpu_register_t* const mask, const stop_reason reason, const status st)
+{
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+        if (mask[lane] && runningMask[lane])
+            stopLane(lane, reason, st);
+}
+
+void batch_cpu::foldConvergedSteps()
+{
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+        if (!runningMask[lane])
+            continue;
+        instructionPtrs[lane] = convergedPtr;
+        retiredInstructions[lane] += convergedSteps;
+    }
+    isConverged = false;
+}
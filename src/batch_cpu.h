@@ -0,0 +1,116 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "base.h"
+#include "instructions.h"
+#include "decode_table.h"
+#include "cpu.h"
+#include "flags.h"
+
+// Runs many copies of one program in lockstep. Register files are kept as
+// struct-of-arrays, row r holds register r of every lane, so one guest
+// instruction is executed for all lanes by batch_kernels. Lanes which are not
+// at the same instruction or already stopped are masked out.
+// Instructions are fetched from the shared program image, so stores into code
+// change only memory of the lane and do not change executed program.
+// Every lane has its own status register, so branches may send lanes to
+// different targets, they are executed lowest instructionPtr first until
+// lanes meet again. Lanes have no vector registers, so vector instructions
+// stop them with UNSUPPORTED_INSTRUCTION_ERROR.
+class batch_cpu {
+public:
+    using geometry = default_cpu_properties;
+
+    // Every lane gets copy of program at loadAddress and starts execution from it
+    batch_cpu(const std::uint32_t _lanesCount, const std::uint8_t* const program, const std::uint32_t programSize,
+              const std::uint32_t loadAddress = 0);
+    ~batch_cpu();
+
+    // Runs every lane until maxInstructions are retired by it or it stops with
+    // error, same as cpu::run does for one instance. Returns result per lane.
+    const std::vector<run_result>& run(const std::uint64_t maxInstructions);
+
+    inline std::uint32_t getLanesCount() const { return lanesCount; }
+    inline cpu_register_t getRegister(const std::uint32_t lane, const std::uint32_t index) const
+    {
+        return registers[index * lanesStride + lane];
+    }
+    inline void setRegister(const std::uint32_t lane, const std::uint32_t index, const cpu_register_t value)
+    {
+        registers[index * lanesStride + lane] = value;
+    }
+    inline std::uint8_t* getMemory(const std::uint32_t lane) { return &memory[(std::size_t)lane * geometry::memorySize]; }
+    inline std::uint32_t getInstructionPtr(const std::uint32_t lane) const { return instructionPtrs[lane]; }
+    inline void setInstructionPtr(const std::uint32_t lane, const std::uint32_t address) { instructionPtrs[lane] = address; }
+    inline cpu_register_t getStatusRegister(const std::uint32_t lane) const { return getFlags(lane).get(); }
+    inline void setStatusRegister(const std::uint32_t lane, const cpu_register_t value)
+    {
+        flagsOp[lane] = (cpu_register_t)instructions::operation::UNKNOWN;
+        flagsResult[lane] = value;
+    }
+private:
+    inline cpu_register_t* getRow(const std::uint32_t index) { return &registers[index * lanesStride]; }
+    inline instructions::lazy_flags getFlags(const std::uint32_t lane) const
+    {
+        return { (instructions::operation)flagsOp[lane], flagsLeft[lane], flagsRight[lane], flagsResult[lane] };
+    }
+    inline std::uint64_t getRetired(const std::uint32_t lane) const
+    {
+        return retiredInstructions[lane] + (isConverged ? convergedSteps : 0);
+    }
+
+    void selectLanes(const std::uint64_t maxInstructions);
+    void executeStep(const instructions::decoded_instruction& operands, const cpu_register_t* const mask);
+    bool isPendingFlagsChanged(const instructions::decoded_instruction& operands) const;
+    void materializeFlags();
+    void recordFlags(const instructions::decoded_instruction& operands, const cpu_register_t* const mask);
+    void executeControlFlow(const instructions::decoded_instruction& operands, const cpu_register_t* const mask);
+    void executeMemoryAccess(const instructions::decoded_instruction& operands, const cpu_register_t* const mask);
+    void executeHandler(const std::uint32_t lane, const instructions::decoded_instruction& operands);
+    void stopLane(const std::uint32_t lane, const stop_reason reason, const status st);
+    void stopMaskedLanes(const cpu_register_t* const mask, const stop_reason reason, const status st);
+    void foldConvergedSteps();
+
+    const std::uint32_t lanesCount;
+    const std::uint32_t lanesStride; // lanesCount rounded up to batch_kernels::laneAlignment
+    cpu_base_properties cpuProperties;
+
+    std::vector<cpu_register_t> registersStorage;
+    cpu_register_t* registers; // aligned rows inside registersStorage
+    std::vector<cpu_register_t> masksStorage;
+    cpu_register_t* runningMask; // lanes which are not stopped yet
+    cpu_register_t* stepMask; // running lanes at instruction executed in current step
+    cpu_register_t* errorsMask;
+    // Lazy status register of every lane as rows, see flags.h
+    std::vector<cpu_register_t> flagsStorage;
+    cpu_register_t* flagsOp;
+    cpu_register_t* flagsLeft;
+    cpu_register_t* flagsRight;
+    cpu_register_t* flagsResult;
+    cpu_register_t* flagsScratch; // dst row before flag setting instruction
+
+    std::vector<std::uint32_t> instructionPtrs;
+    std::vector<std::uint64_t> retiredInstructions;
+    std::vector<std::uint64_t> warningRetired; // retired count after last instruction with warning
+    std::vector<status> warningStatus;
+    std::vector<run_result> results;
+
+    // While every running lane is at the same instruction, pc and retired
+    // counters are not updated per lane, they are kept here instead
+    bool isConverged;
+    std::uint32_t convergedPtr;
+    std::uint64_t convergedSteps;
+    std::uint64_t convergedBudget;
+    std::uint32_t runningLanes;
+    // Flag setting instruction executed by every lane saves only dst row as
+    // left operand, right operand and result are copied from register rows
+    // when they are about to change or when lanes diverge
+    bool isFlagsPending;
+    instructions::decoded_instruction pendingFlags;
+
+    const std::unique_ptr<std::uint8_t[]> code;
+    const std::unique_ptr<std::uint8_t[]> memory;
+    const std::shared_ptr<const instructions::decode_table> decodeTable;
+};
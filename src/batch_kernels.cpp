@@ -0,0 +1,281 @@
+#include "batch_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BATCH_KERNELS_X86
+#endif
+
+namespace batch_kernels {
+
+namespace {
+
+constexpr std::uint32_t registerBits = sizeof(cpu_register_t) * BITS_IN_BYTE;
+
+inline cpu_register_t blend(const cpu_register_t result, const cpu_register_t old, const cpu_register_t mask)
+{
+    return (result & mask) | (old & ~mask);
+}
+
+inline cpu_register_t applyScalar(const kernel_op op, const cpu_register_t a, const cpu_register_t b)
+{
+    switch (op) {
+    case kernel_op::ADD: return a + b;
+    case kernel_op::SUB: return a - b;
+    case kernel_op::MUL: return a * b;
+    case kernel_op::AND: return a & b;
+    case kernel_op::OR: return a | b;
+    case kernel_op::XOR: return a ^ b;
+    case kernel_op::SRL: return a >> b;
+    case kernel_op::SLL: return a << b;
+    }
+    return a;
+}
+
+void applyRegisterScalar(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                         const cpu_register_t* const mask, const std::uint32_t begin, const std::uint32_t lanes)
+{
+    for (std::uint32_t lane = begin; lane < lanes; ++lane)
+        dst[lane] = blend(applyScalar(op, dst[lane], src[lane]), dst[lane], mask[lane]);
+}
+
+void applyImmediateScalar(const kernel_op op, cpu_register_t* const dst, const cpu_register_t value,
+                          const cpu_register_t* const mask, const std::uint32_t begin, const std::uint32_t lanes)
+{
+    for (std::uint32_t lane = begin; lane < lanes; ++lane)
+        dst[lane] = blend(applyScalar(op, dst[lane], value), dst[lane], mask[lane]);
+}
+
+bool shiftRegisterScalar(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                         const cpu_register_t* const mask, cpu_register_t* const errors,
+                         const std::uint32_t begin, const std::uint32_t lanes)
+{
+    bool hasErrors = false;
+    for (std::uint32_t lane = begin; lane < lanes; ++lane) {
+        bool isValid = src[lane] <= registerBits;
+        cpu_register_t isError = isValid ? 0 : mask[lane];
+        errors[lane] = isError;
+        hasErrors |= isError != 0;
+        dst[lane] = blend(applyScalar(op, dst[lane], isValid ? src[lane] : 0), dst[lane], mask[lane] & ~isError);
+    }
+    return hasErrors;
+}
+
+#ifdef BATCH_KERNELS_X86
+
+// SSE2 is baseline of x86-64, 8 lanes per register
+
+inline __m128i applySse2(const kernel_op op, const __m128i a, const __m128i b)
+{
+    switch (op) {
+    case kernel_op::ADD: return _mm_add_epi16(a, b);
+    case kernel_op::SUB: return _mm_sub_epi16(a, b);
+    case kernel_op::MUL: return _mm_mullo_epi16(a, b);
+    case kernel_op::AND: return _mm_and_si128(a, b);
+    case kernel_op::OR: return _mm_or_si128(a, b);
+    case kernel_op::XOR: return _mm_xor_si128(a, b);
+    case kernel_op::SRL: return _mm_srl_epi16(a, _mm_cvtsi32_si128(_mm_extract_epi16(b, 0)));
+    case kernel_op::SLL: return _mm_sll_epi16(a, _mm_cvtsi32_si128(_mm_extract_epi16(b, 0)));
+    }
+    return a;
+}
+
+inline __m128i blendSse2(const __m128i result, const __m128i old, const __m128i mask)
+{
+    return _mm_or_si128(_mm_and_si128(mask, result), _mm_andnot_si128(mask, old));
+}
+
+void applyRegisterSse2(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                       const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+    for (std::uint32_t lane = 0; lane < lanes; lane += 8) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(&dst[lane]));
+        __m128i b = _mm_load_si128(reinterpret_cast<const __m128i*>(&src[lane]));
+        __m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(&mask[lane]));
+        _mm_store_si128(reinterpret_cast<__m128i*>(&dst[lane]), blendSse2(applySse2(op, a, b), a, m));
+    }
+}
+
+void applyImmediateSse2(const kernel_op op, cpu_register_t* const dst, const cpu_register_t value,
+                        const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+    const __m128i b = _mm_set1_epi16((short)value);
+    for (std::uint32_t lane = 0; lane < lanes; lane += 8) {
+        __m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(&dst[lane]));
+        __m128i m = _mm_load_si128(reinterpret_cast<const __m128i*>(&mask[lane]));
+        _mm_store_si128(reinterpret_cast<__m128i*>(&dst[lane]), blendSse2(applySse2(op, a, b), a, m));
+    }
+}
+
+// AVX2, 16 lanes per register
+
+__attribute__((target("avx2")))
+inline __m256i applyAvx2(const kernel_op op, const __m256i a, const __m256i b)
+{
+    switch (op) {
+    case kernel_op::ADD: return _mm256_add_epi16(a, b);
+    case kernel_op::SUB: return _mm256_sub_epi16(a, b);
+    case kernel_op::MUL: return _mm256_mullo_epi16(a, b);
+    case kernel_op::AND: return _mm256_and_si256(a, b);
+    case kernel_op::OR: return _mm256_or_si256(a, b);
+    case kernel_op::XOR: return _mm256_xor_si256(a, b);
+    case kernel_op::SRL: return _mm256_srl_epi16(a, _mm_cvtsi32_si128(_mm256_extract_epi16(b, 0)));
+    case kernel_op::SLL: return _mm256_sll_epi16(a, _mm_cvtsi32_si128(_mm256_extract_epi16(b, 0)));
+    }
+    return a;
+}
+
+__attribute__((target("avx2")))
+void applyRegisterAvx2(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                       const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+    for (std::uint32_t lane = 0; lane < lanes; lane += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(&dst[lane]));
+        __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(&src[lane]));
+        __m256i m = _mm256_load_si256(reinterpret_cast<const __m256i*>(&mask[lane]));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&dst[lane]), _mm256_blendv_epi8(a, applyAvx2(op, a, b), m));
+    }
+}
+
+__attribute__((target("avx2")))
+void applyImmediateAvx2(const kernel_op op, cpu_register_t* const dst, const cpu_register_t value,
+                        const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+    const __m256i b = _mm256_set1_epi16((short)value);
+    for (std::uint32_t lane = 0; lane < lanes; lane += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(&dst[lane]));
+        __m256i m = _mm256_load_si256(reinterpret_cast<const __m256i*>(&mask[lane]));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&dst[lane]), _mm256_blendv_epi8(a, applyAvx2(op, a, b), m));
+    }
+}
+
+// There are no 16-bit variable shifts in AVX2, so lanes are widened to 32 bits
+__attribute__((target("avx2")))
+bool shiftRegisterAvx2(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                       const cpu_register_t* const mask, cpu_register_t* const errors, const std::uint32_t lanes)
+{
+    const __m256i maxShift = _mm256_set1_epi16(registerBits);
+    const __m256i lowerHalf = _mm256_set1_epi32(0xffff);
+    __m256i anyErrors = _mm256_setzero_si256();
+    for (std::uint32_t lane = 0; lane < lanes; lane += 16) {
+        __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(&dst[lane]));
+        __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(&src[lane]));
+        __m256i m = _mm256_load_si256(reinterpret_cast<const __m256i*>(&mask[lane]));
+
+        __m256i isValid = _mm256_cmpeq_epi16(_mm256_max_epu16(b, maxShift), maxShift);
+        __m256i laneErrors = _mm256_andnot_si256(isValid, m);
+        m = _mm256_and_si256(m, isValid);
+        anyErrors = _mm256_or_si256(anyErrors, laneErrors);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&errors[lane]), laneErrors);
+
+        __m256i lowA = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(a));
+        __m256i highA = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(a, 1));
+        __m256i lowB = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(b));
+        __m256i highB = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(b, 1));
+        if (op == kernel_op::SRL) {
+            lowA = _mm256_srlv_epi32(lowA, lowB);
+            highA = _mm256_srlv_epi32(highA, highB);
+        }
+        else {
+            lowA = _mm256_and_si256(_mm256_sllv_epi32(lowA, lowB), lowerHalf);
+            highA = _mm256_and_si256(_mm256_sllv_epi32(highA, highB), lowerHalf);
+        }
+        __m256i result = _mm256_permute4x64_epi64(_mm256_packus_epi32(lowA, highA), 0xd8);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&dst[lane]), _mm256_blendv_epi8(a, result, m));
+    }
+    return !_mm256_testz_si256(anyErrors, anyErrors);
+}
+
+kernel_isa detectIsa()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return kernel_isa::AVX2;
+    return kernel_isa::SSE2;
+}
+
+#else
+
+kernel_isa detectIsa()
+{
+    return kernel_isa::SCALAR;
+}
+
+#endif
+
+kernel_isa& currentIsa()
+{
+    static kernel_isa isa = detectIsa();
+    return isa;
+}
+
+}
+
+kernel_isa getIsa()
+{
+    return currentIsa();
+}
+
+void setIsa(const kernel_isa isa)
+{
+    if (isa <= detectIsa())
+        currentIsa() = isa;
+}
+
+void applyRegister(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                   const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+#ifdef BATCH_KERNELS_X86
+    if (op != kernel_op::SRL && op != kernel_op::SLL) {
+        if (currentIsa() == kernel_isa::AVX2)
+            return applyRegisterAvx2(op, dst, src, mask, lanes);
+        if (currentIsa() == kernel_isa::SSE2)
+            return applyRegisterSse2(op, dst, src, mask, lanes);
+    }
+#endif
+    applyRegisterScalar(op, dst, src, mask, 0, lanes);
+}
+
+void applyImmediate(const kernel_op op, cpu_register_t* const dst, const cpu_register_t value,
+                    const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+#ifdef BATCH_KERNELS_X86
+    if (currentIsa() == kernel_isa::AVX2)
+        return applyImmediateAvx2(op, dst, value, mask, lanes);
+    if (currentIsa() == kernel_isa::SSE2)
+        return applyImmediateSse2(op, dst, value, mask, lanes);
+#endif
+    applyImmediateScalar(op, dst, value, mask, 0, lanes);
+}
+
+void merge(cpu_register_t* const dst, const cpu_register_t keepMask, const cpu_register_t value,
+           const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+    // and + or over all lanes, simple enough to be vectorized by compiler
+    for (std::uint32_t lane = 0; lane < lanes; ++lane)
+        dst[lane] = blend((dst[lane] & keepMask) | value, dst[lane], mask[lane]);
+}
+
+void copy(cpu_register_t* const dst, const cpu_register_t* const src, const cpu_register_t* const mask,
+          const std::uint32_t lanes)
+{
+    for (std::uint32_t lane = 0; lane < lanes; ++lane)
+        dst[lane] = blend(src[lane], dst[lane], mask[lane]);
+}
+
+void bitwiseNot(cpu_register_t* const dst, const cpu_register_t* const mask, const std::uint32_t lanes)
+{
+    for (std::uint32_t lane = 0; lane < lanes; ++lane)
+        dst[lane] ^= mask[lane];
+}
+
+bool shiftRegister(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                   const cpu_register_t* const mask, cpu_register_t* const errors, const std::uint32_t lanes)
+{
+#ifdef BATCH_KERNELS_X86
+    if (currentIsa() == kernel_isa::AVX2)
+        return shiftRegisterAvx2(op, dst, src, mask, errors, lanes);
+#endif
+    return shiftRegisterScalar(op, dst, src, mask, errors, 0, lanes);
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+#include "base.h"
+
+// Lane-parallel kernels of batch_cpu. Every kernel works on struct-of-arrays
+// register rows, lanes count has to be multiple of batch_kernels::laneAlignment
+// and rows have to be aligned to laneAlignment * sizeof(cpu_register_t).
+// Mask row keeps 0xffff for lanes which take part in instruction and 0 for
+// others, result is written only to masked lanes.
+namespace batch_kernels {
+
+enum class kernel_op : std::uint32_t {
+    ADD = 0,
+    SUB,
+    MUL,
+    AND,
+    OR,
+    XOR,
+    SRL,
+    SLL
+};
+
+enum class kernel_isa : std::uint32_t {
+    SCALAR = 0,
+    SSE2,
+    AVX2
+};
+
+constexpr std::uint32_t laneAlignment = 16;
+
+// Best instruction set supported by host, may be lowered for testing
+kernel_isa getIsa();
+void setIsa(const kernel_isa isa);
+
+// dst = dst op src
+void applyRegister(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                   const cpu_register_t* const mask, const std::uint32_t lanes);
+// dst = dst op value, shift amount has to be not more than register size
+void applyImmediate(const kernel_op op, cpu_register_t* const dst, const cpu_register_t value,
+                    const cpu_register_t* const mask, const std::uint32_t lanes);
+// dst = (dst & keepMask) | value
+void merge(cpu_register_t* const dst, const cpu_register_t keepMask, const cpu_register_t value,
+           const cpu_register_t* const mask, const std::uint32_t lanes);
+// dst = src
+void copy(cpu_register_t* const dst, const cpu_register_t* const src, const cpu_register_t* const mask,
+          const std::uint32_t lanes);
+// dst = ~dst
+void bitwiseNot(cpu_register_t* const dst, const cpu_register_t* const mask, const std::uint32_t lanes);
+// dst = dst >> src or dst << src with per-lane amount. Lanes with amount more
+// than register size are not changed, they get 0xffff in errors row.
+// Returns true if there is at least one such lane.
+bool shiftRegister(const kernel_op op, cpu_register_t* const dst, const cpu_register_t* const src,
+                   const cpu_register_t* const mask, cpu_register_t* const errors, const std::uint32_t lanes);
+
+}
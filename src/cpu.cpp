@@ -1,49 +1,337 @@
+#include <fstream>
+
 #include "cpu.h"
+#include "snapshot.h"
+#include "mapped_file.h"
+#include "program_image.h"
+#include "event_log.h"
+
+template <typename Profiler>
+basic_cpu<Profiler>::basic_cpu(const execution_tier tier) : basic_cpu(tier, std::unique_ptr<guest_memory>(new guest_memory())) {}
+
+template <typename Profiler>
+basic_cpu<Profiler>::basic_cpu(const execution_tier tier, std::unique_ptr<guest_memory> _memory) :
+    cpuProperties(geometry()), instructionPtr(0), currentInstruction(nullptr), statusFlags{ instructions::operation::UNKNOWN, 0, 0, 0 },
+    registers{}, memory(std::move(_memory)),
+    decodeTable(instructions::decode_table::getDefaultTable()),
+    fusionTable(), fusionCounts(),
+    jitEngine(tier == execution_tier::JIT && jit_engine::isSupported() ? new jit_engine(cpuProperties, decodeTable) : nullptr) {}
+
+template <typename Profiler>
+basic_cpu<Profiler>::~basic_cpu() {}
 
-cpu::cpu() : cpuProperties(), instructionPtr(nullptr), currentInstruction(nullptr), statusRegister(0),
-             registers(new cpu_register_t[cpuProperties.registersCount]), memory(new std::uint8_t[cpuProperties.memorySize])
+template <typename Profiler>
+std::unique_ptr<basic_cpu<Profiler>> basic_cpu<Profiler>::clone()
 {
-    cpu_register_t opCode = 0x0;
-    cpu_register_t opCodeOffset = 0x1 << (cpuProperties.registerSize - cpuProperties.bitsPerInstruction);
+    return clone(jitEngine ? execution_tier::JIT : execution_tier::INTERPRETER);
+}
 
-    cpuInstructions[opCode] = new instructions::load(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::store(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::load_immediate(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::addition(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::subtraction(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::multiplication(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::shift_right_logical(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
-    cpuInstructions[opCode] = new instructions::shift_left_logical(registers.get(), memory.get(), cpuProperties); opCode += opCodeOffset;
+template <typename Profiler>
+std::unique_ptr<basic_cpu<Profiler>> basic_cpu<Profiler>::clone(const execution_tier tier)
+{
+    std::unique_ptr<basic_cpu> copy(new basic_cpu(tier, memory->clone()));
+    copy->instructionPtr = instructionPtr;
+    copy->statusFlags = statusFlags;
+    copy->fusionTable = fusionTable;
+    copy->registers = registers;
+    return copy;
 }
 
-cpu::~cpu()
+template <typename Profiler>
+void basic_cpu<Profiler>::reset()
 {
-    for (auto instruction : cpuInstructions)
-        delete instruction.second;
+    instructionPtr = 0;
+    currentInstruction = nullptr;
+    statusFlags = { instructions::operation::UNKNOWN, 0, 0, 0 };
+    registers.fill(0);
+    memory->reset();
+    fusionCounts.fill(0);
+    if constexpr (Profiler::isReversible)
+        profiler.clear();
+    if (jitEngine)
+        jitEngine->flush();
 }
 
-status cpu::decodeInstruction()
+template <typename Profiler>
+status basic_cpu<Profiler>::decodeInstruction()
 {
     status st = status::STATUS_OK;
-    cpu_register_t instruction = *instructionPtr;
-    cpu_register_t instructionOpCode = cpuProperties.instructionMask & instruction;
-    currentInstruction = cpuInstructions[instructionOpCode];
-    currentInstruction->setCurrentInstruction(instruction);
-    if ((st = currentInstruction->decodeOperands()) < status::UNKNOWN_WARNING) {
-        std::cerr << "Error: cpu::decodeInstruction, code - " << (int)st << std::endl;
+    if (instructionPtr > cpuProperties.memorySize - sizeof(cpu_register_t)) {
+        st = status::OUT_OF_MEMORY_ERROR;
+        event_log::getDefault().push(log_record::make("cpu::decodeInstruction", st, instructionPtr));
+        return st;
+    }
+
+    currentInstruction = &(*decodeTable)[memory->readWord(instructionPtr)];
+    if (currentInstruction->op == instructions::operation::UNKNOWN) {
+        st = status::DECODE_UNKNOWN_INSTRUCTION;
+        event_log::getDefault().push(log_record::make("cpu::decodeInstruction", st, instructionPtr));
         return st;
     }
 
     return st;
 }
 
-status cpu::executeInstruction()
+template <typename Profiler>
+status basic_cpu<Profiler>::executeInstruction()
 {
-    status st = status::STATUS_OK;
-    if ((st = currentInstruction->executeInstruction()) < status::UNKNOWN_WARNING) {
-        std::cerr << "Error: cpu::executeInstruction, code - " << (int)st << std::endl;
+    status st = status::ATTEMPT_TO_EXECUTE_UNKNOWN_INSTRUCTION;
+    if (currentInstruction) {
+        std::uint32_t storeAddress = instructions::getEfficientAddress(registers[currentInstruction->dstRegisterIndex],
+                                                                       currentInstruction->immediate);
+        std::uint32_t loadAddress = instructions::getEfficientAddress(registers[currentInstruction->srcRegisterIndex],
+                                                                      currentInstruction->immediate);
+        const instructions::operation op = currentInstruction->op;
+        const cpu_register_t left = registers[currentInstruction->dstRegisterIndex];
+        const cpu_register_t right = instructions::lazy_flags::getRightOperand(*currentInstruction, registers.data());
+        if constexpr (Profiler::isEnabled)
+            profiler.onBeforeExecute(instructionPtr, *currentInstruction, registers.data(), statusFlags, *memory);
+        st = currentInstruction->handler(*currentInstruction, registers.data(), *memory, cpuProperties);
+        if (instructions::lazy_flags::isFlagSetting(op) && st >= status::UNKNOWN_WARNING)
+            statusFlags.set(op, left, right, registers[currentInstruction->dstRegisterIndex]);
+        // Target is resolved before call writes link register
+        bool isTaken = instructions::isControlFlow(op);
+        if (op == instructions::operation::BRANCH_IF_SET || op == instructions::operation::BRANCH_IF_CLEAR)
+            isTaken = statusFlags.isSet(0x1 << currentInstruction->srcRegisterIndex) == (op == instructions::operation::BRANCH_IF_SET);
+        const std::uint32_t target = instructions::control_flow_base::getTarget(instructionPtr, *currentInstruction, registers.data());
+        if (op == instructions::operation::CALL_REGISTER || op == instructions::operation::CALL_IMMEDIATE)
+            registers[currentInstruction->dstRegisterIndex] = instructionPtr + sizeof(cpu_register_t);
+        if constexpr (Profiler::isEnabled) {
+            std::uint32_t memoryAddress = noMemoryAccess;
+            if (currentInstruction->op == instructions::operation::LOAD)
+                memoryAddress = loadAddress;
+            else if (currentInstruction->op == instructions::operation::STORE)
+                memoryAddress = storeAddress;
+            profiler.onExecute({ instructionPtr, memory->readWord(instructionPtr), *currentInstruction, memoryAddress,
+                                 registers.data(), st });
+        }
+        if (isTaken)
+            instructionPtr = target - sizeof(cpu_register_t);
+        if (jitEngine && currentInstruction->op == instructions::operation::STORE && storeAddress < cpuProperties.memorySize)
+            jitEngine->invalidate(storeAddress, sizeof(cpu_register_t));
+        if (jitEngine && currentInstruction->op == instructions::operation::VECTOR_STORE && st == status::STATUS_OK)
+            jitEngine->invalidate(storeAddress, instructions::vectorSize);
+    }
+    if (st < status::UNKNOWN_WARNING) {
+        if (currentInstruction)
+            event_log::getDefault().push(log_record::make("cpu::executeInstruction", st, instructionPtr, *currentInstruction));
+        else
+            event_log::getDefault().push(log_record::make("cpu::executeInstruction", st, instructionPtr));
         return st;
     }
 
     return st;
 }
+
+template <typename Profiler>
+run_result basic_cpu<Profiler>::run(const std::uint64_t maxInstructions)
+{
+    if (jitEngine && !Profiler::isEnabled)
+        return runTranslated(maxInstructions);
+    if (fusionTable && !Profiler::isEnabled)
+        return runLoop(fused_predicate(), maxInstructions);
+    return runLoop(no_predicate(), maxInstructions);
+}
+
+template <typename Profiler>
+status basic_cpu<Profiler>::saveSnapshot(const std::string& path) const
+{
+    std::uint8_t headerPage[guest_memory::pageSize] = {};
+    snapshot_header header = {};
+    std::memcpy(header.magic, snapshot_header::magicValue, sizeof(header.magic));
+    header.version = snapshot_header::currentVersion;
+    header.pageSize = guest_memory::pageSize;
+    header.memoryOffset = guest_memory::pageSize;
+    header.memorySize = cpuProperties.memorySize;
+    header.registersCount = cpuProperties.registersCount;
+    header.registerSize = cpuProperties.registerSize;
+    header.instructionPtr = instructionPtr;
+    header.statusRegister = statusFlags.get();
+    std::memcpy(header.registers, registers.data(), sizeof(header.registers));
+    std::memcpy(header.vectorRegisters, getVectorRegister(0), sizeof(header.vectorRegisters));
+    std::memcpy(headerPage, &header, sizeof(header));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(headerPage), sizeof(headerPage));
+    for (std::uint32_t page = 0; page < cpuProperties.memorySize >> guest_memory::pageShift; ++page)
+        file.write(reinterpret_cast<const char*>(memory->getReadPages()[page]), guest_memory::pageSize);
+    file.close();
+    if (!file) {
+        event_log::getDefault().push(log_record::make("cpu::saveSnapshot", status::FILE_ACCESS_ERROR));
+        return status::FILE_ACCESS_ERROR;
+    }
+    return status::STATUS_OK;
+}
+
+template <typename Profiler>
+status basic_cpu<Profiler>::loadSnapshot(const std::string& path)
+{
+    std::shared_ptr<mapped_file> file = mapped_file::open(path);
+    if (!file) {
+        event_log::getDefault().push(log_record::make("cpu::loadSnapshot", status::FILE_ACCESS_ERROR));
+        return status::FILE_ACCESS_ERROR;
+    }
+
+    snapshot_header header;
+    bool isValid = file->size() >= sizeof(header);
+    if (isValid) {
+        std::memcpy(&header, file->data(), sizeof(header));
+        isValid = !std::memcmp(header.magic, snapshot_header::magicValue, sizeof(header.magic)) &&
+                  header.version == snapshot_header::currentVersion &&
+                  header.pageSize == guest_memory::pageSize &&
+                  header.memoryOffset % guest_memory::pageSize == 0 &&
+                  header.memorySize == cpuProperties.memorySize &&
+                  header.registersCount == cpuProperties.registersCount &&
+                  header.registerSize == cpuProperties.registerSize &&
+                  (std::uint64_t)header.memoryOffset + header.memorySize <= file->size();
+    }
+    if (!isValid) {
+        event_log::getDefault().push(log_record::make("cpu::loadSnapshot", status::FILE_FORMAT_ERROR));
+        return status::FILE_FORMAT_ERROR;
+    }
+
+    memory->mapPages(file, file->data() + header.memoryOffset, 0, header.memorySize >> guest_memory::pageShift);
+    std::memcpy(registers.data(), header.registers, sizeof(header.registers));
+    std::memcpy(getVectorRegister(0), header.vectorRegisters, sizeof(header.vectorRegisters));
+    statusFlags.assign(header.statusRegister);
+    instructionPtr = header.instructionPtr;
+    currentInstruction = nullptr;
+    if constexpr (Profiler::isReversible)
+        profiler.clear();
+    if (jitEngine)
+        jitEngine->flush();
+    return status::STATUS_OK;
+}
+
+template <typename Profiler>
+status basic_cpu<Profiler>::saveTranslations(const std::string& path) const
+{
+    const status st = jitEngine ? jitEngine->save(path, *memory) : status::UNKNOWN_ERROR;
+    if (st != status::STATUS_OK)
+        event_log::getDefault().push(log_record::make("cpu::saveTranslations", st));
+    return st;
+}
+
+template <typename Profiler>
+status basic_cpu<Profiler>::loadTranslations(const std::string& path)
+{
+    const status st = jitEngine ? jitEngine->load(path, *memory) : status::UNKNOWN_ERROR;
+    if (st != status::STATUS_OK)
+        event_log::getDefault().push(log_record::make("cpu::loadTranslations", st));
+    return st;
+}
+
+template <typename Profiler>
+status basic_cpu<Profiler>::loadImage(const std::string& path)
+{
+    std::uint32_t entry;
+    status st = program_image::load(path, *memory, entry);
+    if (st != status::STATUS_OK) {
+        event_log::getDefault().push(log_record::make("cpu::loadImage", st));
+        return st;
+    }
+    instructionPtr = entry;
+    currentInstruction = nullptr;
+    if constexpr (Profiler::isReversible)
+        profiler.clear();
+    if (jitEngine)
+        jitEngine->flush();
+    return status::STATUS_OK;
+}
+
+template <typename Profiler>
+void basic_cpu<Profiler>::mapImage(const shared_image& image)
+{
+    image.map(*memory);
+    instructionPtr = image.getEntry();
+    currentInstruction = nullptr;
+    if constexpr (Profiler::isReversible)
+        profiler.clear();
+    if (jitEngine)
+        jitEngine->flush();
+}
+
+template <typename Profiler>
+std::uint64_t basic_cpu<Profiler>::stepBack(const std::uint64_t count)
+{
+    if constexpr (Profiler::isReversible) {
+        const std::uint64_t reverted = profiler.undo(count, instructionPtr, registers.data(), statusFlags, *memory);
+        currentInstruction = nullptr;
+        if (jitEngine && reverted)
+            jitEngine->flush();
+        return reverted;
+    }
+    return 0;
+}
+
+template <typename Profiler>
+void basic_cpu<Profiler>::invalidateCode(const std::uint32_t address, const std::uint32_t size)
+{
+    if (jitEngine && size)
+        jitEngine->invalidate(address, size);
+}
+
+// Dispatcher of JIT tier. Translated blocks run until they leave translated
+// code, everything they can not handle is executed by interpreter loop.
+template <typename Profiler>
+run_result basic_cpu<Profiler>::runTranslated(const std::uint64_t maxInstructions)
+{
+    const std::uint32_t lastInstructionAddress = cpuProperties.memorySize - sizeof(cpu_register_t);
+    jit_context context = { registers.data(), memory->getReadPages(), jitEngine->getCodePages(), memory->getWritePages(),
+                            0, 0, jit_exit_reason::CHAIN, 0, statusFlags };
+
+    run_result result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+    bool isChainable = false;
+    while (result.retiredInstructions < maxInstructions) {
+        const std::uint64_t budget = maxInstructions - result.retiredInstructions;
+        if (instructionPtr > lastInstructionAddress) {
+            result.reason = stop_reason::END_OF_MEMORY;
+            result.lastStatus = status::OUT_OF_MEMORY_ERROR;
+            break;
+        }
+
+        jit_engine::block* codeBlock = jitEngine->getBlock(instructionPtr, *memory);
+        if (codeBlock && isChainable)
+            jitEngine->chain(context.exitBlock, codeBlock);
+        isChainable = false;
+
+        std::uint64_t interpreted = 0;
+        if (codeBlock) {
+            context.budget = budget > INT64_MAX ? INT64_MAX : budget;
+            const std::int64_t entryBudget = context.budget;
+            context.flags = statusFlags;
+            jitEngine->execute(codeBlock, context);
+            statusFlags = context.flags;
+
+            result.retiredInstructions += entryBudget - context.budget;
+            result.lastStatus = status::STATUS_OK;
+            instructionPtr = context.exitAddress;
+            if (context.exitReason == jit_exit_reason::CHAIN)
+                isChainable = true;
+            else if (context.exitReason == jit_exit_reason::SIDE_EXIT)
+                interpreted = 1;
+            else
+                interpreted = maxInstructions - result.retiredInstructions;
+        }
+        else {
+            interpreted = 1;
+        }
+
+        if (interpreted) {
+            run_result stepResult = runLoop(no_predicate(), interpreted);
+            result.retiredInstructions += stepResult.retiredInstructions;
+            result.lastStatus = stepResult.lastStatus;
+            if (stepResult.reason != stop_reason::INSTRUCTIONS_LIMIT) {
+                result.reason = stepResult.reason;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+template class basic_cpu<no_profiler>;
+template class basic_cpu<opcode_profiler>;
+template class basic_cpu<trace_recorder>;
+template class basic_cpu<undo_log>;
@@ -1,28 +1,521 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <string>
-#include <map>
+#include <cstring>
 #include <iostream>
+#include <type_traits>
 
 #include "base.h"
 #include "instructions.h"
+#include "decode_table.h"
+#include "fusion.h"
+#include "flags.h"
+#include "guest_memory.h"
+#include "shared_image.h"
+#include "profiler.h"
+#include "trace.h"
+#include "undo_log.h"
+#include "jit.h"
 
-class cpu {
+enum class stop_reason : std::int32_t {
+    INSTRUCTIONS_LIMIT = 0,
+    PREDICATE,
+    ERROR,
+    END_OF_MEMORY
+};
+
+enum class execution_tier : std::int32_t {
+    INTERPRETER = 0,
+    JIT // falls back to interpreter if host is not supported
+};
+
+struct run_result {
+    std::uint64_t retiredInstructions;
+    stop_reason reason;
+    status lastStatus; // status of the last executed instruction
+};
+
+// Profiler is a compile time policy, see profiler.h. Default cpu uses
+// no_profiler, so its run loop has no instrumentation at all.
+template <typename Profiler>
+class basic_cpu {
 public:
-    cpu();
-    ~cpu();
+    // Geometry is fixed at compile time, so run loop works with constants.
+    // cpuProperties keeps the same values for runtime handlers.
+    using geometry = default_cpu_properties;
+
+    explicit basic_cpu(const execution_tier tier = execution_tier::INTERPRETER);
+    ~basic_cpu();
+
+    // New cpu with the same registers and state, memory pages are shared
+    // copy-on-write, so cost depends only on pages touched later
+    std::unique_ptr<basic_cpu> clone();
+    std::unique_ptr<basic_cpu> clone(const execution_tier tier);
+    // Returns cpu to the state of a new instance without freeing anything:
+    // registers, flags and instructionPtr are zeroed, memory is zeroed in
+    // place, translations are dropped. Fusion table and profiler statistics
+    // are kept, fusion counts and history of reversible profiler are cleared.
+    void reset();
 
     status decodeInstruction();
+    // Does not move instructionPtr to the next instruction, taken control
+    // flow instruction sets it one word before target, so caller which steps
+    // to the next word continues from target.
     status executeInstruction();
+
+    // Fetch, decode and execute instructions starting at instructionPtr until
+    // maxInstructions are retired or an error happens. Instruction that ended
+    // with error is not retired and instructionPtr keeps pointing to it.
+    run_result run(const std::uint64_t maxInstructions);
+    // Same as run, but also stops after instruction for which
+    // predicate(const basic_cpu&) returns true.
+    // Always uses interpreter, because predicate is checked after each instruction.
+    template <typename Predicate>
+    run_result runUntil(Predicate predicate, const std::uint64_t maxInstructions = (std::uint64_t)-1);
+
+    // Snapshot keeps scalar and vector registers, statusRegister,
+    // instructionPtr and memory. Loaded memory pages are mapped from the file
+    // and copied on write, so loading does not depend on memory size.
+    status saveSnapshot(const std::string& path) const;
+    status loadSnapshot(const std::string& path);
+
+    // JIT translations of guest code, so later processes skip translating.
+    // Loading keeps current translations and fails with FILE_STALE_ERROR if
+    // code in memory differs from code the file was made for, damaged file
+    // fails with FILE_FORMAT_ERROR or FILE_CHECKSUM_ERROR. Interpreter cpus
+    // have no translations and fail with UNKNOWN_ERROR.
+    status saveTranslations(const std::string& path) const;
+    status loadTranslations(const std::string& path);
+
+    // Places segments of program image into memory and sets instructionPtr
+    // to its entry point, registers are kept. See program_image.h.
+    status loadImage(const std::string& path);
+    // Maps pages of image shared with other cpus and sets instructionPtr to
+    // its entry point, registers are kept. See shared_image.h.
+    void mapImage(const shared_image& image);
+
+    // Reverts the last count retired instructions, changes made by host are
+    // kept. Returns count of reverted instructions, it is limited by history
+    // of reversible profiler, other cpus can not step back.
+    std::uint64_t stepBack(const std::uint64_t count);
+
+    // Memory written through getMemory() is not tracked by JIT tier, so
+    // translations of modified code have to be dropped explicitly.
+    void invalidateCode(const std::uint32_t address, const std::uint32_t size);
+
+    // Interpreter executes pairs from fusion table with one dispatch, fusion
+    // is disabled by default and by nullptr. Head is matched with the next
+    // word when it is decoded, so pairs always follow the current code. Runs
+    // with enabled profiler or predicate check every instruction, so they
+    // never fuse, JIT tier translates hot code itself and ignores the table.
+    inline void setFusionTable(std::shared_ptr<const instructions::fusion_table> table) { fusionTable = std::move(table); }
+    inline std::uint64_t getFusionCount(const instructions::operation fused) const
+    {
+        return instructions::isFused(fused) ? fusionCounts[(std::uint32_t)fused - instructions::operationsCount] : 0;
+    }
+
+    // Flag bits of the last add, sub, mul or shift, see flags.h
+    inline cpu_register_t getStatusRegister() const { return statusFlags.get(); }
+    inline void setStatusRegister(const cpu_register_t value) { statusFlags.assign(value); }
+
+    inline void setInstructionPtr(const std::uint32_t address) { instructionPtr = address; }
+    inline std::uint32_t getInstructionPtr() const { return instructionPtr; }
+    inline cpu_register_t* getRegisters() { return registers.data(); }
+    inline const cpu_register_t* getRegisters() const { return registers.data(); }
+    // Bytes of register of vector extension, see packed_vector
+    inline std::uint8_t* getVectorRegister(const std::uint32_t index)
+    {
+        return instructions::getVectorRegister(registers.data(), geometry::registersCount, index);
+    }
+    inline const std::uint8_t* getVectorRegister(const std::uint32_t index) const
+    {
+        return instructions::getVectorRegister(registers.data(), geometry::registersCount, index);
+    }
+    inline guest_memory& getMemory() { return *memory; }
+    inline const guest_memory& getMemory() const { return *memory; }
+    inline Profiler& getProfiler() { return profiler; }
+    inline const Profiler& getProfiler() const { return profiler; }
 private:
+    struct no_predicate {
+        inline bool operator()(const basic_cpu&) const { return false; }
+    };
+    // Selects loop which dispatches fused pairs, so the plain one pays
+    // nothing for them
+    struct fused_predicate : no_predicate {};
+
+    basic_cpu(const execution_tier tier, std::unique_ptr<guest_memory> _memory);
+
+    template <typename Predicate>
+    run_result runLoop(Predicate predicate, const std::uint64_t maxInstructions);
+    run_result runTranslated(const std::uint64_t maxInstructions);
+
+    static constexpr std::uint32_t noFetchPage = 0x80000000; // fetchBase of interpreter with no cached page
+    static constexpr std::uint32_t fusionPairSize = 2 * sizeof(cpu_register_t);
+
     cpu_base_properties cpuProperties;
 
-    cpu_register_t* instructionPtr;
-    instructions::instruction_base* currentInstruction;
+    std::uint32_t instructionPtr; // address of current instruction in memory
+    const instructions::decoded_instruction* currentInstruction;
 
-    cpu_register_t statusRegister;
-    const std::unique_ptr<cpu_register_t[]> registers;
-    const std::unique_ptr<std::uint8_t[]> memory;
-    std::map<cpu_register_t, instructions::instruction_base*> cpuInstructions;
+    instructions::lazy_flags statusFlags; // status register
+    std::array<cpu_register_t, geometry::registersCount + instructions::vectorBankWords> registers; // vector bank follows scalar ones
+    const std::unique_ptr<guest_memory> memory;
+    const std::shared_ptr<const instructions::decode_table> decodeTable;
+    std::shared_ptr<const instructions::fusion_table> fusionTable;
+    std::array<std::uint64_t, instructions::fusedOperationsCount> fusionCounts;
+    const std::unique_ptr<jit_engine> jitEngine;
+    Profiler profiler;
 };
+
+using cpu = basic_cpu<no_profiler>;
+using profiled_cpu = basic_cpu<opcode_profiler>;
+using traced_cpu = basic_cpu<trace_recorder>;
+using reversible_cpu = basic_cpu<undo_log>;
+
+template <typename Profiler>
+template <typename Predicate>
+run_result basic_cpu<Profiler>::runUntil(Predicate predicate, const std::uint64_t maxInstructions)
+{
+    return runLoop(predicate, maxInstructions);
+}
+
+// Interpreter core, register only instructions and in-bounds memory accesses
+// are executed inline, edge cases go to the instruction handlers.
+template <typename Profiler>
+template <typename Predicate>
+run_result basic_cpu<Profiler>::runLoop(Predicate predicate, const std::uint64_t maxInstructions)
+{
+    using instructions::operation;
+
+    cpu_register_t* const regs = registers.data();
+    guest_memory& mem = *memory;
+    const instructions::decode_table& table = *decodeTable;
+    instructions::lazy_flags& flags = statusFlags;
+    const instructions::fusion_table* const fusion = fusionTable.get();
+    constexpr bool isFusable = !Profiler::isEnabled && std::is_same<Predicate, fused_predicate>::value;
+    constexpr std::uint32_t lastWordAddress = geometry::memorySize - sizeof(cpu_register_t);
+    constexpr std::uint32_t registerSize = geometry::registerSize;
+    constexpr std::uint32_t halfRegisterSize = BITS_IN_BYTE * (sizeof(cpu_register_t) / 2);
+    constexpr cpu_register_t lowerHalfMask = (cpu_register_t)-1 >> halfRegisterSize;
+
+    run_result result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+    std::uint32_t fetchBase = noFetchPage;
+    const std::uint8_t* fetchPage = nullptr;
+    std::uint32_t pc = instructionPtr;
+    while (result.retiredInstructions < maxInstructions) {
+        if (pc > lastWordAddress) {
+            result.reason = stop_reason::END_OF_MEMORY;
+            result.lastStatus = status::OUT_OF_MEMORY_ERROR;
+            break;
+        }
+
+        // Fetch page is cached while pc stays inside of it, stores drop it,
+        // because they can replace the page with its private copy
+        cpu_register_t instruction;
+        if (pc - fetchBase <= guest_memory::pageSize - sizeof(cpu_register_t)) {
+            std::memcpy(&instruction, fetchPage + (pc - fetchBase), sizeof(instruction));
+        }
+        else {
+            instruction = mem.readWord(pc);
+            fetchBase = pc & ~guest_memory::pageMask;
+            fetchPage = mem.getReadPages()[pc >> guest_memory::pageShift];
+        }
+        const instructions::decoded_instruction& operands = table[instruction];
+        const std::uint32_t dst = operands.dstRegisterIndex;
+        const std::uint32_t src = operands.srcRegisterIndex;
+
+        // Heads decode the next word of their fetch page and jump to the case
+        // of the pair they form, the last instruction of budget runs alone
+        operation op = operands.op;
+        const instructions::decoded_instruction* next = nullptr;
+        const auto matchPair = [&]() -> operation {
+            if (pc - fetchBase > guest_memory::pageSize - fusionPairSize || maxInstructions - result.retiredInstructions < 2)
+                return operands.op;
+            cpu_register_t word;
+            std::memcpy(&word, fetchPage + (pc - fetchBase) + sizeof(cpu_register_t), sizeof(word));
+            next = &table[word];
+            return fusion->match(operands, *next);
+        };
+        const auto retireNext = [&]() -> const instructions::decoded_instruction& {
+            ++result.retiredInstructions;
+            ++fusionCounts[(std::uint32_t)op - instructions::operationsCount];
+            return *next;
+        };
+
+        profiler.onBeforeExecute(pc, operands, regs, flags, mem);
+        status st = status::STATUS_OK;
+        std::uint32_t nextPc = pc + sizeof(cpu_register_t);
+        std::uint32_t memoryAddress = noMemoryAccess;
+        switch (op) {
+        case operation::LOAD: {
+            if constexpr (isFusable) {
+                op = matchPair();
+                if (op == operation::FUSED_LOAD_ADD)
+                    goto fusedLoadAdd;
+            }
+            std::uint32_t address = instructions::getEfficientAddress(regs[src], operands.immediate);
+            memoryAddress = address;
+            if (address <= lastWordAddress)
+                regs[dst] = mem.readWord(address);
+            else
+                st = instructions::load::execute(operands, regs, mem, cpuProperties);
+            break;
+        }
+        case operation::STORE: {
+            std::uint32_t address = instructions::getEfficientAddress(regs[dst], operands.immediate);
+            memoryAddress = address;
+            if (address <= lastWordAddress)
+                mem.writeWord(address, regs[src]);
+            else
+                st = instructions::store::execute(operands, regs, mem, cpuProperties);
+            fetchBase = noFetchPage;
+            if (jitEngine && address < geometry::memorySize && jitEngine->isCodeAddress(address))
+                jitEngine->invalidate(address, sizeof(cpu_register_t));
+            break;
+        }
+        case operation::LOAD_IMMEDIATE_LOWER:
+            if constexpr (isFusable) {
+                op = matchPair();
+                if (op == operation::FUSED_LOAD_IMMEDIATE_PAIR)
+                    goto fusedLoadImmediatePair;
+                if (op == operation::FUSED_LOAD_IMMEDIATE_ADD)
+                    goto fusedLoadImmediateAdd;
+            }
+            regs[dst] = (regs[dst] & ~lowerHalfMask) | operands.immediate;
+            break;
+        case operation::LOAD_IMMEDIATE_UPPER:
+            if constexpr (isFusable) {
+                op = matchPair();
+                if (op == operation::FUSED_LOAD_IMMEDIATE_ADD)
+                    goto fusedLoadImmediateAdd;
+            }
+            regs[dst] = (regs[dst] & lowerHalfMask) | (operands.immediate << halfRegisterSize);
+            break;
+        // Flag setting operations only record their operands and result
+        case operation::ADD_REGISTER: {
+            const cpu_register_t left = regs[dst];
+            const cpu_register_t right = regs[src];
+            regs[dst] = left + right;
+            flags.set(operation::ADD_REGISTER, left, right, regs[dst]);
+            break;
+        }
+        case operation::ADD_IMMEDIATE: {
+            const cpu_register_t left = regs[dst];
+            regs[dst] = left + operands.immediate;
+            flags.set(operation::ADD_IMMEDIATE, left, operands.immediate, regs[dst]);
+            break;
+        }
+        case operation::SUB_REGISTER: {
+            if constexpr (isFusable) {
+                op = matchPair();
+                if (op == operation::FUSED_SUB_BRANCH)
+                    goto fusedSubBranch;
+            }
+            const cpu_register_t left = regs[dst];
+            const cpu_register_t right = regs[src];
+            regs[dst] = left - right;
+            flags.set(operation::SUB_REGISTER, left, right, regs[dst]);
+            break;
+        }
+        case operation::SUB_IMMEDIATE: {
+            if constexpr (isFusable) {
+                op = matchPair();
+                if (op == operation::FUSED_SUB_BRANCH)
+                    goto fusedSubBranch;
+            }
+            const cpu_register_t left = regs[dst];
+            regs[dst] = left - operands.immediate;
+            flags.set(operation::SUB_IMMEDIATE, left, operands.immediate, regs[dst]);
+            break;
+        }
+        case operation::MUL_REGISTER: {
+            const cpu_register_t left = regs[dst];
+            const cpu_register_t right = regs[src];
+            regs[dst] = left * right;
+            flags.set(operation::MUL_REGISTER, left, right, regs[dst]);
+            break;
+        }
+        case operation::MUL_IMMEDIATE: {
+            const cpu_register_t left = regs[dst];
+            regs[dst] = left * operands.immediate;
+            flags.set(operation::MUL_IMMEDIATE, left, operands.immediate, regs[dst]);
+            break;
+        }
+        case operation::SRL_REGISTER: {
+            const cpu_register_t left = regs[dst];
+            const cpu_register_t right = regs[src];
+            if (right > registerSize) {
+                st = status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
+                break;
+            }
+            regs[dst] = left >> right;
+            flags.set(operation::SRL_REGISTER, left, right, regs[dst]);
+            break;
+        }
+        case operation::SRL_IMMEDIATE: {
+            const cpu_register_t left = regs[dst];
+            if (operands.immediate > registerSize) {
+                st = status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
+                break;
+            }
+            regs[dst] = left >> operands.immediate;
+            flags.set(operation::SRL_IMMEDIATE, left, operands.immediate, regs[dst]);
+            break;
+        }
+        case operation::SLL_REGISTER: {
+            const cpu_register_t left = regs[dst];
+            const cpu_register_t right = regs[src];
+            if (right > registerSize) {
+                st = status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
+                break;
+            }
+            regs[dst] = left << right;
+            flags.set(operation::SLL_REGISTER, left, right, regs[dst]);
+            break;
+        }
+        case operation::SLL_IMMEDIATE: {
+            const cpu_register_t left = regs[dst];
+            if (operands.immediate > registerSize) {
+                st = status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
+                break;
+            }
+            regs[dst] = left << operands.immediate;
+            flags.set(operation::SLL_IMMEDIATE, left, operands.immediate, regs[dst]);
+            break;
+        }
+        case operation::NOT:
+            regs[dst] = ~regs[dst];
+            break;
+        case operation::AND:
+            regs[dst] &= regs[src];
+            break;
+        case operation::OR:
+            regs[dst] |= regs[src];
+            break;
+        case operation::XOR:
+            regs[dst] ^= regs[src];
+            break;
+        // Relative targets are resolved at decode, taken branch reuses
+        // cached fetch page if target is on the same page
+        case operation::JUMP:
+            nextPc = (cpu_register_t)(pc + operands.immediate);
+            break;
+        case operation::BRANCH_IF_SET:
+            if (flags.isSet(0x1 << src))
+                nextPc = (cpu_register_t)(pc + operands.immediate);
+            break;
+        case operation::BRANCH_IF_CLEAR:
+            if (!flags.isSet(0x1 << src))
+                nextPc = (cpu_register_t)(pc + operands.immediate);
+            break;
+        case operation::CALL_REGISTER:
+        case operation::CALL_IMMEDIATE:
+            nextPc = instructions::control_flow_base::getTarget(pc, operands, regs);
+            regs[dst] = pc + sizeof(cpu_register_t);
+            break;
+        case operation::RETURN:
+            nextPc = regs[src];
+            break;
+        case operation::VECTOR_STORE: {
+            const std::uint32_t address = regs[dst];
+            st = instructions::packed_vector::execute(operands, regs, mem, cpuProperties);
+            fetchBase = noFetchPage;
+            if (jitEngine && st == status::STATUS_OK)
+                jitEngine->invalidate(address, instructions::vectorSize);
+            break;
+        }
+        case operation::VECTOR_ADD:
+        case operation::VECTOR_SUB:
+        case operation::VECTOR_AND:
+        case operation::VECTOR_OR:
+        case operation::VECTOR_XOR:
+        case operation::VECTOR_COMPARE_EQUAL:
+        case operation::VECTOR_LOAD:
+            st = instructions::packed_vector::execute(operands, regs, mem, cpuProperties);
+            break;
+        // Fused pairs retire both instructions, flags and memory match the
+        // unfused run. Heads jump to their labels, loops without fusion never
+        // do, so their copies of the cases stay empty and labels unused.
+        case operation::FUSED_LOAD_IMMEDIATE_PAIR:
+        fusedLoadImmediatePair: __attribute__((unused));
+            if constexpr (isFusable) {
+                const instructions::decoded_instruction& upper = retireNext();
+                regs[dst] = operands.immediate | (upper.immediate << halfRegisterSize);
+                nextPc += sizeof(cpu_register_t);
+            }
+            break;
+        case operation::FUSED_LOAD_IMMEDIATE_ADD:
+        fusedLoadImmediateAdd: __attribute__((unused));
+            if constexpr (isFusable) {
+                const instructions::decoded_instruction& add = retireNext();
+                if (operands.op == operation::LOAD_IMMEDIATE_LOWER)
+                    regs[dst] = (regs[dst] & ~lowerHalfMask) | operands.immediate;
+                else
+                    regs[dst] = (regs[dst] & lowerHalfMask) | (operands.immediate << halfRegisterSize);
+                const cpu_register_t left = regs[add.dstRegisterIndex];
+                const cpu_register_t right = regs[add.srcRegisterIndex];
+                regs[add.dstRegisterIndex] = left + right;
+                flags.set(operation::ADD_REGISTER, left, right, regs[add.dstRegisterIndex]);
+                nextPc += sizeof(cpu_register_t);
+            }
+            break;
+        case operation::FUSED_LOAD_ADD:
+        fusedLoadAdd: __attribute__((unused));
+            if constexpr (isFusable) {
+                // Load at the end of memory runs alone through its handler
+                const std::uint32_t address = instructions::getEfficientAddress(regs[src], operands.immediate);
+                memoryAddress = address;
+                if (address > lastWordAddress) {
+                    st = instructions::load::execute(operands, regs, mem, cpuProperties);
+                    break;
+                }
+                const instructions::decoded_instruction& add = retireNext();
+                regs[dst] = mem.readWord(address);
+                const cpu_register_t left = regs[add.dstRegisterIndex];
+                const cpu_register_t right = regs[add.srcRegisterIndex];
+                regs[add.dstRegisterIndex] = left + right;
+                flags.set(operation::ADD_REGISTER, left, right, regs[add.dstRegisterIndex]);
+                nextPc += sizeof(cpu_register_t);
+            }
+            break;
+        case operation::FUSED_SUB_BRANCH:
+        fusedSubBranch: __attribute__((unused));
+            if constexpr (isFusable) {
+                const instructions::decoded_instruction& branch = retireNext();
+                const cpu_register_t left = regs[dst];
+                const cpu_register_t right = operands.op == operation::SUB_REGISTER ? regs[src] : operands.immediate;
+                regs[dst] = left - right;
+                flags.set(operands.op, left, right, regs[dst]);
+                nextPc += sizeof(cpu_register_t);
+                if (flags.isSet(0x1 << branch.srcRegisterIndex) == (branch.op == operation::BRANCH_IF_SET))
+                    nextPc = (cpu_register_t)(pc + sizeof(cpu_register_t) + branch.immediate);
+            }
+            break;
+        default:
+            st = status::DECODE_UNKNOWN_INSTRUCTION;
+            break;
+        }
+
+        profiler.onExecute({ pc, instruction, operands, memoryAddress, regs, st });
+        result.lastStatus = st;
+        if (st < status::UNKNOWN_WARNING) {
+            result.reason = stop_reason::ERROR;
+            break;
+        }
+
+        pc = nextPc;
+        ++result.retiredInstructions;
+        if constexpr (!std::is_base_of<no_predicate, Predicate>::value) {
+            instructionPtr = pc;
+            if (predicate(static_cast<const basic_cpu&>(*this))) {
+                result.reason = stop_reason::PREDICATE;
+                break;
+            }
+        }
+    }
+
+    instructionPtr = pc;
+    return result;
+}
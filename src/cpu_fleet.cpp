@@ -0,0 +1,201 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+#include "cpu_fleet.h"
+
+namespace {
+
+std::uint32_t getDefaultWorkersCount()
+{
+    std::uint32_t count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+}
+
+cpu_fleet::cpu_fleet(const std::uint32_t _workersCount, const std::uint64_t _sliceInstructions, const execution_tier _tier) :
+    workersCount(_workersCount ? _workersCount : getDefaultWorkersCount()),
+    sliceInstructions(_sliceInstructions ? _sliceInstructions : 1), tier(_tier), firstNewJob(0),
+    queues(new worker_queue[workersCount]), remainingJobs(0), retiredInstructions(0), steals(0),
+    cacheHits(0), cacheSaves(0) {}
+
+cpu_fleet::~cpu_fleet() {}
+
+std::size_t cpu_fleet::addJob(const fleet_job& job)
+{
+    job_image& image = images[std::make_tuple(job.image, job.imageSize, job.loadAddress)];
+    if (!image.isCacheSaved) {
+        image.image = shared_image::fromBuffer(job.image, job.imageSize, job.loadAddress, job.entry);
+        image.isCacheSaved = std::make_shared<std::atomic<bool>>(false);
+    }
+    jobs.push_back(job);
+    jobImages.push_back(image);
+    return jobs.size() - 1;
+}
+
+fleet_stats cpu_fleet::run()
+{
+    for (std::size_t job = firstNewJob; job < jobs.size(); ++job)
+        queues[job % workersCount].pending.push_back({ job, nullptr, false });
+    results.resize(jobs.size());
+    remainingJobs = jobs.size() - firstNewJob;
+    firstNewJob = jobs.size();
+    images.clear();
+    retiredInstructions = 0;
+    steals = 0;
+    cacheHits = 0;
+    cacheSaves = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (std::uint32_t worker = 1; worker < workersCount; ++worker)
+        workers.emplace_back(&cpu_fleet::workerLoop, this, worker);
+    workerLoop(0);
+    for (std::thread& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fleet_stats stats = { retiredInstructions, steals, seconds, 0.0, cacheHits, cacheSaves };
+    if (seconds > 0.0)
+        stats.instructionsPerSecond = stats.retiredInstructions / seconds;
+    return stats;
+}
+
+void cpu_fleet::workerLoop(const std::uint32_t worker)
+{
+    task current;
+    while (remainingJobs.load(std::memory_order_acquire)) {
+        if (!takeTask(worker, current)) {
+            if (!stealTasks(worker))
+                std::this_thread::yield();
+            continue;
+        }
+
+        if (runSlice(worker, current)) {
+            remainingJobs.fetch_sub(1, std::memory_order_release);
+        }
+        else {
+            std::lock_guard<std::mutex> guard(queues[worker].lock);
+            queues[worker].active.push_back(std::move(current));
+        }
+    }
+}
+
+// New job is started only if worker has room for it, otherwise started jobs
+// are rotated, so their time slices go round-robin
+bool cpu_fleet::takeTask(const std::uint32_t worker, task& next)
+{
+    worker_queue& queue = queues[worker];
+    std::lock_guard<std::mutex> guard(queue.lock);
+    std::deque<task>* source = nullptr;
+    if (!queue.pending.empty() && queue.active.size() < activeJobsPerWorker)
+        source = &queue.pending;
+    else if (!queue.active.empty())
+        source = &queue.active;
+    else
+        return false;
+
+    next = std::move(source->front());
+    source->pop_front();
+    return true;
+}
+
+// Takes half of pending jobs of the first victim which has them, if nobody
+// has pending jobs, takes one started job. Only one lock is held at a time.
+bool cpu_fleet::stealTasks(const std::uint32_t worker)
+{
+    for (std::uint32_t offset = 1; offset < workersCount; ++offset) {
+        worker_queue& victim = queues[(worker + offset) % workersCount];
+        std::deque<task> stolen;
+        bool isActive = false;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.pending.empty()) {
+                std::size_t count = (victim.pending.size() + 1) / 2;
+                for (std::size_t i = 0; i < count; ++i) {
+                    stolen.push_front(std::move(victim.pending.back()));
+                    victim.pending.pop_back();
+                }
+            }
+            else if (!victim.active.empty()) {
+                stolen.push_back(std::move(victim.active.back()));
+                victim.active.pop_back();
+                isActive = true;
+            }
+        }
+        if (stolen.empty())
+            continue;
+
+        worker_queue& queue = queues[worker];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        std::deque<task>& destination = isActive ? queue.active : queue.pending;
+        for (task& stolenTask : stolen)
+            destination.push_back(std::move(stolenTask));
+        steals.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+// Binaries with other emitter get other files instead of replacing each other's
+std::string cpu_fleet::getCachePath(const std::size_t job) const
+{
+    const std::uint64_t fingerprint = jit_engine::getBuildFingerprint();
+    const std::uint64_t key = getContentHash(&fingerprint, sizeof(fingerprint), jobImages[job].image.getHash());
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.jit", (unsigned long long)key);
+    return cacheDirectory + "/" + name;
+}
+
+// Returns true if job is finished
+bool cpu_fleet::runSlice(const std::uint32_t worker, task& current)
+{
+    const fleet_job& job = jobs[current.job];
+    fleet_job_result& jobResult = results[current.job];
+    std::vector<std::unique_ptr<cpu>>& spareMachines = queues[worker].spareMachines;
+    if (!current.machine) {
+        if (spareMachines.empty()) {
+            current.machine.reset(new cpu(tier));
+        }
+        else {
+            current.machine = std::move(spareMachines.back());
+            spareMachines.pop_back();
+        }
+        current.machine->mapImage(jobImages[current.job].image);
+        current.machine->setInstructionPtr(job.entry);
+        if (!cacheDirectory.empty() && tier == execution_tier::JIT) {
+            current.isCacheHit = current.machine->loadTranslations(getCachePath(current.job)) == status::STATUS_OK;
+            if (current.isCacheHit)
+                cacheHits.fetch_add(1, std::memory_order_relaxed);
+        }
+        jobResult.result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+    }
+
+    cpu& machine = *current.machine;
+    run_result& total = jobResult.result;
+    run_result slice = machine.run(std::min(job.maxInstructions - total.retiredInstructions, sliceInstructions));
+    total.retiredInstructions += slice.retiredInstructions;
+    total.reason = slice.reason;
+    total.lastStatus = slice.lastStatus;
+    retiredInstructions.fetch_add(slice.retiredInstructions, std::memory_order_relaxed);
+    if (slice.reason == stop_reason::INSTRUCTIONS_LIMIT && total.retiredInstructions < job.maxInstructions)
+        return false;
+
+    jobResult.instructionPtr = machine.getInstructionPtr();
+    std::copy(machine.getRegisters(), machine.getRegisters() + cpu::geometry::registersCount, jobResult.registers.begin());
+    if (onCompletion)
+        onCompletion(current.job, machine);
+    if (!cacheDirectory.empty() && tier == execution_tier::JIT && !current.isCacheHit &&
+        !jobImages[current.job].isCacheSaved->exchange(true) &&
+        machine.saveTranslations(getCachePath(current.job)) == status::STATUS_OK)
+        cacheSaves.fetch_add(1, std::memory_order_relaxed);
+    // Spares are bounded, stolen active jobs may bring more machines to worker
+    if (spareMachines.size() < activeJobsPerWorker) {
+        machine.reset();
+        spareMachines.push_back(std::move(current.machine));
+    }
+    current.machine.reset();
+    return true;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <deque>
+#include <tuple>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "base.h"
+#include "cpu.h"
+#include "shared_image.h"
+
+// Program image has to stay alive and unchanged until cpu_fleet::run returns.
+// Jobs added before one run with the same image, size and loadAddress map
+// pages of one shared_image, so memory of every cpu holds only pages it wrote.
+struct fleet_job {
+    const std::uint8_t* image;
+    std::uint32_t imageSize;
+    std::uint32_t loadAddress;
+    std::uint32_t entry; // initial instructionPtr
+    std::uint64_t maxInstructions;
+};
+
+struct fleet_job_result {
+    run_result result; // summed over all time slices of the job
+    std::uint32_t instructionPtr;
+    std::array<cpu_register_t, cpu::geometry::registersCount> registers;
+};
+
+struct fleet_stats {
+    std::uint64_t retiredInstructions;
+    std::uint64_t steals;
+    double seconds;
+    double instructionsPerSecond;
+    std::uint64_t cacheHits;  // jobs which loaded translations from cache
+    std::uint64_t cacheSaves; // translation files written, new or rebuilt
+};
+
+// Runs many independent cpu jobs on a pool of worker threads. Every worker
+// owns a deque of jobs, idle workers steal from the back of other deques.
+// Started jobs run in time slices of sliceInstructions and every worker
+// rotates up to activeJobsPerWorker of them, so one long job does not block
+// others. Number of cpu instances alive at once is bounded by that limit,
+// cpus of finished jobs are reset and reused by the next jobs of worker.
+class cpu_fleet {
+public:
+    // Called from worker thread when job is finished, before its cpu is reset
+    using completion_handler = std::function<void(const std::size_t job, const cpu& machine)>;
+
+    explicit cpu_fleet(const std::uint32_t _workersCount = 0, const std::uint64_t _sliceInstructions = 1 << 16,
+                       const execution_tier _tier = execution_tier::INTERPRETER);
+    ~cpu_fleet();
+
+    std::size_t addJob(const fleet_job& job);
+    inline void setCompletionHandler(completion_handler handler) { onCompletion = std::move(handler); }
+    // Directory with JIT translations of every distinct image, named by hash
+    // of image and build of emitter. Jobs load them before the first time
+    // slice, the first job of an image which had to translate from scratch
+    // saves its translations, so stale or damaged files are rebuilt. Used by
+    // JIT tier, empty disables.
+    inline void setTranslationCache(const std::string& directory) { cacheDirectory = directory; }
+
+    // Runs every added job to the end, may be called again after adding more jobs
+    fleet_stats run();
+
+    inline const std::vector<fleet_job_result>& getResults() const { return results; }
+    inline std::uint32_t getWorkersCount() const { return workersCount; }
+
+    static constexpr std::size_t activeJobsPerWorker = 4;
+private:
+    struct task {
+        std::size_t job;
+        std::unique_ptr<cpu> machine; // created on the first time slice
+        bool isCacheHit; // translations were loaded from cache
+    };
+
+    struct job_image {
+        shared_image image;
+        std::shared_ptr<std::atomic<bool>> isCacheSaved; // shared by jobs of one image
+    };
+
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<task> pending; // not started yet, stolen first
+        std::deque<task> active; // started, waiting for next time slice
+        std::vector<std::unique_ptr<cpu>> spareMachines; // used only by owning worker, not locked
+    };
+
+    void workerLoop(const std::uint32_t worker);
+    bool takeTask(const std::uint32_t worker, task& next);
+    bool stealTasks(const std::uint32_t worker);
+    bool runSlice(const std::uint32_t worker, task& current);
+    std::string getCachePath(const std::size_t job) const;
+
+    const std::uint32_t workersCount;
+    const std::uint64_t sliceInstructions;
+    const execution_tier tier;
+
+    std::vector<fleet_job> jobs;
+    std::vector<job_image> jobImages;
+    // Images of jobs added since the last run, by image, imageSize and loadAddress
+    std::map<std::tuple<const std::uint8_t*, std::uint32_t, std::uint32_t>, job_image> images;
+    std::string cacheDirectory;
+    std::size_t firstNewJob; // jobs before it were finished by previous run
+    std::vector<fleet_job_result> results;
+    completion_handler onCompletion;
+
+    std::unique_ptr<worker_queue[]> queues;
+    std::atomic<std::size_t> remainingJobs;
+    std::atomic<std::uint64_t> retiredInstructions;
+    std::atomic<std::uint64_t> steals;
+    std::atomic<std::uint64_t> cacheHits;
+    std::atomic<std::uint64_t> cacheSaves;
+};
@@ -0,0 +1,79 @@
+#include <mutex>
+#include <vector>
+
+#include "decode_table.h"
+
+namespace instructions {
+
+template <typename Properties>
+static void fillEntries(decoded_instruction* const entries, const std::uint32_t entriesCount, const Properties& cpuProperties)
+{
+    using decoder = decoded_instruction (*)(const cpu_register_t, const Properties&);
+    // Opcode of instruction is its index in this table
+    constexpr decoder opCodeDecoders[] = {
+        load::decode<Properties>,
+        store::decode<Properties>,
+        load_immediate::decode<Properties>,
+        addition::decode<Properties>,
+        subtraction::decode<Properties>,
+        multiplication::decode<Properties>,
+        shift_right_logical::decode<Properties>,
+        shift_left_logical::decode<Properties>,
+        bitwise_not::decode<Properties>,
+        bitwise_and::decode<Properties>,
+        bitwise_or::decode<Properties>,
+        bitwise_xor::decode<Properties>,
+        jump::decode<Properties>,
+        branch::decode<Properties>,
+        call::decode<Properties>,
+        return_from_call::decode<Properties>
+    };
+    const std::uint32_t opCodeOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction;
+    const std::uint32_t knownOpCodes = sizeof(opCodeDecoders) / sizeof(opCodeDecoders[0]);
+    for (std::uint32_t instruction = 0; instruction < entriesCount; ++instruction) {
+        std::uint32_t opCode = instruction >> opCodeOffset;
+        if (opCode < knownOpCodes)
+            entries[instruction] = opCodeDecoders[opCode](instruction, cpuProperties);
+        else
+            entries[instruction] = instruction_base::decode(instruction, cpuProperties);
+    }
+}
+
+static bool isSameGeometry(const cpu_base_properties& first, const cpu_base_properties& second)
+{
+    return first.maxInstructionsCount == second.maxInstructionsCount &&
+           first.registersCount == second.registersCount &&
+           first.registerSize == second.registerSize;
+}
+
+decode_table::decode_table(const cpu_base_properties& _cpuProperties) :
+    entriesCount(0x1 << _cpuProperties.registerSize), entries(new decoded_instruction[entriesCount])
+{
+    if (isSameGeometry(_cpuProperties, default_cpu_properties()))
+        fillEntries(entries.get(), entriesCount, default_cpu_properties());
+    else
+        fillEntries(entries.get(), entriesCount, _cpuProperties);
+}
+
+std::shared_ptr<const decode_table> decode_table::getTable(const cpu_base_properties& cpuProperties)
+{
+    static std::mutex tablesMutex;
+    static std::vector<std::pair<cpu_base_properties, std::shared_ptr<const decode_table>>> tables;
+
+    std::lock_guard<std::mutex> lock(tablesMutex);
+    for (const auto& table : tables) {
+        if (isSameGeometry(table.first, cpuProperties))
+            return table.second;
+    }
+
+    tables.emplace_back(cpuProperties, std::make_shared<const decode_table>(cpuProperties));
+    return tables.back().second;
+}
+
+const std::shared_ptr<const decode_table>& decode_table::getDefaultTable()
+{
+    static const std::shared_ptr<const decode_table> table = getTable(default_cpu_properties());
+    return table;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <memory>
+
+#include "base.h"
+#include "instructions.h"
+
+namespace instructions {
+
+// Flat table of pre-decoded records for every possible instruction word, so
+// decoding on the hot path is one indexed load. Table depends only on cpu
+// geometry, so one instance is shared by every cpu with same properties.
+class decode_table {
+public:
+    explicit decode_table(const cpu_base_properties& _cpuProperties);
+
+    static std::shared_ptr<const decode_table> getTable(const cpu_base_properties& cpuProperties);
+    // Table of default_cpu_properties, built once and returned without locking
+    static const std::shared_ptr<const decode_table>& getDefaultTable();
+
+    inline const decoded_instruction& operator[](const cpu_register_t instruction) const { return entries[instruction]; }
+    inline std::uint32_t size() const { return entriesCount; }
+private:
+    const std::uint32_t entriesCount;
+    const std::unique_ptr<decoded_instruction[]> entries;
+};
+
+}
@@ -0,0 +1,200 @@
+#include <sstream>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+#include "event_log.h"
+
+namespace {
+
+constexpr std::chrono::milliseconds drainPeriod(10);
+constexpr std::chrono::seconds rateWindow(1);
+
+std::atomic<std::uint64_t> nextLogId(1);
+
+std::uint32_t roundUpToPowerOf2(const std::uint32_t value)
+{
+    std::uint32_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+}
+
+// Single producer single consumer ring, producer is the owning thread and
+// consumer is the drain thread
+class event_log::ring {
+public:
+    explicit ring(const std::uint32_t capacity) : records(roundUpToPowerOf2(capacity)), mask(records.size() - 1),
+                                                  head(0), tail(0) {}
+
+    inline bool push(const log_record& record)
+    {
+        const std::uint64_t position = head.load(std::memory_order_relaxed);
+        if (position - tail.load(std::memory_order_acquire) == records.size())
+            return false;
+        records[position & mask] = record;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <typename Consumer>
+    void drain(Consumer consumer)
+    {
+        std::uint64_t position = tail.load(std::memory_order_relaxed);
+        const std::uint64_t end = head.load(std::memory_order_acquire);
+        for (; position != end; ++position)
+            consumer(records[position & mask]);
+        tail.store(end, std::memory_order_release);
+    }
+
+    inline bool isEmpty() const
+    {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+    }
+private:
+    std::vector<log_record> records;
+    const std::uint64_t mask;
+    alignas(64) std::atomic<std::uint64_t> head;
+    alignas(64) std::atomic<std::uint64_t> tail;
+};
+
+event_log::event_log(sink _output, const std::uint32_t _rateLimit, const std::uint32_t _ringCapacity) :
+    output(_output ? std::move(_output) : [](const std::string& line) { std::cerr << line << '\n'; }),
+    rateLimit(_rateLimit), ringCapacity(_ringCapacity), id(nextLogId.fetch_add(1)),
+    droppedCount(0), suppressedCount(0), flushRequests(0), flushedRequests(0), isStopping(false),
+    drainThread(&event_log::drainLoop, this) {}
+
+event_log::~event_log()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        isStopping = true;
+    }
+    wakeUp.notify_one();
+    drainThread.join();
+}
+
+event_log& event_log::getDefault()
+{
+    static event_log log;
+    return log;
+}
+
+event_log::ring& event_log::getRing()
+{
+    thread_local std::uint64_t lastId = 0;
+    thread_local ring* lastRing = nullptr;
+    thread_local std::map<std::uint64_t, std::shared_ptr<ring>> threadRings;
+
+    if (lastId != id) {
+        std::shared_ptr<ring>& threadRing = threadRings[id];
+        if (!threadRing) {
+            threadRing = std::make_shared<ring>(ringCapacity);
+            std::lock_guard<std::mutex> lock(ringsMutex);
+            rings.push_back(threadRing);
+        }
+        lastId = id;
+        lastRing = threadRing.get();
+    }
+    return *lastRing;
+}
+
+void event_log::push(const log_record& record)
+{
+    if (!getRing().push(record))
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void event_log::flush()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    const std::uint64_t request = ++flushRequests;
+    wakeUp.notify_one();
+    flushed.wait(lock, [this, request]() { return flushedRequests >= request; });
+}
+
+void event_log::drainLoop()
+{
+    std::uint64_t reportedDropped = 0;
+    std::unique_lock<std::mutex> lock(stateMutex);
+    while (true) {
+        wakeUp.wait_for(lock, drainPeriod, [this]() { return isStopping || flushRequests != flushedRequests; });
+        const std::uint64_t requests = flushRequests;
+        const bool isLast = isStopping;
+        lock.unlock();
+
+        drain();
+        const std::uint64_t dropped = getDroppedCount();
+        if (dropped != reportedDropped) {
+            output("Warning: event_log, " + std::to_string(dropped - reportedDropped) + " records dropped, ring is full");
+            reportedDropped = dropped;
+        }
+        if (isLast)
+            for (auto& [key, window] : windows)
+                reportSuppressed(key, window);
+
+        lock.lock();
+        flushedRequests = requests;
+        flushed.notify_all();
+        if (isLast)
+            break;
+    }
+}
+
+void event_log::drain()
+{
+    std::vector<std::shared_ptr<ring>> current;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        current = rings;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    for (const std::shared_ptr<ring>& threadRing : current)
+        threadRing->drain([this, now](const log_record& record) { write(record, now); });
+    current.clear();
+
+    // Rings of finished threads are owned only by this log
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<ring>& threadRing) {
+        return threadRing.use_count() == 1 && threadRing->isEmpty();
+    }), rings.end());
+}
+
+void event_log::write(const log_record& record, const std::chrono::steady_clock::time_point now)
+{
+    const std::pair<const char*, status> key(record.source, record.code);
+    rate_window& window = windows[key];
+    if (now - window.start >= rateWindow) {
+        reportSuppressed(key, window);
+        window.start = now;
+        window.lines = 0;
+    }
+    if (window.lines >= rateLimit) {
+        ++window.suppressed;
+        suppressedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ++window.lines;
+
+    std::ostringstream line;
+    line << (record.code < status::UNKNOWN_WARNING ? "Error: " : "Warning: ") << record.source << ", code - "
+         << (int)record.code << ' ' << getStatusName(record.code);
+    if (record.instructionPtr != log_record::noAddress)
+        line << ", pc 0x" << std::hex << std::setw(4) << std::setfill('0') << record.instructionPtr << std::dec;
+    if (record.op)
+        line << ", op " << (int)record.op << ", dst " << (int)record.dstRegisterIndex << ", src "
+             << (int)record.srcRegisterIndex << ", immediate " << record.immediate;
+    output(line.str());
+}
+
+void event_log::reportSuppressed(const std::pair<const char*, status>& key, rate_window& window)
+{
+    if (!window.suppressed)
+        return;
+    output(std::string("Warning: event_log, ") + std::to_string(window.suppressed) + " more records of " + key.first +
+           " with code " + getStatusName(key.second) + " suppressed");
+    window.suppressed = 0;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include "base.h"
+
+// Fixed-size binary record of error or warning. Source has to be a string
+// literal, it is kept by pointer and used as rate limit key with code.
+struct log_record {
+    static constexpr std::uint32_t noAddress = 0xffffffff;
+
+    const char* source;
+    status code;
+    std::uint32_t instructionPtr;   // noAddress if it is not known
+    std::uint8_t op;                // instructions::operation
+    std::uint8_t dstRegisterIndex;
+    std::uint8_t srcRegisterIndex;
+    cpu_register_t immediate;
+
+    template <typename Operands>
+    static log_record make(const char* const source, const status code, const std::uint32_t instructionPtr,
+                           const Operands& operands)
+    {
+        return { source, code, instructionPtr, (std::uint8_t)operands.op, operands.dstRegisterIndex,
+                 operands.srcRegisterIndex, operands.immediate };
+    }
+    static log_record make(const char* const source, const status code, const std::uint32_t instructionPtr = noAddress)
+    {
+        return { source, code, instructionPtr, 0, 0, 0, 0 };
+    }
+};
+
+// Asynchronous event log. Every producing thread gets its own lock-free
+// single producer ring, push only copies record into it and never blocks,
+// record is dropped if ring is full. Background thread drains rings,
+// formats records and writes them to the sink, at most rateLimit lines per
+// second for every source and code pair, the rest is counted and reported
+// as suppressed.
+class event_log {
+public:
+    using sink = std::function<void(const std::string& line)>;
+
+    // Default sink writes to std::cerr
+    explicit event_log(sink _output = nullptr, const std::uint32_t _rateLimit = 100,
+                       const std::uint32_t _ringCapacity = 4096);
+    event_log(const event_log&) = delete;
+    event_log& operator=(const event_log&) = delete;
+    // Writes everything which is left
+    ~event_log();
+
+    // Log used by cpu and instruction handlers
+    static event_log& getDefault();
+
+    void push(const log_record& record);
+    // Blocks until records pushed by any thread before the call are written
+    void flush();
+
+    inline std::uint64_t getDroppedCount() const { return droppedCount.load(std::memory_order_relaxed); }
+    inline std::uint64_t getSuppressedCount() const { return suppressedCount.load(std::memory_order_relaxed); }
+private:
+    class ring;
+
+    struct rate_window {
+        std::chrono::steady_clock::time_point start;
+        std::uint32_t lines;
+        std::uint64_t suppressed;
+    };
+
+    ring& getRing();
+    void drainLoop();
+    void drain();
+    void write(const log_record& record, const std::chrono::steady_clock::time_point now);
+    void reportSuppressed(const std::pair<const char*, status>& key, rate_window& window);
+
+    const sink output;
+    const std::uint32_t rateLimit;
+    const std::uint32_t ringCapacity;
+    const std::uint64_t id; // separates thread local rings of different logs
+
+    std::mutex ringsMutex;
+    std::vector<std::shared_ptr<ring>> rings;
+
+    std::map<std::pair<const char*, status>, rate_window> windows; // used only by drain thread
+    std::atomic<std::uint64_t> droppedCount;
+    std::atomic<std::uint64_t> suppressedCount;
+
+    std::mutex stateMutex;
+    std::condition_variable wakeUp;
+    std::condition_variable flushed;
+    std::uint64_t flushRequests;
+    std::uint64_t flushedRequests;
+    bool isStopping;
+    std::thread drainThread;
+};
+
+// Handlers report edge cases only when built with LOGGING
+#ifdef LOGGING
+#define LOG(function, code, operands) \
+    event_log::getDefault().push(log_record::make(function, code, log_record::noAddress, operands))
+#else
+#define LOG(function, code, operands)
+#endif
@@ -0,0 +1,59 @@
+#include <type_traits>
+
+#include "flags.h"
+
+namespace instructions {
+
+cpu_register_t lazy_flags::compute(const operation op, const cpu_register_t left, const cpu_register_t right,
+                                   const cpu_register_t result)
+{
+    constexpr std::uint32_t registerBits = BITS_IN_BYTE * sizeof(cpu_register_t);
+    using signed_register_t = std::make_signed_t<cpu_register_t>;
+    constexpr std::int32_t minSignedValue = -(1 << signBitIndex);
+    constexpr std::int32_t maxSignedValue = (1 << signBitIndex) - 1;
+
+    bool isCarry = false;
+    bool isOverflow = false;
+    switch (op) {
+    case operation::ADD_REGISTER:
+    case operation::ADD_IMMEDIATE:
+        isCarry = (std::uint32_t)left + right > (cpu_register_t)-1;
+        isOverflow = (left ^ result) & (right ^ result) & signBitMask;
+        break;
+    case operation::SUB_REGISTER:
+    case operation::SUB_IMMEDIATE:
+        isCarry = left < right;
+        isOverflow = (left ^ right) & (left ^ result) & signBitMask;
+        break;
+    case operation::MUL_REGISTER:
+    case operation::MUL_IMMEDIATE: {
+        const std::int32_t product = (std::int32_t)(signed_register_t)left * (signed_register_t)right;
+        isCarry = (std::uint32_t)left * right > (cpu_register_t)-1;
+        isOverflow = product < minSignedValue || product > maxSignedValue;
+        break;
+    }
+    case operation::SRL_REGISTER:
+    case operation::SRL_IMMEDIATE:
+        isCarry = right && right <= registerBits && ((left >> (right - 1)) & 0x1);
+        break;
+    case operation::SLL_REGISTER:
+    case operation::SLL_IMMEDIATE:
+        isCarry = right && right <= registerBits && (((std::uint32_t)left << (right - 1)) & signBitMask);
+        break;
+    default:
+        return result;
+    }
+
+    cpu_register_t bits = 0;
+    if (result == 0)
+        bits |= ZERO_FLAG;
+    if (result & signBitMask)
+        bits |= NEGATIVE_FLAG;
+    if (isCarry)
+        bits |= CARRY_FLAG;
+    if (isOverflow)
+        bits |= OVERFLOW_FLAG;
+    return bits;
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base.h"
+#include "instructions.h"
+
+namespace instructions {
+
+// Bits of status register, every flag setting operation writes all of them
+enum status_flag : cpu_register_t {
+    ZERO_FLAG = 0x1,
+    NEGATIVE_FLAG = 0x2,
+    CARRY_FLAG = 0x4,     // carry out of add and mul, borrow of sub, last bit shifted out
+    OVERFLOW_FLAG = 0x8   // signed overflow of add, sub and mul
+};
+
+// Status register which keeps the last flag setting operation with its
+// operands and result, flag bits are computed only when somebody reads them.
+// Right operand of immediate form is its sign extended immediate, of shifts
+// is shift amount.
+struct lazy_flags {
+    operation op;          // UNKNOWN if result already holds flag bits
+    cpu_register_t left;   // dst register before operation
+    cpu_register_t right;
+    cpu_register_t result;
+
+    static constexpr bool isFlagSetting(const operation op)
+    {
+        return op >= operation::ADD_REGISTER && op <= operation::SLL_IMMEDIATE;
+    }
+    // Register and immediate forms of flag setting operations alternate
+    static inline cpu_register_t getRightOperand(const decoded_instruction& operands, const cpu_register_t* const registers)
+    {
+        const std::uint32_t form = (std::uint32_t)operands.op - (std::uint32_t)operation::ADD_REGISTER;
+        return form % 2 ? operands.immediate : registers[operands.srcRegisterIndex];
+    }
+    // Flags of operation computed right away, lazy flags give the same bits
+    static cpu_register_t compute(const operation op, const cpu_register_t left, const cpu_register_t right,
+                                  const cpu_register_t result);
+
+    inline void set(const operation _op, const cpu_register_t _left, const cpu_register_t _right, const cpu_register_t _result)
+    {
+        op = _op;
+        left = _left;
+        right = _right;
+        result = _result;
+    }
+    inline void assign(const cpu_register_t bits)
+    {
+        op = operation::UNKNOWN;
+        result = bits;
+    }
+    inline cpu_register_t get() const { return op == operation::UNKNOWN ? result : compute(op, left, right, result); }
+    // Zero and negative flags come from result without computing others
+    inline bool isSet(const cpu_register_t flag) const
+    {
+        if (op == operation::UNKNOWN)
+            return result & flag;
+        if (flag == ZERO_FLAG)
+            return result == 0;
+        if (flag == NEGATIVE_FLAG)
+            return result & signBitMask;
+        return compute(op, left, right, result) & flag;
+    }
+};
+
+}
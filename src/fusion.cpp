@@ -0,0 +1,36 @@
+#include "fusion.h"
+
+namespace instructions {
+
+fusion_table::fusion_table(const std::vector<operation>& enabledOperations) : enabled()
+{
+    for (const operation fused : enabledOperations) {
+        if (isFused(fused))
+            enabled[(std::uint32_t)fused - operationsCount] = true;
+    }
+}
+
+std::shared_ptr<const fusion_table> fusion_table::getDefault()
+{
+    static const std::shared_ptr<const fusion_table> table = std::make_shared<const fusion_table>(std::vector<operation>{
+        operation::FUSED_LOAD_IMMEDIATE_PAIR,
+        operation::FUSED_LOAD_IMMEDIATE_ADD,
+        operation::FUSED_LOAD_ADD,
+        operation::FUSED_SUB_BRANCH
+    });
+    return table;
+}
+
+const char* fusion_table::getName(const operation fused)
+{
+    switch (fused) {
+    case operation::FUSED_LOAD_IMMEDIATE_PAIR: return "ldi+ldi";
+    case operation::FUSED_LOAD_IMMEDIATE_ADD: return "ldi+add";
+    case operation::FUSED_LOAD_ADD: return "ld+add";
+    case operation::FUSED_SUB_BRANCH: return "sub+branch";
+    default: break;
+    }
+    return "unknown";
+}
+
+}
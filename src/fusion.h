@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "base.h"
+#include "instructions.h"
+
+namespace instructions {
+
+// Peephole table of enabled fusions. Interpreter matches head with the next
+// word of its fetch page when head is decoded and runs the pair as one
+// operation:
+// - ldi lower and ldi upper of the same register
+// - ldi followed by add of that register
+// - ld followed by add of the loaded register
+// - sub followed by conditional branch, compare and branch
+class fusion_table {
+public:
+    explicit fusion_table(const std::vector<operation>& enabledOperations);
+
+    // Table with every fusion enabled
+    static std::shared_ptr<const fusion_table> getDefault();
+    static const char* getName(const operation fused);
+
+    // Fused operation of head followed by next, op of head if they do not fuse
+    inline operation match(const decoded_instruction& head, const decoded_instruction& next) const;
+    inline bool isEnabled(const operation fused) const
+    {
+        return isFused(fused) && enabled[(std::uint32_t)fused - operationsCount];
+    }
+private:
+    std::array<bool, fusedOperationsCount> enabled;
+};
+
+inline operation fusion_table::match(const decoded_instruction& head, const decoded_instruction& next) const
+{
+    operation fused = head.op;
+    switch (head.op) {
+    case operation::LOAD_IMMEDIATE_LOWER:
+        if (next.op == operation::LOAD_IMMEDIATE_UPPER && next.dstRegisterIndex == head.dstRegisterIndex)
+            fused = operation::FUSED_LOAD_IMMEDIATE_PAIR;
+        else if (next.op == operation::ADD_REGISTER && next.srcRegisterIndex == head.dstRegisterIndex)
+            fused = operation::FUSED_LOAD_IMMEDIATE_ADD;
+        break;
+    case operation::LOAD_IMMEDIATE_UPPER:
+        if (next.op == operation::ADD_REGISTER && next.srcRegisterIndex == head.dstRegisterIndex)
+            fused = operation::FUSED_LOAD_IMMEDIATE_ADD;
+        break;
+    case operation::LOAD:
+        if (next.op == operation::ADD_REGISTER && next.srcRegisterIndex == head.dstRegisterIndex)
+            fused = operation::FUSED_LOAD_ADD;
+        break;
+    case operation::SUB_REGISTER:
+    case operation::SUB_IMMEDIATE:
+        if (next.op == operation::BRANCH_IF_SET || next.op == operation::BRANCH_IF_CLEAR)
+            fused = operation::FUSED_SUB_BRANCH;
+        break;
+    default:
+        break;
+    }
+    return isEnabled(fused) ? fused : head.op;
+}
+
+}
@@ -0,0 +1,134 @@
+#include <atomic>
+#include <algorithm>
+
+#include "guest_memory.h"
+
+const guest_memory::page guest_memory::zeroPage = {};
+
+guest_memory::guest_memory()
+{
+    for (std::uint32_t index = 0; index < pagesCount; ++index)
+        mapZeroPage(index);
+}
+
+guest_memory::guest_memory(std::uint8_t* const flatMemory, const std::uint32_t size)
+{
+    const std::uint32_t viewPages = std::min((size + pageMask) >> pageShift, pagesCount);
+    for (std::uint32_t index = 0; index < pagesCount; ++index) {
+        std::uint8_t* data = index < viewPages ? flatMemory + index * pageSize : nullptr;
+        readPages[index] = writePages[index] = data;
+        externalPages[index] = false;
+    }
+}
+
+guest_memory::~guest_memory() {}
+
+std::unique_ptr<guest_memory> guest_memory::clone()
+{
+    std::unique_ptr<guest_memory> copy(new guest_memory(nullptr, 0));
+    for (std::uint32_t index = 0; index < pagesCount; ++index) {
+        if (!pages[index] && readPages[index]) {
+            // Pages of not owning view can not be shared, they are copied
+            copy->pages[index] = std::make_shared<page>();
+            std::memcpy(copy->pages[index]->data, readPages[index], pageSize);
+            copy->readPages[index] = copy->writePages[index] = copy->pages[index]->data;
+            continue;
+        }
+        copy->pages[index] = pages[index];
+        copy->readPages[index] = readPages[index];
+        copy->externalPages[index] = externalPages[index];
+        writePages[index] = nullptr;
+    }
+    return copy;
+}
+
+void guest_memory::reset()
+{
+    for (std::uint32_t index = 0; index < pagesCount; ++index) {
+        if (writePages[index])
+            std::memset(writePages[index], 0, pageSize);
+        else if (pages[index] && readPages[index] != zeroPage.data)
+            mapZeroPage(index);
+    }
+}
+
+void guest_memory::mapPages(const std::shared_ptr<const void>& owner, const std::uint8_t* const data,
+                            const std::uint32_t firstPage, const std::uint32_t count)
+{
+    for (std::uint32_t index = firstPage; index < firstPage + count && index < pagesCount; ++index) {
+        const std::uint8_t* pageData = data + (std::size_t)(index - firstPage) * pageSize;
+        // External page is only read, it is copied before the first write
+        pages[index] = std::shared_ptr<page>(std::const_pointer_cast<void>(owner),
+                                             reinterpret_cast<page*>(const_cast<std::uint8_t*>(pageData)));
+        readPages[index] = pageData;
+        writePages[index] = nullptr;
+        externalPages[index] = true;
+    }
+}
+
+void guest_memory::read(const std::uint32_t address, void* const data, const std::uint32_t size) const
+{
+    std::uint8_t* destination = static_cast<std::uint8_t*>(data);
+    std::uint32_t current = address;
+    const std::uint32_t end = address + size;
+    while (current < end) {
+        std::uint32_t chunk = std::min(end - current, pageSize - (current & pageMask));
+        std::memcpy(destination, readPages[current >> pageShift] + (current & pageMask), chunk);
+        destination += chunk;
+        current += chunk;
+    }
+}
+
+void guest_memory::write(const std::uint32_t address, const void* const data, const std::uint32_t size)
+{
+    const std::uint8_t* source = static_cast<const std::uint8_t*>(data);
+    std::uint32_t current = address;
+    const std::uint32_t end = address + size;
+    while (current < end) {
+        std::uint32_t chunk = std::min(end - current, pageSize - (current & pageMask));
+        std::uint8_t* destination = writePages[current >> pageShift];
+        if (!destination)
+            destination = makePrivate(current >> pageShift);
+        std::memcpy(destination + (current & pageMask), source, chunk);
+        source += chunk;
+        current += chunk;
+    }
+}
+
+bool guest_memory::operator==(const guest_memory& other) const
+{
+    for (std::uint32_t index = 0; index < pagesCount; ++index)
+        if (readPages[index] != other.readPages[index] &&
+            std::memcmp(readPages[index], other.readPages[index], pageSize))
+            return false;
+    return true;
+}
+
+std::uint32_t guest_memory::getPrivatePagesCount() const
+{
+    return std::count_if(writePages, writePages + pagesCount, [](const std::uint8_t* page) { return page != nullptr; });
+}
+
+void guest_memory::mapZeroPage(const std::uint32_t index)
+{
+    // Not owning pointer, zero page is handled as external data
+    pages[index] = std::shared_ptr<page>(std::shared_ptr<page>(), const_cast<page*>(&zeroPage));
+    readPages[index] = zeroPage.data;
+    writePages[index] = nullptr;
+    externalPages[index] = true;
+}
+
+std::uint8_t* guest_memory::makePrivate(const std::uint32_t index)
+{
+    if (externalPages[index] || pages[index].use_count() > 1) {
+        std::shared_ptr<page> copy = std::make_shared<page>(*pages[index]);
+        pages[index] = std::move(copy);
+        externalPages[index] = false;
+    }
+    else {
+        // Other owners are gone, their last accesses have to be visible before page is written
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    readPages[index] = writePages[index] = pages[index]->data;
+    return writePages[index];
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <memory>
+#include <cstring>
+#include <cstdint>
+
+#include "base.h"
+
+// Guest memory split into fixed-size pages. Pages are reference counted and
+// shared between clones, page is copied on the first write into it, so clone
+// costs one page table and every fork pays only for pages it touches.
+// New memory maps every page to one static zero page, so construction does
+// not allocate and pages are allocated on the first write too.
+// readPages/writePages are flat tables used by the hot paths, write pointer
+// is null while the page is shared.
+class guest_memory {
+public:
+    static constexpr std::uint32_t pageShift = 12;
+    static constexpr std::uint32_t pageSize = 1 << pageShift;
+    static constexpr std::uint32_t pageMask = pageSize - 1;
+    static constexpr std::uint32_t pagesCount = maxSupportedMemory >> pageShift;
+
+    guest_memory();
+    // Not owning view of flat buffer, every page is private. Used by code which
+    // keeps memory in one array, buffer has to hold whole pages.
+    guest_memory(std::uint8_t* const flatMemory, const std::uint32_t size);
+    guest_memory(const guest_memory&) = delete;
+    guest_memory& operator=(const guest_memory&) = delete;
+    ~guest_memory();
+
+    // Shares every page with new instance, both lose write access to them
+    std::unique_ptr<guest_memory> clone();
+    // Zeroes memory keeping private pages, shared and external pages are
+    // mapped to zero page again
+    void reset();
+    // Replaces pages starting from firstPage with external page aligned data,
+    // owner keeps data alive while any page uses it. External data is never
+    // written, pages are copied on the first write.
+    void mapPages(const std::shared_ptr<const void>& owner, const std::uint8_t* const data,
+                  const std::uint32_t firstPage, const std::uint32_t count);
+
+    inline cpu_register_t readWord(const std::uint32_t address) const
+    {
+        cpu_register_t value;
+        if ((address & pageMask) <= pageSize - sizeof(cpu_register_t)) {
+            std::memcpy(&value, readPages[address >> pageShift] + (address & pageMask), sizeof(value));
+            return value;
+        }
+        read(address, &value, sizeof(value));
+        return value;
+    }
+    // Fast path is a private page, otherwise page is copied first
+    inline void writeWord(const std::uint32_t address, const cpu_register_t value)
+    {
+        std::uint8_t* const page = writePages[address >> pageShift];
+        if (page && (address & pageMask) <= pageSize - sizeof(cpu_register_t)) {
+            std::memcpy(page + (address & pageMask), &value, sizeof(value));
+            return;
+        }
+        write(address, &value, sizeof(value));
+    }
+    inline std::uint8_t readByte(const std::uint32_t address) const
+    {
+        return readPages[address >> pageShift][address & pageMask];
+    }
+    inline void writeByte(const std::uint32_t address, const std::uint8_t value)
+    {
+        write(address, &value, sizeof(value));
+    }
+
+    // Address range has to be inside of memory
+    void read(const std::uint32_t address, void* const data, const std::uint32_t size) const;
+    void write(const std::uint32_t address, const void* const data, const std::uint32_t size);
+
+    bool operator==(const guest_memory& other) const;
+    inline bool operator!=(const guest_memory& other) const { return !(*this == other); }
+
+    std::uint32_t getPrivatePagesCount() const;
+    inline bool isPrivatePage(const std::uint32_t page) const { return writePages[page] != nullptr; }
+    inline const std::uint8_t* const* getReadPages() const { return readPages; }
+    inline std::uint8_t* const* getWritePages() const { return writePages; }
+private:
+    struct page {
+        alignas(64) std::uint8_t data[pageSize];
+    };
+
+    std::uint8_t* makePrivate(const std::uint32_t index);
+    void mapZeroPage(const std::uint32_t index);
+
+    static const page zeroPage;
+
+    const std::uint8_t* readPages[pagesCount];
+    std::uint8_t* writePages[pagesCount];
+    std::shared_ptr<page> pages[pagesCount]; // empty for pages of not owning view
+    bool externalPages[pagesCount];
+};
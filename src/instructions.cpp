@@ -1,325 +1,253 @@
+#include <cstring>
+
 #include "instructions.h"
+#include "event_log.h"
 
-namespace instructions {
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define VECTOR_INSTRUCTIONS_X86
+#endif
 
-instruction_base::instruction_base(const std::string& _name,
-                                   cpu_register_t* const _registers,
-                                   std::uint8_t* const _memory,
-                                   const cpu_base_properties& _cpuProperties) :
-    name(_name),
-    currentInstruction(0),
-    registers(_registers),
-    memory(_memory),
-    cpuProperties(_cpuProperties) {}
-
-status instruction_base::decodeOperands()
-{
-    return status::DECODE_UNKNOWN_INSTRUCTION;
-}
+namespace instructions {
 
-status instruction_base::executeInstruction()
+status instruction_base::execute(const decoded_instruction& /*operands*/, cpu_register_t* const /*registers*/,
+                                 guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
     return status::ATTEMPT_TO_EXECUTE_UNKNOWN_INSTRUCTION;
 }
 
-load::load(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    instruction_base("ld", _registers, _memory, _cpuProperties), dstRegisterIndex(0x0), srcAddressRegisterIndex(0x0),immediateMemoryOffset(0x0) {}
-
-status load::decodeOperands()
+status load::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                     guest_memory& memory, const cpu_base_properties& cpuProperties)
 {
-    cpu_register_t registerMask = cpuProperties.registersCount - 1;
-    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
-    std::uint32_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
-    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
-    cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
-    cpu_register_t immediateAddressMask = (0x1 << srcRegisterOffset) - 1;
-
-    dstRegisterIndex = (dstRegisterMask & currentInstruction) >> dstRegisterOffset;
-    srcAddressRegisterIndex = (srcRegisterMask & currentInstruction) >> srcRegisterOffset;
-    immediateMemoryOffset = getSignValue<cpu_register_t>(immediateAddressMask & currentInstruction, srcRegisterOffset - 1);
-    return status::STATUS_OK;
-}
-
-status load::executeInstruction()
-{
-    std::uint32_t efficientAddress;
-    if (immediateMemoryOffset & signBitMask)
-        efficientAddress = (cpu_register_t)(registers[srcAddressRegisterIndex] + immediateMemoryOffset);
-    else
-        efficientAddress = registers[srcAddressRegisterIndex] + immediateMemoryOffset;
+    std::uint32_t efficientAddress = getEfficientAddress(registers[operands.srcRegisterIndex], operands.immediate);
 
     if (efficientAddress >= cpuProperties.memorySize) {
-        LOG("load::executeInstruction()", status::OUT_OF_MEMORY_ERROR);
+        LOG("load::executeInstruction()", status::OUT_OF_MEMORY_ERROR, operands);
         return status::OUT_OF_MEMORY_ERROR;
     }
     if (efficientAddress > cpuProperties.memorySize - sizeof(cpu_register_t)) {
         std::uint32_t bytesToLoad = cpuProperties.memorySize - efficientAddress;
-        registers[dstRegisterIndex] = 0;
+        registers[operands.dstRegisterIndex] = 0;
         for (std::uint32_t i = 0; i < bytesToLoad; ++i)
-            registers[dstRegisterIndex] |= (cpu_register_t)memory[efficientAddress + i] << (BITS_IN_BYTE * i);
+            registers[operands.dstRegisterIndex] |= (cpu_register_t)memory.readByte(efficientAddress + i) << (BITS_IN_BYTE * i);
 
-        LOG("load::executeInstruction()", status::LAST_MEMORY_BYTE_WARNING);
+        LOG("load::executeInstruction()", status::LAST_MEMORY_BYTE_WARNING, operands);
         return status::LAST_MEMORY_BYTE_WARNING;
     }
 
-    registers[dstRegisterIndex] = *reinterpret_cast<cpu_register_t*>(&memory[efficientAddress]);
+    registers[operands.dstRegisterIndex] = memory.readWord(efficientAddress);
 
     return status::STATUS_OK;
 }
 
-store::store(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    instruction_base("st", _registers, _memory, _cpuProperties), dstAddressRegisterIndex(0x0), srcRegisterIndex(0x0), immediateMemoryOffset(0x0) {}
-
-status store::decodeOperands()
+status store::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                      guest_memory& memory, const cpu_base_properties& cpuProperties)
 {
-    cpu_register_t registerMask = cpuProperties.registersCount - 1;
-    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
-    std::uint32_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
-    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
-    cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
-    cpu_register_t immediateAddressMask = (0x1 << srcRegisterOffset) - 1;
-
-    dstAddressRegisterIndex = (dstRegisterMask & currentInstruction) >> dstRegisterOffset;
-    srcRegisterIndex = (srcRegisterMask & currentInstruction) >> srcRegisterOffset;
-    immediateMemoryOffset = getSignValue<cpu_register_t>(immediateAddressMask & currentInstruction, srcRegisterOffset - 1);
-    return status::STATUS_OK;
-}
-
-status store::executeInstruction()
-{
-    std::uint32_t efficientAddress;
-    if (immediateMemoryOffset & signBitMask)
-        efficientAddress = (cpu_register_t)(registers[dstAddressRegisterIndex] + immediateMemoryOffset);
-    else
-        efficientAddress = registers[dstAddressRegisterIndex] + immediateMemoryOffset;
+    std::uint32_t efficientAddress = getEfficientAddress(registers[operands.dstRegisterIndex], operands.immediate);
 
     if (efficientAddress >= cpuProperties.memorySize) {
-        LOG("store::executeInstruction()", status::OUT_OF_MEMORY_ERROR);
+        LOG("store::executeInstruction()", status::OUT_OF_MEMORY_ERROR, operands);
         return status::OUT_OF_MEMORY_ERROR;
     }
     if (efficientAddress > cpuProperties.memorySize - sizeof(cpu_register_t)) {
         std::uint32_t bytesToStore = cpuProperties.memorySize - efficientAddress;
         for (std::uint32_t i = 0; i < bytesToStore; ++i)
-            memory[efficientAddress + i] = registers[srcRegisterIndex] >> (BITS_IN_BYTE * i);
+            memory.writeByte(efficientAddress + i, registers[operands.srcRegisterIndex] >> (BITS_IN_BYTE * i));
 
-        LOG("store::executeInstruction()", status::LAST_MEMORY_BYTE_WARNING);
+        LOG("store::executeInstruction()", status::LAST_MEMORY_BYTE_WARNING, operands);
         return status::LAST_MEMORY_BYTE_WARNING;
     }
 
-    *reinterpret_cast<cpu_register_t*>(&memory[efficientAddress]) = registers[srcRegisterIndex];
-    return status::STATUS_OK;
-}
-
-load_immediate::load_immediate(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    instruction_base("ldi", _registers, _memory, _cpuProperties), dstRegisterIndex(0x0), data(0x0), isUpper(false) {}
-
-status load_immediate::decodeOperands()
-{
-    cpu_register_t registerMask = cpuProperties.registersCount - 1;
-    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
-    std::uint32_t isUpperOffset = dstRegisterOffset - 1;
-    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
-    cpu_register_t isUpperBitMask = 0x1 << isUpperOffset;
-    cpu_register_t immediateValueMask = (0x1 << BITS_IN_BYTE * (sizeof(cpu_register_t) / 2)) - 1;
-
-    dstRegisterIndex = (currentInstruction & dstRegisterMask) >> dstRegisterOffset;
-    isUpper = currentInstruction & isUpperBitMask;
-    data = currentInstruction & immediateValueMask;
+    memory.writeWord(efficientAddress, registers[operands.srcRegisterIndex]);
     return status::STATUS_OK;
 }
 
-status load_immediate::executeInstruction()
+status load_immediate::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                               guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
     std::uint32_t offset = BITS_IN_BYTE * (sizeof(cpu_register_t) / 2);
-    if (isUpper) {
-        registers[dstRegisterIndex] &= (cpu_register_t)-1 >> offset;
-        registers[dstRegisterIndex] |= data << offset;
-    }
-    else {
-        registers[dstRegisterIndex] &= (cpu_register_t)-1 << offset;
-        registers[dstRegisterIndex] |= data;
-    }
-    return status::STATUS_OK;
-}
-
-
-math_base::math_base(const std::string& _name,
-                     cpu_register_t* const _registers,
-                     std::uint8_t* const _memory,
-                     const cpu_base_properties& _cpuProperties) :
-    instruction_base(_name, _registers, _memory, _cpuProperties), isImmediate(false), dstSrcRegisterIndex(0x0), srcData(0x0) {}
-
-status math_base::decodeOperands()
-{
-    std::uint32_t isImmediateOffset =  cpuProperties.registerSize - cpuProperties.bitsPerInstruction - 1;
-    std::uint32_t dstRegisterOffset = isImmediateOffset - cpuProperties.bitsPerRegister;
-    cpu_register_t registerMask = cpuProperties.registersCount - 1;
-    cpu_register_t isImmediateBitMask = 0x1 << isImmediateOffset;
-    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
-
-    isImmediate = currentInstruction & isImmediateBitMask;
-    dstSrcRegisterIndex = (currentInstruction & dstRegisterMask) >> dstRegisterOffset;
-    if (isImmediate) {
-        cpu_register_t immediateValueMask = (0x1 << dstRegisterOffset) - 1;
-        srcData = getSignValue<cpu_register_t>(currentInstruction & immediateValueMask, dstRegisterOffset - 1);
+    if (operands.op == operation::LOAD_IMMEDIATE_UPPER) {
+        registers[operands.dstRegisterIndex] &= (cpu_register_t)-1 >> offset;
+        registers[operands.dstRegisterIndex] |= operands.immediate << offset;
     }
     else {
-        cpu_register_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
-        cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
-        srcData = (currentInstruction & srcRegisterMask) >> srcRegisterOffset;
+        registers[operands.dstRegisterIndex] &= (cpu_register_t)-1 << offset;
+        registers[operands.dstRegisterIndex] |= operands.immediate;
     }
-
     return status::STATUS_OK;
 }
 
-addition::addition(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    math_base("add", _registers, _memory, _cpuProperties) {}
 
-status addition::executeInstruction()
+status addition::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                         guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    if (isImmediate)
-        registers[dstSrcRegisterIndex] += srcData;
+    if (operands.op == operation::ADD_IMMEDIATE)
+        registers[operands.dstRegisterIndex] += operands.immediate;
     else
-        registers[dstSrcRegisterIndex] += registers[srcData];
+        registers[operands.dstRegisterIndex] += registers[operands.srcRegisterIndex];
 
     return status::STATUS_OK;
 }
 
-subtraction::subtraction(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    math_base("sub", _registers, _memory, _cpuProperties) {}
-
-status subtraction::executeInstruction()
+status subtraction::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                            guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    if (isImmediate)
-        registers[dstSrcRegisterIndex] -= srcData;
+    if (operands.op == operation::SUB_IMMEDIATE)
+        registers[operands.dstRegisterIndex] -= operands.immediate;
     else
-        registers[dstSrcRegisterIndex] -= registers[srcData];
+        registers[operands.dstRegisterIndex] -= registers[operands.srcRegisterIndex];
 
     return status::STATUS_OK;
 }
 
-multiplication::multiplication(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    math_base("mul", _registers, _memory, _cpuProperties) {}
-
-status multiplication::executeInstruction()
+status multiplication::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                               guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    if (isImmediate)
-        registers[dstSrcRegisterIndex] *= srcData;
+    if (operands.op == operation::MUL_IMMEDIATE)
+        registers[operands.dstRegisterIndex] *= operands.immediate;
     else
-        registers[dstSrcRegisterIndex] *= registers[srcData];
+        registers[operands.dstRegisterIndex] *= registers[operands.srcRegisterIndex];
 
     return status::STATUS_OK;
 }
 
-shift_right_logical::shift_right_logical(cpu_register_t* const _registers,
-                                         std::uint8_t* const _memory,
-                                         const cpu_base_properties& _cpuProperties) :
-    math_base("srl", _registers, _memory, _cpuProperties) {}
-
-status shift_right_logical::executeInstruction()
+status shift_right_logical::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                                    guest_memory& /*memory*/, const cpu_base_properties& cpuProperties)
 {
-    if (isImmediate) {
-        if (srcData > cpuProperties.registerSize) {
-            LOG("shift_right_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
+    if (operands.op == operation::SRL_IMMEDIATE) {
+        if (operands.immediate > cpuProperties.registerSize) {
+            LOG("shift_right_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH, operands);
             return status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
         }
-        registers[dstSrcRegisterIndex] >>= srcData;
+        registers[operands.dstRegisterIndex] >>= operands.immediate;
     }
     else {
-        if (registers[srcData] > cpuProperties.registerSize) {
-            LOG("shift_right_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
+        if (registers[operands.srcRegisterIndex] > cpuProperties.registerSize) {
+            LOG("shift_right_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH, operands);
             return status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
         }
-        registers[dstSrcRegisterIndex] >>= registers[srcData];
+        registers[operands.dstRegisterIndex] >>= registers[operands.srcRegisterIndex];
     }
 
     return status::STATUS_OK;
 }
 
-shift_left_logical::shift_left_logical(cpu_register_t* const _registers,
-                                       std::uint8_t* const _memory,
-                                       const cpu_base_properties& _cpuProperties) :
-    math_base("sll", _registers, _memory, _cpuProperties) {}
-
-status shift_left_logical::executeInstruction()
+status shift_left_logical::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                                   guest_memory& /*memory*/, const cpu_base_properties& cpuProperties)
 {
-    if (isImmediate) {
-        if (srcData > cpuProperties.registerSize) {
-            LOG("shift_left_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
+    if (operands.op == operation::SLL_IMMEDIATE) {
+        if (operands.immediate > cpuProperties.registerSize) {
+            LOG("shift_left_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH, operands);
             return status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
         }
-        registers[dstSrcRegisterIndex] <<= srcData;
+        registers[operands.dstRegisterIndex] <<= operands.immediate;
     }
     else {
-        if (registers[srcData] > cpuProperties.registerSize) {
-            LOG("shift_left_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
+        if (registers[operands.srcRegisterIndex] > cpuProperties.registerSize) {
+            LOG("shift_left_logical::executeInstruction()", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH, operands);
             return status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH;
         }
-        registers[dstSrcRegisterIndex] <<= registers[srcData];
+        registers[operands.dstRegisterIndex] <<= registers[operands.srcRegisterIndex];
     }
 
     return status::STATUS_OK;
 }
 
-bitwise_not::bitwise_not(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    instruction_base("not", _registers, _memory, _cpuProperties) {}
-
-status bitwise_not::decodeOperands()
+status bitwise_not::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                            guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    cpu_register_t registerMask = cpuProperties.registersCount - 1;
-    std::uint32_t dstSrcRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
-    cpu_register_t dstSrcRegisterMask = registerMask << dstSrcRegisterOffset;
-
-    dstSrcRegisterIndex = (currentInstruction & dstSrcRegisterMask) >> dstSrcRegisterOffset;
+    registers[operands.dstRegisterIndex] = ~registers[operands.dstRegisterIndex];
     return status::STATUS_OK;
 }
 
-status bitwise_not::executeInstruction()
+status bitwise_and::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                            guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    registers[dstSrcRegisterIndex] = ~registers[dstSrcRegisterIndex];
+    registers[operands.dstRegisterIndex] &= registers[operands.srcRegisterIndex];
     return status::STATUS_OK;
 }
 
-bitwise_base::bitwise_base(const std::string& _name, cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    instruction_base(_name, _registers, _memory, _cpuProperties), dstRegisterIndex(0x0), srcRegisterIndex(0x0) {}
-
-status bitwise_base::decodeOperands()
+status bitwise_or::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                           guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    cpu_register_t registerMask = cpuProperties.registersCount - 1;
-    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
-    std::uint32_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
-    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
-    cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
-
-    dstRegisterIndex = (currentInstruction & dstRegisterMask) >> dstRegisterOffset;
-    srcRegisterIndex = (currentInstruction & srcRegisterMask) >> srcRegisterOffset;
+    registers[operands.dstRegisterIndex] |= registers[operands.srcRegisterIndex];
     return status::STATUS_OK;
 }
 
-bitwise_and::bitwise_and(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    bitwise_base("and", _registers, _memory, _cpuProperties) {}
-
-status bitwise_and::executeInstruction()
+status bitwise_xor::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                            guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    registers[dstRegisterIndex] &= registers[srcRegisterIndex];
+    registers[operands.dstRegisterIndex] ^= registers[operands.srcRegisterIndex];
     return status::STATUS_OK;
 }
 
-bitwise_or::bitwise_or(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    bitwise_base("or", _registers, _memory, _cpuProperties) {}
-
-status bitwise_or::executeInstruction()
+status control_flow_base::execute(const decoded_instruction& /*operands*/, cpu_register_t* const /*registers*/,
+                                  guest_memory& /*memory*/, const cpu_base_properties& /*cpuProperties*/)
 {
-    registers[dstRegisterIndex] |= registers[srcRegisterIndex];
     return status::STATUS_OK;
 }
 
-bitwise_xor::bitwise_xor(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties) :
-    bitwise_base("xor", _registers, _memory, _cpuProperties) {}
-
-status bitwise_xor::executeInstruction()
+// Lanes are computed by SSE2, which is baseline of x86-64, other hosts
+// go lane by lane
+status packed_vector::execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                              guest_memory& memory, const cpu_base_properties& cpuProperties)
 {
-    registers[dstRegisterIndex] ^= registers[srcRegisterIndex];
+    if (operands.op == operation::VECTOR_LOAD || operands.op == operation::VECTOR_STORE) {
+        const bool isLoad = operands.op == operation::VECTOR_LOAD;
+        const std::uint32_t address = registers[isLoad ? operands.srcRegisterIndex : operands.dstRegisterIndex];
+        if (address > cpuProperties.memorySize - vectorSize) {
+            LOG("packed_vector::executeInstruction()", status::OUT_OF_MEMORY_ERROR, operands);
+            return status::OUT_OF_MEMORY_ERROR;
+        }
+        // Vector inside of one page is copied directly, write needs private page
+        const std::uint32_t page = address >> guest_memory::pageShift;
+        const bool isInPage = (address & guest_memory::pageMask) <= guest_memory::pageSize - vectorSize;
+        if (isLoad) {
+            std::uint8_t* const vector = getVectorRegister(registers, cpuProperties.registersCount, operands.dstRegisterIndex);
+            if (isInPage)
+                std::memcpy(vector, memory.getReadPages()[page] + (address & guest_memory::pageMask), vectorSize);
+            else
+                memory.read(address, vector, vectorSize);
+        }
+        else {
+            const std::uint8_t* const vector = getVectorRegister(registers, cpuProperties.registersCount, operands.srcRegisterIndex);
+            if (isInPage && memory.getWritePages()[page])
+                std::memcpy(memory.getWritePages()[page] + (address & guest_memory::pageMask), vector, vectorSize);
+            else
+                memory.write(address, vector, vectorSize);
+        }
+        return status::STATUS_OK;
+    }
+
+    std::uint8_t* const dst = getVectorRegister(registers, cpuProperties.registersCount, operands.dstRegisterIndex);
+    const std::uint8_t* const src = getVectorRegister(registers, cpuProperties.registersCount, operands.srcRegisterIndex);
+#ifdef VECTOR_INSTRUCTIONS_X86
+    const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+    const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    __m128i result = a;
+    switch (operands.op) {
+    case operation::VECTOR_ADD: result = _mm_add_epi8(a, b); break;
+    case operation::VECTOR_SUB: result = _mm_sub_epi8(a, b); break;
+    case operation::VECTOR_AND: result = _mm_and_si128(a, b); break;
+    case operation::VECTOR_OR: result = _mm_or_si128(a, b); break;
+    case operation::VECTOR_XOR: result = _mm_xor_si128(a, b); break;
+    case operation::VECTOR_COMPARE_EQUAL: result = _mm_cmpeq_epi8(a, b); break;
+    default: break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+#else
+    for (std::uint32_t lane = 0; lane < vectorSize; ++lane) {
+        switch (operands.op) {
+        case operation::VECTOR_ADD: dst[lane] += src[lane]; break;
+        case operation::VECTOR_SUB: dst[lane] -= src[lane]; break;
+        case operation::VECTOR_AND: dst[lane] &= src[lane]; break;
+        case operation::VECTOR_OR: dst[lane] |= src[lane]; break;
+        case operation::VECTOR_XOR: dst[lane] ^= src[lane]; break;
+        case operation::VECTOR_COMPARE_EQUAL: dst[lane] = dst[lane] == src[lane] ? 0xff : 0x0; break;
+        default: break;
+        }
+    }
+#endif
     return status::STATUS_OK;
 }
 
@@ -4,137 +4,561 @@
 #include <iostream>
 
 #include "base.h"
-
-class cpu;
+#include "guest_memory.h"
 
 namespace instructions {
 
+// Kind of work the decoded instruction does, register and immediate forms
+// are split so executor does not need to check flags again.
+enum class operation : std::uint8_t {
+    UNKNOWN = 0,
+    LOAD,
+    STORE,
+    LOAD_IMMEDIATE_LOWER,
+    LOAD_IMMEDIATE_UPPER,
+    ADD_REGISTER,
+    ADD_IMMEDIATE,
+    SUB_REGISTER,
+    SUB_IMMEDIATE,
+    MUL_REGISTER,
+    MUL_IMMEDIATE,
+    SRL_REGISTER,
+    SRL_IMMEDIATE,
+    SLL_REGISTER,
+    SLL_IMMEDIATE,
+    NOT,
+    AND,
+    OR,
+    XOR,
+    JUMP,
+    BRANCH_IF_SET,
+    BRANCH_IF_CLEAR,
+    CALL_REGISTER,
+    CALL_IMMEDIATE,
+    RETURN,
+    VECTOR_ADD,
+    VECTOR_SUB,
+    VECTOR_AND,
+    VECTOR_OR,
+    VECTOR_XOR,
+    VECTOR_COMPARE_EQUAL,
+    VECTOR_LOAD,
+    VECTOR_STORE,
+    // Pairs which interpreter executes with one dispatch, decode table never
+    // produces them, see fusion.h
+    FUSED_LOAD_IMMEDIATE_PAIR,
+    FUSED_LOAD_IMMEDIATE_ADD,
+    FUSED_LOAD_ADD,
+    FUSED_SUB_BRANCH
+};
+
+constexpr std::uint32_t operationsCount = (std::uint32_t)operation::VECTOR_STORE + 1;
+constexpr std::uint32_t fusedOperationsCount = (std::uint32_t)operation::FUSED_SUB_BRANCH + 1 - operationsCount;
+
+inline constexpr bool isControlFlow(const operation op) { return op >= operation::JUMP && op <= operation::RETURN; }
+inline constexpr bool isVector(const operation op) { return op >= operation::VECTOR_ADD && op <= operation::VECTOR_STORE; }
+inline constexpr bool isFused(const operation op) { return op >= operation::FUSED_LOAD_IMMEDIATE_PAIR; }
+
+// Vector extension works on bank of vectorRegistersCount registers of
+// vectorSize byte lanes. Bank is kept right after scalar registers, so
+// handlers reach it through the same registers pointer.
+constexpr std::uint32_t vectorRegistersCount = 4;
+constexpr std::uint32_t vectorSize = 16; // in bytes
+constexpr std::uint32_t vectorBankWords = vectorRegistersCount * vectorSize / sizeof(cpu_register_t);
+// Vector bit, 3 bits of operation and 2 vector registers after address register
+constexpr std::uint32_t vectorFieldsBits = 1 + 3 + 2 * integerLog2(vectorRegistersCount);
+
+inline std::uint8_t* getVectorRegister(cpu_register_t* const registers, const std::uint32_t registersCount,
+                                       const std::uint32_t index)
+{
+    return reinterpret_cast<std::uint8_t*>(registers + registersCount) + index * vectorSize;
+}
+inline const std::uint8_t* getVectorRegister(const cpu_register_t* const registers, const std::uint32_t registersCount,
+                                             const std::uint32_t index)
+{
+    return reinterpret_cast<const std::uint8_t*>(registers + registersCount) + index * vectorSize;
+}
+
+struct decoded_instruction;
+
+using execute_handler = status (*)(const decoded_instruction& operands,
+                                   cpu_register_t* const registers,
+                                   guest_memory& memory,
+                                   const cpu_base_properties& cpuProperties);
+
+using decode_handler = decoded_instruction (*)(const cpu_register_t instruction,
+                                               const cpu_base_properties& cpuProperties);
+
+// Compact, trivially copyable result of operands decoding. Every field that
+// executor needs is already extracted, so execution never looks at the
+// instruction word again.
+struct decoded_instruction {
+    execute_handler handler;
+    operation op;
+    std::uint8_t dstRegisterIndex;
+    std::uint8_t srcRegisterIndex;
+    cpu_register_t immediate;
+};
+
+// Negative offset wraps address around, positive one can go out of memory
+inline std::uint32_t getEfficientAddress(const cpu_register_t baseAddress, const cpu_register_t offset)
+{
+    if (offset & signBitMask)
+        return (cpu_register_t)(baseAddress + offset);
+    return (std::uint32_t)baseAddress + offset;
+}
+
+// Instruction classes are stateless sets of handlers. decode turns
+// instruction word into immutable decoded_instruction and execute applies it
+// to registers and memory passed by caller, so one decoded record can be
+// executed by any cpu on any thread.
 class instruction_base {
 public:
-    virtual ~instruction_base() = default;
-    virtual status decodeOperands();
-    virtual status executeInstruction();
-    inline void setCurrentInstruction(const cpu_register_t _currentInstruction) { currentInstruction = _currentInstruction; }
-protected:
-    instruction_base(const std::string& _name, cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
+    instruction_base() = delete;
 
-    const std::string name;
-    cpu_register_t currentInstruction;
-    cpu_register_t* const registers;
-    std::uint8_t* const memory;
-    const cpu_base_properties& cpuProperties;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class load: public instruction_base {
 public:
-    load(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status decodeOperands() override;
-    status executeInstruction() override;
-protected:
-    std::uint32_t dstRegisterIndex;
-    std::uint32_t srcAddressRegisterIndex;
-    cpu_register_t immediateMemoryOffset;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class store : public instruction_base {
 public:
-    store(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status decodeOperands() override;
-    status executeInstruction() override;
-protected:
-    std::uint32_t dstAddressRegisterIndex;
-    std::uint32_t srcRegisterIndex;
-    cpu_register_t immediateMemoryOffset;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class load_immediate : public instruction_base {
 public:
-    load_immediate(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status decodeOperands() override;
-    status executeInstruction() override;
-protected:
-    std::uint32_t dstRegisterIndex;
-    cpu_register_t data;
-    bool isUpper;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 
 class math_base : public instruction_base {
 public:
-    status decodeOperands() override;
-protected:
-    math_base(const std::string& _name, cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-
-    bool isImmediate;
-    std::uint32_t dstSrcRegisterIndex;
-    cpu_register_t srcData;
+    // Also used by call, which has the same fields
+    template <typename Properties>
+    static constexpr decoded_instruction decodeMath(const cpu_register_t instruction, const Properties& cpuProperties,
+                                                    const operation registerOperation, const operation immediateOperation,
+                                                    const execute_handler handler);
 };
 
 class addition : public math_base {
 public:
-    addition(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class subtraction : public math_base {
 public:
-    subtraction(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class multiplication : public math_base {
 public:
-    multiplication(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class shift_right_logical : public math_base {
 public:
-    shift_right_logical(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class shift_left_logical : public math_base {
 public:
-    shift_left_logical(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class bitwise_not : public instruction_base {
 public:
-    bitwise_not(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status decodeOperands() override;
-    status executeInstruction() override;
-protected:
-    std::uint32_t dstSrcRegisterIndex;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class bitwise_base : public instruction_base {
-public:
-    status decodeOperands() override;
 protected:
-    bitwise_base(const std::string& _name, cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-
-    std::uint32_t dstRegisterIndex;
-    std::uint32_t srcRegisterIndex;
+    template <typename Properties>
+    static constexpr decoded_instruction decodeBitwise(const cpu_register_t instruction, const Properties& cpuProperties,
+                                                       const operation bitwiseOperation, const execute_handler handler);
 };
 
 class bitwise_and : public bitwise_base {
 public:
-    bitwise_and(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class bitwise_or : public bitwise_base {
 public:
-    bitwise_or(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
 class bitwise_xor : public bitwise_base {
 public:
-    bitwise_xor(cpu_register_t* const _registers, std::uint8_t* const _memory, const cpu_base_properties& _cpuProperties);
-    status executeInstruction() override;
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
+};
+
+// Control flow instructions change only instructionPtr and link register.
+// Handlers do not see instructionPtr, so cpu executes these instructions
+// itself and their handlers do nothing. Relative forms keep byte offset
+// from the instruction in immediate, register forms keep register with
+// target address in srcRegisterIndex.
+class control_flow_base : public instruction_base {
+public:
+    // Address of the next instruction if control is transferred
+    static inline std::uint32_t getTarget(const std::uint32_t address, const decoded_instruction& operands,
+                                          const cpu_register_t* const registers)
+    {
+        if (operands.op == operation::CALL_REGISTER || operands.op == operation::RETURN)
+            return registers[operands.srcRegisterIndex];
+        return (cpu_register_t)(address + operands.immediate);
+    }
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
+};
+
+class jump : public control_flow_base {
+public:
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+};
+
+// Branch tests one bit of status register, its index is kept in
+// srcRegisterIndex, see flags.h.
+class branch : public control_flow_base {
+public:
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+};
+
+// Call writes address of the next instruction into dstRegisterIndex
+class call : public control_flow_base {
+public:
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+};
+
+// Return has unused low bits, words with vector bit set there belong to
+// packed_vector instead
+class return_from_call : public control_flow_base {
+public:
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+};
+
+// Packed byte instructions of vector extension. Arithmetic ones keep
+// destination vector register in dstRegisterIndex and source one in
+// srcRegisterIndex, compare sets lanes to 0xff if equal and to 0 otherwise.
+// Load and store are laid out as scalar ones: load keeps vector register in
+// dstRegisterIndex and address register in srcRegisterIndex, store the
+// other way around. Whole vector has to be inside of memory.
+class packed_vector : public instruction_base {
+public:
+    template <typename Properties>
+    static constexpr decoded_instruction decode(const cpu_register_t instruction, const Properties& cpuProperties);
+    static status execute(const decoded_instruction& operands, cpu_register_t* const registers,
+                          guest_memory& memory, const cpu_base_properties& cpuProperties);
 };
 
+// Decoders are templates, so with compile-time properties every mask and
+// offset is a constant.
+
+template <typename Properties>
+constexpr decoded_instruction instruction_base::decode(const cpu_register_t /*instruction*/, const Properties& /*cpuProperties*/)
+{
+    return { instruction_base::execute, operation::UNKNOWN, 0x0, 0x0, 0x0 };
+}
+
+template <typename Properties>
+constexpr decoded_instruction load::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    std::uint32_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
+    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
+    cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
+    cpu_register_t immediateAddressMask = (0x1 << srcRegisterOffset) - 1;
+
+    decoded_instruction operands = { load::execute, operation::LOAD, 0x0, 0x0, 0x0 };
+    operands.dstRegisterIndex = (dstRegisterMask & instruction) >> dstRegisterOffset;
+    operands.srcRegisterIndex = (srcRegisterMask & instruction) >> srcRegisterOffset;
+    operands.immediate = getSignValue<cpu_register_t>(immediateAddressMask & instruction, srcRegisterOffset - 1);
+    return operands;
+}
+
+// Destination address register is placed into dstRegisterIndex, stored value
+// register into srcRegisterIndex.
+template <typename Properties>
+constexpr decoded_instruction store::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    std::uint32_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
+    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
+    cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
+    cpu_register_t immediateAddressMask = (0x1 << srcRegisterOffset) - 1;
+
+    decoded_instruction operands = { store::execute, operation::STORE, 0x0, 0x0, 0x0 };
+    operands.dstRegisterIndex = (dstRegisterMask & instruction) >> dstRegisterOffset;
+    operands.srcRegisterIndex = (srcRegisterMask & instruction) >> srcRegisterOffset;
+    operands.immediate = getSignValue<cpu_register_t>(immediateAddressMask & instruction, srcRegisterOffset - 1);
+    return operands;
+}
+
+template <typename Properties>
+constexpr decoded_instruction load_immediate::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    std::uint32_t isUpperOffset = dstRegisterOffset - 1;
+    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
+    cpu_register_t isUpperBitMask = 0x1 << isUpperOffset;
+    cpu_register_t immediateValueMask = (0x1 << BITS_IN_BYTE * (sizeof(cpu_register_t) / 2)) - 1;
+
+    decoded_instruction operands = { load_immediate::execute, operation::LOAD_IMMEDIATE_LOWER, 0x0, 0x0, 0x0 };
+    if (instruction & isUpperBitMask)
+        operands.op = operation::LOAD_IMMEDIATE_UPPER;
+    operands.dstRegisterIndex = (instruction & dstRegisterMask) >> dstRegisterOffset;
+    operands.immediate = instruction & immediateValueMask;
+    return operands;
+}
+
+// Register form keeps source register index in srcRegisterIndex, immediate
+// form keeps sign extended value in immediate.
+template <typename Properties>
+constexpr decoded_instruction math_base::decodeMath(const cpu_register_t instruction, const Properties& cpuProperties,
+                                                    const operation registerOperation, const operation immediateOperation,
+                                                    const execute_handler handler)
+{
+    std::uint32_t isImmediateOffset =  cpuProperties.registerSize - cpuProperties.bitsPerInstruction - 1;
+    std::uint32_t dstRegisterOffset = isImmediateOffset - cpuProperties.bitsPerRegister;
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    cpu_register_t isImmediateBitMask = 0x1 << isImmediateOffset;
+    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
+
+    decoded_instruction operands = { handler, registerOperation, 0x0, 0x0, 0x0 };
+    operands.dstRegisterIndex = (instruction & dstRegisterMask) >> dstRegisterOffset;
+    if (instruction & isImmediateBitMask) {
+        cpu_register_t immediateValueMask = (0x1 << dstRegisterOffset) - 1;
+        operands.op = immediateOperation;
+        operands.immediate = getSignValue<cpu_register_t>(instruction & immediateValueMask, dstRegisterOffset - 1);
+    }
+    else {
+        cpu_register_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
+        cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
+        operands.srcRegisterIndex = (instruction & srcRegisterMask) >> srcRegisterOffset;
+    }
+
+    return operands;
+}
+
+template <typename Properties>
+constexpr decoded_instruction addition::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeMath(instruction, cpuProperties, operation::ADD_REGISTER, operation::ADD_IMMEDIATE, addition::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction subtraction::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeMath(instruction, cpuProperties, operation::SUB_REGISTER, operation::SUB_IMMEDIATE, subtraction::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction multiplication::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeMath(instruction, cpuProperties, operation::MUL_REGISTER, operation::MUL_IMMEDIATE, multiplication::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction shift_right_logical::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeMath(instruction, cpuProperties, operation::SRL_REGISTER, operation::SRL_IMMEDIATE, shift_right_logical::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction shift_left_logical::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeMath(instruction, cpuProperties, operation::SLL_REGISTER, operation::SLL_IMMEDIATE, shift_left_logical::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction bitwise_not::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t dstSrcRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    cpu_register_t dstSrcRegisterMask = registerMask << dstSrcRegisterOffset;
+
+    decoded_instruction operands = { bitwise_not::execute, operation::NOT, 0x0, 0x0, 0x0 };
+    operands.dstRegisterIndex = (instruction & dstSrcRegisterMask) >> dstSrcRegisterOffset;
+    return operands;
+}
+
+template <typename Properties>
+constexpr decoded_instruction bitwise_base::decodeBitwise(const cpu_register_t instruction, const Properties& cpuProperties,
+                                                          const operation bitwiseOperation, const execute_handler handler)
+{
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t dstRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    std::uint32_t srcRegisterOffset = dstRegisterOffset - cpuProperties.bitsPerRegister;
+    cpu_register_t dstRegisterMask = registerMask << dstRegisterOffset;
+    cpu_register_t srcRegisterMask = registerMask << srcRegisterOffset;
+
+    decoded_instruction operands = { handler, bitwiseOperation, 0x0, 0x0, 0x0 };
+    operands.dstRegisterIndex = (instruction & dstRegisterMask) >> dstRegisterOffset;
+    operands.srcRegisterIndex = (instruction & srcRegisterMask) >> srcRegisterOffset;
+    return operands;
+}
+
+template <typename Properties>
+constexpr decoded_instruction bitwise_and::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeBitwise(instruction, cpuProperties, operation::AND, bitwise_and::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction bitwise_or::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeBitwise(instruction, cpuProperties, operation::OR, bitwise_or::execute);
+}
+
+template <typename Properties>
+constexpr decoded_instruction bitwise_xor::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    return decodeBitwise(instruction, cpuProperties, operation::XOR, bitwise_xor::execute);
+}
+
+// Offset of jump takes all bits after opcode and counts instructions
+template <typename Properties>
+constexpr decoded_instruction jump::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    std::uint32_t offsetBits = cpuProperties.registerSize - cpuProperties.bitsPerInstruction;
+    cpu_register_t offsetMask = (0x1 << offsetBits) - 1;
+
+    decoded_instruction operands = { jump::execute, operation::JUMP, 0x0, 0x0, 0x0 };
+    operands.immediate = getSignValue<cpu_register_t>(instruction & offsetMask, offsetBits - 1) * sizeof(cpu_register_t);
+    return operands;
+}
+
+// Branch has 2 bits of flag index, bit which selects branch if flag is clear
+// and offset in instructions
+template <typename Properties>
+constexpr decoded_instruction branch::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    std::uint32_t flagIndexOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - 2;
+    std::uint32_t isClearOffset = flagIndexOffset - 1;
+    cpu_register_t flagIndexMask = 0x3 << flagIndexOffset;
+    cpu_register_t isClearBitMask = 0x1 << isClearOffset;
+    cpu_register_t offsetMask = (0x1 << isClearOffset) - 1;
+
+    decoded_instruction operands = { branch::execute, operation::BRANCH_IF_SET, 0x0, 0x0, 0x0 };
+    if (instruction & isClearBitMask)
+        operands.op = operation::BRANCH_IF_CLEAR;
+    operands.srcRegisterIndex = (instruction & flagIndexMask) >> flagIndexOffset;
+    operands.immediate = getSignValue<cpu_register_t>(instruction & offsetMask, isClearOffset - 1) * sizeof(cpu_register_t);
+    return operands;
+}
+
+// Same fields as math instructions, immediate form keeps offset in instructions
+template <typename Properties>
+constexpr decoded_instruction call::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    decoded_instruction operands = math_base::decodeMath(instruction, cpuProperties, operation::CALL_REGISTER,
+                                                         operation::CALL_IMMEDIATE, call::execute);
+    operands.immediate *= sizeof(cpu_register_t);
+    return operands;
+}
+
+// Register with return address is placed as dst register of not, bit after
+// it selects vector extension
+template <typename Properties>
+constexpr decoded_instruction return_from_call::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t registerOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    if (instruction & (0x1 << (registerOffset - 1)))
+        return packed_vector::decode(instruction, cpuProperties);
+
+    decoded_instruction operands = { return_from_call::execute, operation::RETURN, 0x0, 0x0, 0x0 };
+    operands.srcRegisterIndex = (instruction & (registerMask << registerOffset)) >> registerOffset;
+    return operands;
+}
+
+// Scalar address register takes place of return register, then vector bit,
+// 3 bits of operation and 2 bits of each vector register follow. Runtime
+// geometry without room for these fields has no vector extension.
+template <typename Properties>
+constexpr decoded_instruction packed_vector::decode(const cpu_register_t instruction, const Properties& cpuProperties)
+{
+    constexpr operation operations[] = {
+        operation::VECTOR_ADD, operation::VECTOR_SUB, operation::VECTOR_AND, operation::VECTOR_OR,
+        operation::VECTOR_XOR, operation::VECTOR_COMPARE_EQUAL, operation::VECTOR_LOAD, operation::VECTOR_STORE
+    };
+    constexpr std::uint32_t vectorRegisterBits = integerLog2(vectorRegistersCount);
+    if constexpr (is_static_cpu_properties<Properties>::value) {
+        static_assert(Properties::registerSize - Properties::bitsPerInstruction - Properties::bitsPerRegister >= vectorFieldsBits,
+                      "vector instruction fields do not fit into instruction");
+    }
+    else if (cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister < vectorFieldsBits) {
+        return instruction_base::decode(instruction, cpuProperties);
+    }
+    cpu_register_t registerMask = cpuProperties.registersCount - 1;
+    std::uint32_t addressRegisterOffset = cpuProperties.registerSize - cpuProperties.bitsPerInstruction - cpuProperties.bitsPerRegister;
+    std::uint32_t operationOffset = addressRegisterOffset - 1 - 3;
+    std::uint32_t firstVectorOffset = operationOffset - vectorRegisterBits;
+    std::uint32_t secondVectorOffset = firstVectorOffset - vectorRegisterBits;
+    cpu_register_t vectorRegisterMask = vectorRegistersCount - 1;
+
+    const std::uint8_t addressRegister = (instruction >> addressRegisterOffset) & registerMask;
+    const std::uint8_t firstVector = (instruction >> firstVectorOffset) & vectorRegisterMask;
+    const std::uint8_t secondVector = (instruction >> secondVectorOffset) & vectorRegisterMask;
+    decoded_instruction operands = { packed_vector::execute, operations[(instruction >> operationOffset) & 0x7],
+                                     firstVector, secondVector, 0x0 };
+    if (operands.op == operation::VECTOR_LOAD) {
+        operands.srcRegisterIndex = addressRegister;
+    }
+    else if (operands.op == operation::VECTOR_STORE) {
+        operands.dstRegisterIndex = addressRegister;
+        operands.srcRegisterIndex = firstVector;
+    }
+    return operands;
+}
+
 }
@@ -0,0 +1,829 @@
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <fstream>
+#include <unordered_map>
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define JIT_SUPPORTED
+#endif
+
+#include "jit.h"
+#include "mapped_file.h"
+#include "program_image.h"
+#include "translation_cache.h"
+
+using instructions::operation;
+using instructions::decoded_instruction;
+
+namespace {
+
+// Host registers used by generated code
+//   rbx - guest registers, r12 - read pages table, r13 - jit_context,
+//   r14 - code pages flags, r15 - write pages table.
+constexpr std::uint8_t budgetOffset = offsetof(jit_context, budget);
+constexpr std::uint8_t exitAddressOffset = offsetof(jit_context, exitAddress);
+constexpr std::uint8_t exitReasonOffset = offsetof(jit_context, exitReason);
+constexpr std::uint8_t exitBlockOffset = offsetof(jit_context, exitBlock);
+constexpr std::uint8_t flagsOffset = offsetof(jit_context, flags);
+constexpr std::uint8_t flagsOpOffset = flagsOffset + offsetof(instructions::lazy_flags, op);
+constexpr std::uint8_t flagsLeftOffset = offsetof(jit_context, flags) + offsetof(instructions::lazy_flags, left);
+constexpr std::uint8_t flagsRightOffset = offsetof(jit_context, flags) + offsetof(instructions::lazy_flags, right);
+constexpr std::uint8_t flagsResultOffset = offsetof(jit_context, flags) + offsetof(instructions::lazy_flags, result);
+static_assert(offsetof(jit_context, flags) + sizeof(instructions::lazy_flags) <= 0x80, "context fields use disp8");
+
+class x86_emitter {
+public:
+    x86_emitter(std::uint8_t* const _begin, std::uint8_t* const _end) : begin(_begin), current(_begin), end(_end) {}
+
+    inline bool isOverflowed() const { return current > end; }
+    inline std::uint8_t* position() const { return current; }
+    inline std::size_t size() const { return current - begin; }
+
+    void bytes(std::initializer_list<std::uint8_t> data)
+    {
+        for (std::uint8_t byte : data)
+            emitByte(byte);
+    }
+    void imm16(const std::uint16_t value)
+    {
+        emitByte(value); emitByte(value >> 8);
+    }
+    void imm32(const std::uint32_t value)
+    {
+        imm16(value); imm16(value >> 16);
+    }
+    void imm64(const std::uint64_t value)
+    {
+        imm32(value); imm32(value >> 32);
+    }
+    // Emits placeholder of rel32 and returns its position for patching
+    std::uint8_t* rel32()
+    {
+        std::uint8_t* operand = current;
+        imm32(0);
+        return operand;
+    }
+
+    static void patchRel32(std::uint8_t* const operand, const std::uint8_t* const target)
+    {
+        std::int32_t offset = (std::int32_t)(target - (operand + 4));
+        std::memcpy(operand, &offset, sizeof(offset));
+    }
+
+    // movzx eax/ecx, word [rbx + 2 * index]
+    void loadRegister(const std::uint8_t hostRegister, const std::uint32_t index)
+    {
+        bytes({ 0x0f, 0xb7, (std::uint8_t)(0x43 | (hostRegister << 3)), (std::uint8_t)(index * 2) });
+    }
+    // mov word [rbx + 2 * index], ax/cx
+    void storeRegister(const std::uint8_t hostRegister, const std::uint32_t index)
+    {
+        bytes({ 0x66, 0x89, (std::uint8_t)(0x43 | (hostRegister << 3)), (std::uint8_t)(index * 2) });
+    }
+    // mov dword [r13 + offset], imm32
+    void storeContext(const std::uint8_t offset, const std::uint32_t value)
+    {
+        bytes({ 0x41, 0xc7, 0x45, offset }); imm32(value);
+    }
+    // mov word [r13 + offset], ax/cx
+    void storeContextWord(const std::uint8_t hostRegister, const std::uint8_t offset)
+    {
+        bytes({ 0x66, 0x41, 0x89, (std::uint8_t)(0x45 | (hostRegister << 3)), offset });
+    }
+    // mov word [r13 + offset], imm16
+    void storeContextWordImmediate(const std::uint8_t offset, const std::uint16_t value)
+    {
+        bytes({ 0x66, 0x41, 0xc7, 0x45, offset }); imm16(value);
+    }
+    // mov byte [r13 + offset], imm8
+    void storeContextByte(const std::uint8_t offset, const std::uint8_t value)
+    {
+        bytes({ 0x41, 0xc6, 0x45, offset, value });
+    }
+    // Exit to dispatcher, budget of not executed instructions is returned
+    void exitBlock(const std::uint32_t returnedBudget, const std::uint32_t address,
+                   const jit_exit_reason reason, const std::uint32_t blockIndex,
+                   const std::uint8_t* const exitTrampoline)
+    {
+        if (returnedBudget) {
+            bytes({ 0x49, 0x81, 0x45, budgetOffset }); imm32(returnedBudget); // add qword [r13 + budget], imm32
+        }
+        storeContext(exitAddressOffset, address);
+        storeContext(exitReasonOffset, (std::uint32_t)reason);
+        storeContext(exitBlockOffset, blockIndex);
+        emitByte(0xe9);
+        std::uint8_t* jump = rel32();
+        if (!isOverflowed())
+            patchRel32(jump, exitTrampoline);
+    }
+
+    static constexpr std::uint8_t eax = 0;
+    static constexpr std::uint8_t ecx = 1;
+private:
+    inline void emitByte(const std::uint8_t byte)
+    {
+        if (current < end)
+            *current = byte;
+        ++current;
+    }
+
+    std::uint8_t* const begin;
+    std::uint8_t* current;
+    std::uint8_t* const end;
+};
+
+// Called by generated code for flags which are not taken from result directly
+cpu_register_t getStatusFlags(const instructions::lazy_flags* const flags)
+{
+    return flags->get();
+}
+
+// Second opcode byte of SSE2 instruction which computes vector operation
+std::uint8_t vectorOpcode(const operation op)
+{
+    switch (op) {
+    case operation::VECTOR_ADD: return 0xfc;            // paddb
+    case operation::VECTOR_SUB: return 0xf8;            // psubb
+    case operation::VECTOR_AND: return 0xdb;            // pand
+    case operation::VECTOR_OR: return 0xeb;             // por
+    case operation::VECTOR_XOR: return 0xef;            // pxor
+    case operation::VECTOR_COMPARE_EQUAL: return 0x74;  // pcmpeqb
+    default: return 0x00;
+    }
+}
+static_assert(default_cpu_properties::registersCount * sizeof(cpu_register_t) +
+              instructions::vectorRegistersCount * instructions::vectorSize <= 0x80, "vector registers use disp8");
+
+struct side_exit {
+    std::uint8_t* jump;
+    std::uint32_t address;
+    std::uint32_t executedInstructions;
+};
+
+}
+
+jit_engine::jit_engine(const cpu_base_properties& _cpuProperties,
+                       std::shared_ptr<const instructions::decode_table> _decodeTable) :
+    cpuProperties(_cpuProperties), decodeTable(std::move(_decodeTable)),
+    codeBuffer(nullptr), codeBufferUsed(0), enterTrampoline(nullptr), exitTrampoline(nullptr), writeScopes(0),
+    blockByAddress(new block*[_cpuProperties.memorySize]{}),
+    codePages(new std::uint8_t[(_cpuProperties.memorySize >> codePageShift) + 1]{}),
+    pageBlocks(new std::vector<std::uint32_t>[(_cpuProperties.memorySize >> codePageShift) + 1])
+{
+#ifdef JIT_SUPPORTED
+    void* buffer = mmap(nullptr, codeBufferSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer != MAP_FAILED) {
+        codeBuffer = static_cast<std::uint8_t*>(buffer);
+        emitTrampolines();
+        if (mprotect(codeBuffer, codeBufferSize, PROT_READ | PROT_EXEC)) {
+            munmap(codeBuffer, codeBufferSize);
+            codeBuffer = nullptr;
+        }
+    }
+#endif
+}
+
+jit_engine::~jit_engine()
+{
+#ifdef JIT_SUPPORTED
+    if (codeBuffer)
+        munmap(codeBuffer, codeBufferSize);
+#endif
+}
+
+jit_engine::write_scope::write_scope(jit_engine& _engine) : engine(_engine)
+{
+#ifdef JIT_SUPPORTED
+    if (engine.codeBuffer && engine.writeScopes++ == 0)
+        mprotect(engine.codeBuffer, codeBufferSize, PROT_READ | PROT_WRITE);
+#endif
+}
+
+jit_engine::write_scope::~write_scope()
+{
+#ifdef JIT_SUPPORTED
+    if (engine.codeBuffer && --engine.writeScopes == 0)
+        mprotect(engine.codeBuffer, codeBufferSize, PROT_READ | PROT_EXEC);
+#endif
+}
+
+std::uint64_t jit_engine::getBuildFingerprint()
+{
+    // Rebuilds with the same emitter and compiler keep saved translations
+#ifdef __VERSION__
+    static const char compiler[] = __VERSION__;
+#else
+    static const char compiler[] = "";
+#endif
+    const std::uint32_t versions[] = { emitterVersion, translation_cache_header::currentVersion };
+    static const std::uint64_t fingerprint = getContentHash(compiler, sizeof(compiler) - 1,
+                                                            getContentHash(versions, sizeof(versions)));
+    return fingerprint;
+}
+
+bool jit_engine::isSupported()
+{
+#ifdef JIT_SUPPORTED
+    return true;
+#else
+    return false;
+#endif
+}
+
+void jit_engine::emitTrampolines()
+{
+    x86_emitter emitter(codeBuffer, codeBuffer + codeBufferSize);
+
+    // void enter(jit_context* context, const std::uint8_t* code)
+    enterTrampoline = emitter.position();
+    emitter.bytes({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56 }); // push rbx, r12, r13, r14
+    emitter.bytes({ 0x41, 0x57 });                               // push r15
+    emitter.bytes({ 0x48, 0x8b, 0x1f });                         // mov rbx, [rdi]
+    emitter.bytes({ 0x4c, 0x8b, 0x67, 0x08 });                   // mov r12, [rdi + 8]
+    emitter.bytes({ 0x4c, 0x8b, 0x77, 0x10 });                   // mov r14, [rdi + 16]
+    emitter.bytes({ 0x4c, 0x8b, 0x7f, 0x18 });                   // mov r15, [rdi + 24]
+    emitter.bytes({ 0x49, 0x89, 0xfd });                         // mov r13, rdi
+    emitter.bytes({ 0xff, 0xe6 });                               // jmp rsi
+
+    exitTrampoline = emitter.position();
+    emitter.bytes({ 0x41, 0x5f });                               // pop r15
+    emitter.bytes({ 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c, 0x5b }); // pop r14, r13, r12, rbx
+    emitter.bytes({ 0xc3 });                                     // ret
+
+    codeBufferUsed = emitter.size();
+}
+
+jit_engine::block* jit_engine::getBlock(const std::uint32_t address, const guest_memory& memory)
+{
+    if (!codeBuffer)
+        return nullptr;
+    block* codeBlock = blockByAddress[address];
+    if (codeBlock)
+        return codeBlock;
+    return translate(address, memory);
+}
+
+void jit_engine::execute(const block* const codeBlock, jit_context& context) const
+{
+    context.codePages = codePages.get();
+    reinterpret_cast<void (*)(jit_context*, const std::uint8_t*)>(enterTrampoline)(&context, codeBlock->code);
+}
+
+void jit_engine::chain(const std::uint32_t fromBlock, block* const toBlock)
+{
+    if (fromBlock >= blocks.size())
+        return;
+    block* predecessor = blocks[fromBlock].get();
+    if (!predecessor->isValid || !toBlock->isValid)
+        return;
+    write_scope writable(*this);
+    for (std::uint32_t exit = 0; exit < 2; ++exit) {
+        if (!predecessor->chainJumps[exit] || predecessor->chainTargets[exit] != toBlock->startAddress)
+            continue;
+        x86_emitter::patchRel32(predecessor->chainJumps[exit], toBlock->code);
+        toBlock->incomingJumps.push_back(predecessor->chainJumps[exit]);
+    }
+}
+
+void jit_engine::invalidate(const std::uint32_t address, const std::uint32_t size)
+{
+    const std::uint32_t lastPage = (address + size - 1) >> codePageShift;
+    for (std::uint32_t page = address >> codePageShift; page <= lastPage; ++page) {
+        if (!codePages[page])
+            continue;
+
+        write_scope writable(*this);
+        std::vector<std::uint32_t> touchedPages;
+        for (std::uint32_t index : pageBlocks[page]) {
+            block* codeBlock = blocks[index].get();
+            if (!codeBlock->isValid)
+                continue;
+
+            codeBlock->isValid = false;
+            blockByAddress[codeBlock->startAddress] = nullptr;
+            // Predecessors have already stored address of this block before
+            // the jump, so they just return to dispatcher again
+            for (std::uint8_t* jump : codeBlock->incomingJumps)
+                x86_emitter::patchRel32(jump, exitTrampoline);
+            codeBlock->incomingJumps.clear();
+            for (std::uint32_t other = codeBlock->startAddress >> codePageShift;
+                 other <= (codeBlock->endAddress - 1) >> codePageShift; ++other)
+                touchedPages.push_back(other);
+        }
+        pageBlocks[page].clear();
+        codePages[page] = 0;
+
+        for (std::uint32_t other : touchedPages) {
+            codePages[other] = 0;
+            for (std::uint32_t index : pageBlocks[other])
+                codePages[other] |= blocks[index]->isValid;
+        }
+    }
+}
+
+void jit_engine::flush()
+{
+    const std::uint32_t pagesCount = (cpuProperties.memorySize >> codePageShift) + 1;
+    for (auto& codeBlock : blocks)
+        blockByAddress[codeBlock->startAddress] = nullptr;
+    blocks.clear();
+    relocations.clear();
+    for (std::uint32_t page = 0; page < pagesCount; ++page) {
+        pageBlocks[page].clear();
+        codePages[page] = 0;
+    }
+    if (codeBuffer) {
+        write_scope writable(*this);
+        codeBufferUsed = 0;
+        emitTrampolines();
+    }
+}
+
+std::uint64_t jit_engine::getCodeHash(const std::vector<std::pair<std::uint32_t, std::uint32_t>>& ranges,
+                                      const guest_memory& memory) const
+{
+    const std::uint32_t geometry[] = { cpuProperties.registersCount, cpuProperties.registerSize,
+                                       cpuProperties.maxInstructionsCount };
+    std::uint64_t hash = getContentHash(geometry, sizeof(geometry));
+    std::vector<std::uint8_t> code;
+    for (const auto& [startAddress, endAddress] : ranges) {
+        code.resize(endAddress - startAddress);
+        memory.read(startAddress, code.data(), code.size());
+        hash = getContentHash(&startAddress, sizeof(startAddress), hash);
+        hash = getContentHash(code.data(), code.size(), hash);
+    }
+    return hash;
+}
+
+status jit_engine::save(const std::string& path, const guest_memory& memory) const
+{
+    if (!codeBuffer)
+        return status::FILE_ACCESS_ERROR;
+
+    std::vector<translation_cache_block> table;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+    for (const auto& codeBlock : blocks) {
+        translation_cache_block entry = { codeBlock->startAddress, codeBlock->endAddress,
+                                          (std::uint32_t)(codeBlock->code - codeBuffer), {}, {}, codeBlock->isValid };
+        for (std::uint32_t exit = 0; exit < 2; ++exit) {
+            entry.chainJumpOffsets[exit] = codeBlock->chainJumps[exit] ? (std::uint32_t)(codeBlock->chainJumps[exit] - codeBuffer)
+                                                                       : translation_cache_block::noChainJump;
+            entry.chainTargets[exit] = codeBlock->chainTargets[exit];
+        }
+        table.push_back(entry);
+        if (codeBlock->isValid)
+            ranges.emplace_back(codeBlock->startAddress, codeBlock->endAddress);
+    }
+
+    translation_cache_header header = {};
+    std::memcpy(header.magic, translation_cache_header::magicValue, sizeof(header.magic));
+    header.version = translation_cache_header::currentVersion;
+    header.registersCount = cpuProperties.registersCount;
+    header.registerSize = cpuProperties.registerSize;
+    header.maxInstructionsCount = cpuProperties.maxInstructionsCount;
+    header.contextSize = sizeof(jit_context);
+    header.blocksCount = table.size();
+    header.relocationsCount = relocations.size();
+    header.codeSize = codeBufferUsed;
+    const std::size_t tableSize = table.size() * sizeof(translation_cache_block);
+    const std::size_t relocationsSize = relocations.size() * sizeof(std::uint32_t);
+    header.checksum = program_image::checksum(reinterpret_cast<const std::uint8_t*>(table.data()), tableSize);
+    header.checksum = program_image::checksum(reinterpret_cast<const std::uint8_t*>(relocations.data()), relocationsSize,
+                                              header.checksum);
+    header.checksum = program_image::checksum(codeBuffer, codeBufferUsed, header.checksum);
+    header.codeHash = getCodeHash(ranges, memory);
+    header.buildFingerprint = getBuildFingerprint();
+
+    // Readers in other processes see either old or new file
+    const std::string temporaryPath = path + "." +
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+                       std::chrono::steady_clock::now().time_since_epoch().count()) + ".tmp";
+    std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), tableSize);
+    file.write(reinterpret_cast<const char*>(relocations.data()), relocationsSize);
+    file.write(reinterpret_cast<const char*>(codeBuffer), codeBufferUsed);
+    file.close();
+#ifdef JIT_SUPPORTED
+    // Umask may leave file writable by group, load would reject it
+    chmod(temporaryPath.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+#endif
+    if (!file || std::rename(temporaryPath.c_str(), path.c_str())) {
+        std::remove(temporaryPath.c_str());
+        return status::FILE_ACCESS_ERROR;
+    }
+    return status::STATUS_OK;
+}
+
+status jit_engine::load(const std::string& path, const guest_memory& memory)
+{
+    if (!codeBuffer)
+        return status::FILE_ACCESS_ERROR;
+    std::shared_ptr<mapped_file> file = mapped_file::open(path, true);
+    if (!file)
+        return status::FILE_ACCESS_ERROR;
+
+    translation_cache_header header;
+    if (file->size() < sizeof(header))
+        return status::FILE_FORMAT_ERROR;
+    std::memcpy(&header, file->data(), sizeof(header));
+    const std::uint64_t tableSize = (std::uint64_t)header.blocksCount * sizeof(translation_cache_block);
+    const std::uint64_t relocationsSize = (std::uint64_t)header.relocationsCount * sizeof(std::uint32_t);
+    if (std::memcmp(header.magic, translation_cache_header::magicValue, sizeof(header.magic)) ||
+        header.version != translation_cache_header::currentVersion || header.buildFingerprint != getBuildFingerprint() ||
+        header.registersCount != cpuProperties.registersCount || header.registerSize != cpuProperties.registerSize ||
+        header.maxInstructionsCount != cpuProperties.maxInstructionsCount || header.contextSize != sizeof(jit_context) ||
+        header.codeSize > codeBufferSize || sizeof(header) + tableSize + relocationsSize + header.codeSize != file->size())
+        return status::FILE_FORMAT_ERROR;
+
+    const std::uint8_t* const tableData = file->data() + sizeof(header);
+    const std::uint8_t* const relocationsData = tableData + tableSize;
+    const std::uint8_t* const code = relocationsData + relocationsSize;
+    std::uint32_t checksum = program_image::checksum(tableData, tableSize);
+    checksum = program_image::checksum(relocationsData, relocationsSize, checksum);
+    if (program_image::checksum(code, header.codeSize, checksum) != header.checksum)
+        return status::FILE_CHECKSUM_ERROR;
+
+    std::vector<translation_cache_block> table(header.blocksCount);
+    std::vector<std::uint32_t> loadedRelocations(header.relocationsCount);
+    std::memcpy(table.data(), tableData, tableSize);
+    std::memcpy(loadedRelocations.data(), relocationsData, relocationsSize);
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> ranges;
+    for (const translation_cache_block& entry : table) {
+        bool isValid = entry.startAddress < entry.endAddress && entry.endAddress <= cpuProperties.memorySize &&
+                       entry.codeOffset < header.codeSize;
+        for (std::uint32_t exit = 0; exit < 2; ++exit)
+            isValid &= entry.chainJumpOffsets[exit] == translation_cache_block::noChainJump ||
+                       (std::uint64_t)entry.chainJumpOffsets[exit] + sizeof(std::int32_t) <= header.codeSize;
+        if (!isValid)
+            return status::FILE_FORMAT_ERROR;
+        if (entry.isValid)
+            ranges.emplace_back(entry.startAddress, entry.endAddress);
+    }
+    for (const std::uint32_t offset : loadedRelocations)
+        if ((std::uint64_t)offset + sizeof(std::uint64_t) > header.codeSize)
+            return status::FILE_FORMAT_ERROR;
+    if (getCodeHash(ranges, memory) != header.codeHash)
+        return status::FILE_STALE_ERROR;
+
+    // Trampolines are emitted at the same offsets, blocks and jumps between
+    // them keep their offsets, only helper addresses are patched
+    write_scope writable(*this);
+    flush();
+    std::memcpy(codeBuffer, code, header.codeSize);
+    codeBufferUsed = header.codeSize;
+    const std::uint64_t helper = reinterpret_cast<std::uint64_t>(&getStatusFlags);
+    for (const std::uint32_t offset : loadedRelocations)
+        std::memcpy(codeBuffer + offset, &helper, sizeof(helper));
+    relocations = std::move(loadedRelocations);
+
+    for (const translation_cache_block& entry : table) {
+        blocks.emplace_back(new block{ entry.startAddress, entry.endAddress, codeBuffer + entry.codeOffset, {},
+                                       { entry.chainTargets[0], entry.chainTargets[1] }, {}, entry.isValid != 0 });
+        block* codeBlock = blocks.back().get();
+        for (std::uint32_t exit = 0; exit < 2; ++exit)
+            codeBlock->chainJumps[exit] = entry.chainJumpOffsets[exit] == translation_cache_block::noChainJump ? nullptr :
+                                          codeBuffer + entry.chainJumpOffsets[exit];
+        if (!codeBlock->isValid)
+            continue;
+        blockByAddress[entry.startAddress] = codeBlock;
+        for (std::uint32_t page = entry.startAddress >> codePageShift; page <= (entry.endAddress - 1) >> codePageShift; ++page) {
+            pageBlocks[page].push_back(blocks.size() - 1);
+            codePages[page] = 1;
+        }
+    }
+    // Chained exits are found by their targets, so invalidation can unchain them again
+    std::unordered_map<const std::uint8_t*, block*> blockByCode;
+    for (const auto& codeBlock : blocks)
+        if (codeBlock->isValid)
+            blockByCode[codeBlock->code] = codeBlock.get();
+    for (const auto& codeBlock : blocks) {
+        for (std::uint8_t* const jump : codeBlock->chainJumps) {
+            if (!jump)
+                continue;
+            std::int32_t offset;
+            std::memcpy(&offset, jump, sizeof(offset));
+            const auto successor = blockByCode.find(jump + sizeof(offset) + offset);
+            if (successor != blockByCode.end())
+                successor->second->incomingJumps.push_back(jump);
+        }
+    }
+    return status::STATUS_OK;
+}
+
+jit_engine::block* jit_engine::translate(const std::uint32_t address, const guest_memory& memory)
+{
+    const std::uint8_t vectorBankOffset = cpuProperties.registersCount * sizeof(cpu_register_t);
+    const std::uint32_t lastWordAddress = cpuProperties.memorySize - sizeof(cpu_register_t);
+    const std::uint32_t registerSize = cpuProperties.registerSize;
+
+    // Collect instructions of the block first, so budget check knows block length
+    std::vector<decoded_instruction> body;
+    std::uint32_t endAddress = address;
+    while (body.size() < maxBlockInstructions && endAddress <= lastWordAddress) {
+        const decoded_instruction& operands = (*decodeTable)[memory.readWord(endAddress)];
+        bool isTranslatable = operands.op != operation::UNKNOWN && operands.op != operation::VECTOR_LOAD &&
+                              operands.op != operation::VECTOR_STORE;
+        if ((operands.op == operation::SRL_IMMEDIATE || operands.op == operation::SLL_IMMEDIATE) &&
+            operands.immediate > registerSize)
+            isTranslatable = false;
+        if (!isTranslatable)
+            break;
+        body.push_back(operands);
+        endAddress += sizeof(cpu_register_t);
+        if (instructions::isControlFlow(operands.op))
+            break;
+    }
+    if (body.empty())
+        return nullptr;
+
+    write_scope writable(*this);
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        x86_emitter emitter(codeBuffer + codeBufferUsed, codeBuffer + codeBufferSize);
+        const std::uint32_t blockIndex = blocks.size();
+        std::vector<side_exit> sideExits;
+        std::vector<std::uint32_t> blockRelocations;
+        const std::uint32_t length = body.size();
+
+        std::uint8_t* code = emitter.position();
+        emitter.bytes({ 0x49, 0x81, 0x7d, budgetOffset }); emitter.imm32(length); // cmp qword [r13 + budget], length
+        emitter.bytes({ 0x0f, 0x8c });                                            // jl budget exit
+        sideExits.push_back({ emitter.rel32(), address, 0 });
+        emitter.bytes({ 0x49, 0x81, 0x6d, budgetOffset }); emitter.imm32(length); // sub qword [r13 + budget], length
+
+        for (std::uint32_t i = 0; i < length; ++i) {
+            const decoded_instruction& operands = body[i];
+            const std::uint32_t pc = address + i * sizeof(cpu_register_t);
+            const std::uint8_t dst = operands.dstRegisterIndex * 2;
+            auto sideExit = [&](std::initializer_list<std::uint8_t> jcc) {
+                emitter.bytes(jcc);
+                sideExits.push_back({ emitter.rel32(), pc, i });
+            };
+            auto efficientAddress = [&](const std::uint32_t baseRegister) {
+                emitter.loadRegister(x86_emitter::eax, baseRegister);
+                if (operands.immediate & signBitMask) {
+                    emitter.bytes({ 0x66, 0x05 }); emitter.imm16(operands.immediate); // add ax, imm16
+                    emitter.bytes({ 0x0f, 0xb7, 0xc0 });                              // movzx eax, ax
+                }
+                else {
+                    emitter.bytes({ 0x05 }); emitter.imm32(operands.immediate);       // add eax, imm32
+                }
+                emitter.bytes({ 0x3d }); emitter.imm32(lastWordAddress);              // cmp eax, last address
+                sideExit({ 0x0f, 0x87 });                                             // ja
+            };
+            // rdx - page from table at r12 or r15, eax - offset in it
+            auto pageAddress = [&](const std::uint8_t tableBase) {
+                emitter.bytes({ 0x89, 0xc1 });                                        // mov ecx, eax
+                emitter.bytes({ 0xc1, 0xe9, (std::uint8_t)guest_memory::pageShift }); // shr ecx, page shift
+                emitter.bytes({ 0x49, 0x8b, 0x14, tableBase });                       // mov rdx, [table + 8 * rcx]
+                emitter.bytes({ 0x25 }); emitter.imm32(guest_memory::pageMask);       // and eax, page mask
+                emitter.bytes({ 0x3d }); emitter.imm32(guest_memory::pageSize - sizeof(cpu_register_t)); // cmp eax, last word offset
+                sideExit({ 0x0f, 0x87 });                                             // ja
+            };
+            // Flag setting operations work on eax = dst and ecx = right operand
+            // and leave their operands and result in lazy flags of context
+            auto loadOperands = [&]() {
+                const bool isImmediate = ((std::uint32_t)operands.op - (std::uint32_t)operation::ADD_REGISTER) % 2;
+                emitter.loadRegister(x86_emitter::eax, operands.dstRegisterIndex);
+                emitter.storeContextWord(x86_emitter::eax, flagsLeftOffset);
+                if (isImmediate) {
+                    emitter.storeContextWordImmediate(flagsRightOffset, operands.immediate);
+                    return;
+                }
+                emitter.loadRegister(x86_emitter::ecx, operands.srcRegisterIndex);
+                emitter.storeContextWord(x86_emitter::ecx, flagsRightOffset);
+            };
+            auto storeResult = [&]() {
+                emitter.storeRegister(x86_emitter::eax, operands.dstRegisterIndex);
+                emitter.storeContextWord(x86_emitter::eax, flagsResultOffset);
+                emitter.storeContextByte(flagsOpOffset, (std::uint8_t)operands.op);
+            };
+            constexpr std::uint8_t readPagesTable = 0xcc;                             // sib [r12 + 8 * rcx]
+            constexpr std::uint8_t writePagesTable = 0xcf;                            // sib [r15 + 8 * rcx]
+
+            switch (operands.op) {
+            case operation::LOAD:
+                efficientAddress(operands.srcRegisterIndex);
+                pageAddress(readPagesTable);
+                emitter.bytes({ 0x0f, 0xb7, 0x0c, 0x02 });                      // movzx ecx, word [rdx + rax]
+                emitter.storeRegister(x86_emitter::ecx, operands.dstRegisterIndex);
+                break;
+            case operation::STORE:
+                efficientAddress(operands.dstRegisterIndex);
+                for (std::uint8_t byte = 0; byte < sizeof(cpu_register_t); ++byte) {
+                    emitter.bytes({ 0x8d, 0x48, byte });                        // lea ecx, [rax + byte]
+                    emitter.bytes({ 0xc1, 0xe9, (std::uint8_t)codePageShift }); // shr ecx, page shift
+                    emitter.bytes({ 0x41, 0x80, 0x3c, 0x0e, 0x00 });            // cmp byte [r14 + rcx], 0
+                    sideExit({ 0x0f, 0x85 });                                   // jne
+                }
+                pageAddress(writePagesTable);
+                emitter.bytes({ 0x48, 0x85, 0xd2 });                            // test rdx, rdx
+                sideExit({ 0x0f, 0x84 });                                       // jz, page is shared
+                emitter.loadRegister(x86_emitter::ecx, operands.srcRegisterIndex);
+                emitter.bytes({ 0x66, 0x89, 0x0c, 0x02 });                      // mov word [rdx + rax], cx
+                break;
+            case operation::LOAD_IMMEDIATE_LOWER:
+                emitter.bytes({ 0xc6, 0x43, dst, (std::uint8_t)operands.immediate });       // mov byte [rbx + dst], imm8
+                break;
+            case operation::LOAD_IMMEDIATE_UPPER:
+                emitter.bytes({ 0xc6, 0x43, (std::uint8_t)(dst + 1), (std::uint8_t)operands.immediate });
+                break;
+            case operation::ADD_REGISTER:
+                loadOperands();
+                emitter.bytes({ 0x01, 0xc8 });                                  // add eax, ecx
+                storeResult();
+                break;
+            case operation::ADD_IMMEDIATE:
+                loadOperands();
+                emitter.bytes({ 0x05 }); emitter.imm32(operands.immediate);     // add eax, imm32
+                storeResult();
+                break;
+            case operation::SUB_REGISTER:
+                loadOperands();
+                emitter.bytes({ 0x29, 0xc8 });                                  // sub eax, ecx
+                storeResult();
+                break;
+            case operation::SUB_IMMEDIATE:
+                loadOperands();
+                emitter.bytes({ 0x2d }); emitter.imm32(operands.immediate);     // sub eax, imm32
+                storeResult();
+                break;
+            case operation::MUL_REGISTER:
+                loadOperands();
+                emitter.bytes({ 0x0f, 0xaf, 0xc1 });                            // imul eax, ecx
+                storeResult();
+                break;
+            case operation::MUL_IMMEDIATE:
+                loadOperands();
+                emitter.bytes({ 0x69, 0xc0 }); emitter.imm32(operands.immediate); // imul eax, eax, imm32
+                storeResult();
+                break;
+            case operation::SRL_IMMEDIATE:
+            case operation::SLL_IMMEDIATE:
+                loadOperands();
+                emitter.bytes({ 0xc1, (std::uint8_t)(operands.op == operation::SRL_IMMEDIATE ? 0xe8 : 0xe0),
+                                (std::uint8_t)operands.immediate });            // shr/shl eax, imm8
+                storeResult();
+                break;
+            case operation::SRL_REGISTER:
+            case operation::SLL_REGISTER:
+                emitter.loadRegister(x86_emitter::ecx, operands.srcRegisterIndex);
+                emitter.bytes({ 0x83, 0xf9, (std::uint8_t)registerSize });      // cmp ecx, register size
+                sideExit({ 0x0f, 0x87 });                                       // ja
+                loadOperands();
+                emitter.bytes({ 0xd3, (std::uint8_t)(operands.op == operation::SRL_REGISTER ? 0xe8 : 0xe0) }); // shr/shl eax, cl
+                storeResult();
+                break;
+            case operation::NOT:
+                emitter.bytes({ 0x66, 0xf7, 0x53, dst });                       // not word [rbx + dst]
+                break;
+            case operation::AND:
+                emitter.loadRegister(x86_emitter::eax, operands.srcRegisterIndex);
+                emitter.bytes({ 0x66, 0x21, 0x43, dst });                       // and word [rbx + dst], ax
+                break;
+            case operation::OR:
+                emitter.loadRegister(x86_emitter::eax, operands.srcRegisterIndex);
+                emitter.bytes({ 0x66, 0x09, 0x43, dst });                       // or word [rbx + dst], ax
+                break;
+            case operation::XOR:
+                emitter.loadRegister(x86_emitter::eax, operands.srcRegisterIndex);
+                emitter.bytes({ 0x66, 0x31, 0x43, dst });                       // xor word [rbx + dst], ax
+                break;
+            case operation::VECTOR_ADD:
+            case operation::VECTOR_SUB:
+            case operation::VECTOR_AND:
+            case operation::VECTOR_OR:
+            case operation::VECTOR_XOR:
+            case operation::VECTOR_COMPARE_EQUAL: {
+                const std::uint8_t dstVector = vectorBankOffset + operands.dstRegisterIndex * instructions::vectorSize;
+                const std::uint8_t srcVector = vectorBankOffset + operands.srcRegisterIndex * instructions::vectorSize;
+                emitter.bytes({ 0xf3, 0x0f, 0x6f, 0x43, dstVector });           // movdqu xmm0, [rbx + dst]
+                emitter.bytes({ 0xf3, 0x0f, 0x6f, 0x4b, srcVector });           // movdqu xmm1, [rbx + src]
+                emitter.bytes({ 0x66, 0x0f, vectorOpcode(operands.op), 0xc1 }); // paddb/psubb/pand/por/pxor/pcmpeqb xmm0, xmm1
+                emitter.bytes({ 0xf3, 0x0f, 0x7f, 0x43, dstVector });           // movdqu [rbx + dst], xmm0
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        // Block end, jump targets are patched when successors are chained
+        const decoded_instruction& last = body.back();
+        const std::uint32_t lastPc = endAddress - sizeof(cpu_register_t);
+        std::uint8_t* chainJumps[2] = { nullptr, nullptr };
+        std::uint32_t chainTargets[2] = { endAddress, 0 };
+        auto chainExit = [&](const std::uint32_t exit, const std::uint32_t target) {
+            emitter.storeContext(exitAddressOffset, target);
+            emitter.storeContext(exitReasonOffset, (std::uint32_t)jit_exit_reason::CHAIN);
+            emitter.storeContext(exitBlockOffset, blockIndex);
+            emitter.bytes({ 0xe9 });
+            chainJumps[exit] = emitter.rel32();
+            chainTargets[exit] = target;
+            if (!emitter.isOverflowed())
+                x86_emitter::patchRel32(chainJumps[exit], exitTrampoline);
+        };
+        switch (last.op) {
+        case operation::JUMP:
+        case operation::CALL_IMMEDIATE:
+            if (last.op == operation::CALL_IMMEDIATE) {
+                emitter.bytes({ 0x66, 0xc7, 0x43, (std::uint8_t)(last.dstRegisterIndex * 2) });
+                emitter.imm16(endAddress);                                      // mov word [rbx + dst], return address
+            }
+            chainExit(0, (cpu_register_t)(lastPc + last.immediate));
+            break;
+        case operation::BRANCH_IF_SET:
+        case operation::BRANCH_IF_CLEAR: {
+            const cpu_register_t flag = 0x1 << last.srcRegisterIndex;
+            const bool isSet = last.op == operation::BRANCH_IF_SET;
+            bool hasResult = false; // flags are set by this block, so zero and negative come from result
+            for (std::uint32_t i = 0; i + 1 < length; ++i)
+                hasResult |= instructions::lazy_flags::isFlagSetting(body[i].op);
+            std::uint8_t condition;
+            if (hasResult && flag == instructions::ZERO_FLAG) {
+                emitter.bytes({ 0x66, 0x41, 0x83, 0x7d, flagsResultOffset, 0x00 });    // cmp word [r13 + result], 0
+                condition = isSet ? 0x84 : 0x85;                                        // je/jne
+            }
+            else if (hasResult && flag == instructions::NEGATIVE_FLAG) {
+                emitter.bytes({ 0x41, 0xf6, 0x45, (std::uint8_t)(flagsResultOffset + 1), 0x80 }); // test byte [r13 + result + 1], 0x80
+                condition = isSet ? 0x85 : 0x84;                                        // jnz/jz
+            }
+            else {
+                emitter.bytes({ 0x49, 0x8d, 0x7d, flagsOffset });                     // lea rdi, [r13 + flags]
+                emitter.bytes({ 0x48, 0xb8 });                                          // mov rax, imm64
+                blockRelocations.push_back(emitter.position() - codeBuffer);
+                emitter.imm64(reinterpret_cast<std::uint64_t>(&getStatusFlags));
+                emitter.bytes({ 0xff, 0xd0 });                                          // call rax
+                emitter.bytes({ 0xa9 }); emitter.imm32(flag);                           // test eax, flag
+                condition = isSet ? 0x85 : 0x84;                                        // jnz/jz
+            }
+            emitter.bytes({ 0x0f, condition });
+            std::uint8_t* takenJump = emitter.rel32();
+            chainExit(1, endAddress);
+            if (!emitter.isOverflowed())
+                x86_emitter::patchRel32(takenJump, emitter.position());
+            chainExit(0, (cpu_register_t)(lastPc + last.immediate));
+            break;
+        }
+        case operation::CALL_REGISTER:
+        case operation::RETURN: {
+            emitter.loadRegister(x86_emitter::eax, last.srcRegisterIndex);
+            if (last.op == operation::CALL_REGISTER) {
+                emitter.bytes({ 0x66, 0xc7, 0x43, (std::uint8_t)(last.dstRegisterIndex * 2) });
+                emitter.imm16(endAddress);                                      // mov word [rbx + dst], return address
+            }
+            emitter.bytes({ 0x41, 0x89, 0x45, exitAddressOffset });             // mov dword [r13 + exit address], eax
+            emitter.storeContext(exitReasonOffset, (std::uint32_t)jit_exit_reason::CHAIN);
+            emitter.storeContext(exitBlockOffset, blockIndex);
+            emitter.bytes({ 0xe9 });
+            std::uint8_t* exitJump = emitter.rel32();
+            if (!emitter.isOverflowed())
+                x86_emitter::patchRel32(exitJump, exitTrampoline);
+            break;
+        }
+        default:
+            chainExit(0, endAddress);
+            break;
+        }
+
+        // Cold side exits
+        for (std::size_t i = 0; i < sideExits.size(); ++i) {
+            const side_exit& exit = sideExits[i];
+            std::uint8_t* target = emitter.position();
+            if (i == 0)
+                emitter.exitBlock(0, exit.address, jit_exit_reason::BUDGET, blockIndex, exitTrampoline);
+            else
+                emitter.exitBlock(length - exit.executedInstructions, exit.address, jit_exit_reason::SIDE_EXIT,
+                                  blockIndex, exitTrampoline);
+            if (!emitter.isOverflowed())
+                x86_emitter::patchRel32(exit.jump, target);
+        }
+
+        if (emitter.isOverflowed()) {
+            // Code buffer is full, start from scratch once
+            if (attempt)
+                return nullptr;
+            flush();
+            continue;
+        }
+
+        codeBufferUsed += emitter.size();
+        relocations.insert(relocations.end(), blockRelocations.begin(), blockRelocations.end());
+        blocks.emplace_back(new block{ address, endAddress, code, { chainJumps[0], chainJumps[1] },
+                                       { chainTargets[0], chainTargets[1] }, {}, true });
+        block* codeBlock = blocks.back().get();
+        blockByAddress[address] = codeBlock;
+        for (std::uint32_t page = address >> codePageShift; page <= (endAddress - 1) >> codePageShift; ++page) {
+            pageBlocks[page].push_back(blockIndex);
+            codePages[page] = 1;
+        }
+        return codeBlock;
+    }
+
+    return nullptr;
+}
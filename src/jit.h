@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+#include "base.h"
+#include "instructions.h"
+#include "flags.h"
+#include "decode_table.h"
+#include "guest_memory.h"
+
+enum class jit_exit_reason : std::uint32_t {
+    CHAIN = 0,   // block finished, execution continues from exitAddress
+    BUDGET,      // not enough instructions budget to enter block at exitAddress
+    SIDE_EXIT    // instruction at exitAddress has to be executed by interpreter
+};
+
+// State shared between dispatcher and generated code, offsets of fields are
+// used by generated code directly.
+struct jit_context {
+    cpu_register_t* registers;
+    const std::uint8_t* const* readPages; // page tables of guest_memory
+    const std::uint8_t* codePages;
+    std::uint8_t* const* writePages;
+    std::int64_t budget;
+    std::uint32_t exitAddress;
+    jit_exit_reason exitReason;
+    std::uint32_t exitBlock;
+    instructions::lazy_flags flags; // generated code records flag setting operations here
+};
+
+// Translates basic blocks of guest code to x86-64 host code. Blocks are
+// straight runs of translatable instructions ended by control flow
+// instruction at most. Exits with known target, the next instruction, jump,
+// call or both ways of branch, jump either to the dispatcher or, after
+// chaining, directly to the successor block. Indirect exits of register
+// call and return always go through the dispatcher. Packed vector
+// operations are translated to SSE2 on registers in the guest register file.
+// Instructions which can not be translated (vector loads and stores) or hit
+// an edge case at runtime (memory bounds, words crossing pages, stores into
+// shared pages or translated code, wrong shift amount) are left to
+// interpreter.
+class jit_engine {
+public:
+    struct block {
+        std::uint32_t startAddress;
+        std::uint32_t endAddress; // address after last translated instruction
+        std::uint8_t* code;
+        // rel32 operands of jumps to successors and their addresses, nullptr if unused
+        std::uint8_t* chainJumps[2];
+        std::uint32_t chainTargets[2];
+        std::vector<std::uint8_t*> incomingJumps;
+        bool isValid;
+    };
+
+    jit_engine(const cpu_base_properties& _cpuProperties, std::shared_ptr<const instructions::decode_table> _decodeTable);
+    ~jit_engine();
+
+    static bool isSupported();
+    // Hash of emitterVersion, cache format version and compiler, so
+    // translations made by other emitter are never loaded
+    static std::uint64_t getBuildFingerprint();
+
+    // Returns nullptr if first instruction at address can not be translated
+    block* getBlock(const std::uint32_t address, const guest_memory& memory);
+    void execute(const block* const codeBlock, jit_context& context) const;
+    // Patches every exit of fromBlock with address of toBlock
+    void chain(const std::uint32_t fromBlock, block* const toBlock);
+
+    inline bool isCodeAddress(const std::uint32_t address) const
+    {
+        return codePages[address >> codePageShift] || codePages[(address + 1) >> codePageShift];
+    }
+    void invalidate(const std::uint32_t address, const std::uint32_t size);
+    void flush();
+
+    // Translations are saved with hash of guest code of valid blocks. Load
+    // replaces current translations only if file is intact and made for the
+    // same code in memory, otherwise FILE_FORMAT_ERROR, FILE_CHECKSUM_ERROR
+    // or FILE_STALE_ERROR is returned and translations are kept. Loaded code
+    // is executed, so file which is not owned by current user or is writable
+    // by group or others fails with FILE_ACCESS_ERROR.
+    status save(const std::string& path, const guest_memory& memory) const;
+    status load(const std::string& path, const guest_memory& memory);
+
+    inline const std::uint8_t* getCodePages() const { return codePages.get(); }
+
+    // Bumped with every change of generated code or of its use of jit_context
+    static constexpr std::uint32_t emitterVersion = 1;
+    static constexpr std::uint32_t codePageShift = 8;
+    static constexpr std::uint32_t maxBlockInstructions = 64;
+    static constexpr std::size_t codeBufferSize = 8 * 1024 * 1024;
+private:
+    // Code buffer is mapped read and execute (W^X), scope makes it writable
+    // while code is emitted or patched. Nested scopes keep it writable until
+    // the outermost one ends.
+    class write_scope {
+    public:
+        explicit write_scope(jit_engine& _engine);
+        ~write_scope();
+    private:
+        jit_engine& engine;
+    };
+
+    block* translate(const std::uint32_t address, const guest_memory& memory);
+    void emitTrampolines();
+    std::uint64_t getCodeHash(const std::vector<std::pair<std::uint32_t, std::uint32_t>>& ranges,
+                              const guest_memory& memory) const;
+
+    const cpu_base_properties& cpuProperties;
+    const std::shared_ptr<const instructions::decode_table> decodeTable;
+
+    std::uint8_t* codeBuffer;
+    std::size_t codeBufferUsed;
+    std::uint8_t* enterTrampoline;
+    std::uint8_t* exitTrampoline;
+    std::uint32_t writeScopes;
+
+    std::vector<std::unique_ptr<block>> blocks;
+    std::vector<std::uint32_t> relocations; // offsets of getStatusFlags addresses in code buffer
+    const std::unique_ptr<block*[]> blockByAddress;
+    const std::unique_ptr<std::uint8_t[]> codePages; // non-zero if page holds translated instructions
+    const std::unique_ptr<std::vector<std::uint32_t>[]> pageBlocks;
+};
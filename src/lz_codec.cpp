@@ -0,0 +1,149 @@
+#include <cstring>
+#include <algorithm>
+
+#include "lz_codec.h"
+
+namespace lz_codec {
+
+namespace {
+
+constexpr std::uint32_t hashBits = 12; // table fits L1 cache
+constexpr std::size_t lastLiterals = 5; // last bytes are always literals, as in LZ4
+constexpr std::uint32_t skipShift = 5; // step grows by one after every 32 misses
+
+inline std::uint32_t read32(const std::uint8_t* const data)
+{
+    std::uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+inline std::uint32_t hash(const std::uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - hashBits);
+}
+
+inline void writeLength(std::size_t length, std::uint8_t*& output)
+{
+    for (; length >= 255; length -= 255)
+        *output++ = 255;
+    *output++ = (std::uint8_t)length;
+}
+
+void writeSequence(const std::uint8_t* const literals, const std::size_t literalsCount, const std::size_t offset,
+                   const std::size_t matchLength, std::uint8_t*& output)
+{
+    const std::size_t matchCode = matchLength ? matchLength - minMatch : 0;
+    *output++ = (std::uint8_t)((std::min<std::size_t>(literalsCount, 15) << 4) | std::min<std::size_t>(matchCode, 15));
+    if (literalsCount >= 15)
+        writeLength(literalsCount - 15, output);
+    std::memcpy(output, literals, literalsCount);
+    output += literalsCount;
+    if (!matchLength)
+        return;
+    *output++ = (std::uint8_t)offset;
+    *output++ = (std::uint8_t)(offset >> 8);
+    if (matchCode >= 15)
+        writeLength(matchCode - 15, output);
+}
+
+// Returns false if length runs out of input
+inline bool readLength(const std::uint8_t*& position, const std::uint8_t* const end, std::size_t& length)
+{
+    std::uint8_t byte;
+    do {
+        if (position == end)
+            return false;
+        byte = *position++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+}
+
+void compress(const std::uint8_t* const data, const std::size_t size, std::vector<std::uint8_t>& output)
+{
+    // Incompressible data grows by a length byte per 255 literals
+    const std::size_t outputStart = output.size();
+    output.resize(outputStart + size + size / 255 + 16);
+    std::uint8_t* out = output.data() + outputStart;
+
+    std::vector<std::uint32_t> table(1 << hashBits, 0); // position + 1, 0 is empty
+    std::size_t anchor = 0;
+    std::size_t position = 0;
+    const std::size_t matchLimit = size > lastLiterals ? size - lastLiterals : 0;
+    while (position + minMatch <= matchLimit) {
+        const std::uint32_t value = read32(data + position);
+        std::uint32_t& slot = table[hash(value)];
+        const std::size_t candidate = slot;
+        slot = position + 1;
+        if (!candidate || position + 1 - candidate > maxOffset || read32(data + candidate - 1) != value) {
+            // Incompressible data is skipped faster
+            position += (position - anchor) >> skipShift | 1;
+            continue;
+        }
+
+        const std::size_t matchStart = candidate - 1;
+        std::size_t length = minMatch;
+        while (position + length + sizeof(std::uint64_t) <= matchLimit) {
+            std::uint64_t current, previous;
+            std::memcpy(&current, data + position + length, sizeof(current));
+            std::memcpy(&previous, data + matchStart + length, sizeof(previous));
+            if (current != previous)
+                break;
+            length += sizeof(current);
+        }
+        while (position + length < matchLimit && data[matchStart + length] == data[position + length])
+            ++length;
+        writeSequence(data + anchor, position - anchor, position - matchStart, length, out);
+        position += length;
+        anchor = position;
+    }
+    writeSequence(data + anchor, size - anchor, 0, 0, out);
+    output.resize(out - output.data());
+}
+
+bool decompress(const std::uint8_t* const data, const std::size_t compressedSize, std::uint8_t* const output,
+                const std::size_t size)
+{
+    const std::uint8_t* position = data;
+    const std::uint8_t* const end = data + compressedSize;
+    std::size_t written = 0;
+    while (position < end) {
+        const std::uint8_t token = *position++;
+        std::size_t literalsCount = token >> 4;
+        if (literalsCount == 15 && !readLength(position, end, literalsCount))
+            return false;
+        if (literalsCount > (std::size_t)(end - position) || literalsCount > size - written)
+            return false;
+        std::memcpy(output + written, position, literalsCount);
+        position += literalsCount;
+        written += literalsCount;
+        if (position == end)
+            break;
+
+        if (end - position < 2)
+            return false;
+        const std::size_t offset = position[0] | (position[1] << 8);
+        position += 2;
+        std::size_t length = (token & 15) + minMatch;
+        if ((token & 15) == 15 && !readLength(position, end, length))
+            return false;
+        if (!offset || offset > written || length > size - written)
+            return false;
+        const std::uint8_t* source = output + written - offset;
+        if (offset >= length) {
+            std::memcpy(output + written, source, length);
+        }
+        else {
+            // Overlapping copy repeats the last offset bytes
+            for (std::size_t index = 0; index < length; ++index)
+                output[written + index] = source[index];
+        }
+        written += length;
+    }
+    return written == size;
+}
+
+}
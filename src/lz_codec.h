@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Byte oriented LZ77 codec in the spirit of LZ4. Stream is a sequence of
+// tokens: high nibble is literals count, low nibble is match length minus
+// minMatch, value 15 in a nibble is continued by bytes which are added
+// until one is less than 255. Token is followed by literals, 16-bit little
+// endian match offset and match length continuation. The last token has
+// only literals. Compression uses single probe hash table, so it is fast
+// and gives up some ratio.
+namespace lz_codec {
+
+constexpr std::size_t minMatch = 4;
+constexpr std::size_t maxOffset = 0xffff;
+
+// Appends compressed data to output
+void compress(const std::uint8_t* const data, const std::size_t size, std::vector<std::uint8_t>& output);
+// Returns false if stream is corrupted or does not decode to exactly size bytes
+bool decompress(const std::uint8_t* const data, const std::size_t compressedSize, std::uint8_t* const output,
+                const std::size_t size);
+
+}
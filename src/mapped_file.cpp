@@ -0,0 +1,68 @@
+#include <new>
+#include <fstream>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define MAPPED_FILE_MMAP
+#endif
+
+#include "mapped_file.h"
+
+namespace {
+
+constexpr std::size_t bufferAlignment = 4096;
+
+}
+
+mapped_file::mapped_file(std::uint8_t* const _begin, const std::size_t _length, const bool _mapped) :
+    begin(_begin), length(_length), mapped(_mapped) {}
+
+mapped_file::~mapped_file()
+{
+#ifdef MAPPED_FILE_MMAP
+    if (mapped) {
+        munmap(begin, length);
+        return;
+    }
+#endif
+    operator delete[](begin, std::align_val_t(bufferAlignment));
+}
+
+std::shared_ptr<mapped_file> mapped_file::open(const std::string& path, const bool isPrivate)
+{
+#ifdef MAPPED_FILE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat info;
+    // Checked on opened file, so it can not be replaced after the check
+    if (fstat(fd, &info) || info.st_size <= 0 ||
+        (isPrivate && (!S_ISREG(info.st_mode) || info.st_uid != geteuid() || (info.st_mode & (S_IWGRP | S_IWOTH))))) {
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data != MAP_FAILED)
+        return std::shared_ptr<mapped_file>(new mapped_file(static_cast<std::uint8_t*>(data), info.st_size, true));
+    // Reading by path again could get other file than the checked one
+    if (isPrivate)
+        return nullptr;
+#endif
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return nullptr;
+    std::streamoff size = file.tellg();
+    if (size <= 0)
+        return nullptr;
+    std::uint8_t* buffer = static_cast<std::uint8_t*>(operator new[](size, std::align_val_t(bufferAlignment)));
+    std::shared_ptr<mapped_file> result(new mapped_file(buffer, size, false));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(buffer), size))
+        return nullptr;
+    return result;
+}
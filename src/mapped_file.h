@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Whole read-only file in memory. On unix file is mapped, so pages are read
+// on demand and shared with page cache, on other hosts it is read into page
+// aligned buffer.
+class mapped_file {
+public:
+    // Returns nullptr if file can not be opened or is empty. Private file has
+    // to be regular file owned by current user and not writable by group or
+    // others, it is checked only on unix hosts.
+    static std::shared_ptr<mapped_file> open(const std::string& path, const bool isPrivate = false);
+    ~mapped_file();
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    inline const std::uint8_t* data() const { return begin; }
+    inline std::size_t size() const { return length; }
+    inline bool isMapped() const { return mapped; }
+private:
+    mapped_file(std::uint8_t* const _begin, const std::size_t _length, const bool _mapped);
+
+    std::uint8_t* const begin;
+    const std::size_t length;
+    const bool mapped;
+};
@@ -0,0 +1,110 @@
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#define PERF_COUNTERS_LINUX
+#endif
+
+#include "perf_counters.h"
+
+namespace {
+
+#ifdef PERF_COUNTERS_LINUX
+
+struct event_config {
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+constexpr event_config eventConfigs[perfEventsCount] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+};
+
+int openEvent(const event_config& event)
+{
+    perf_event_attr attributes = {};
+    attributes.size = sizeof(attributes);
+    attributes.type = event.type;
+    attributes.config = event.config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1; // allowed with default perf_event_paranoid
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+}
+
+#endif
+
+}
+
+perf_counters::perf_counters() : openedCount(0)
+{
+    descriptors.fill(-1);
+#ifdef PERF_COUNTERS_LINUX
+    for (std::uint32_t event = 0; event < perfEventsCount; ++event) {
+        descriptors[event] = openEvent(eventConfigs[event]);
+        if (descriptors[event] >= 0)
+            ++openedCount;
+    }
+#endif
+}
+
+perf_counters::~perf_counters()
+{
+#ifdef PERF_COUNTERS_LINUX
+    for (int descriptor : descriptors)
+        if (descriptor >= 0)
+            close(descriptor);
+#endif
+}
+
+void perf_counters::start()
+{
+#ifdef PERF_COUNTERS_LINUX
+    for (int descriptor : descriptors) {
+        if (descriptor < 0)
+            continue;
+        ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+        ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+perf_sample perf_counters::stop()
+{
+    perf_sample sample;
+    sample.values.fill(0);
+    sample.isValid.fill(false);
+#ifdef PERF_COUNTERS_LINUX
+    for (int descriptor : descriptors)
+        if (descriptor >= 0)
+            ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+    for (std::uint32_t event = 0; event < perfEventsCount; ++event) {
+        std::uint64_t data[3]; // value, time enabled, time running
+        if (descriptors[event] < 0 || read(descriptors[event], data, sizeof(data)) != sizeof(data) || !data[2])
+            continue;
+        sample.values[event] = data[2] < data[1] ? (std::uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+        sample.isValid[event] = true;
+    }
+#endif
+    return sample;
+}
+
+const char* perf_counters::getEventName(const perf_event event)
+{
+    switch (event) {
+    case perf_event::CYCLES: return "cycles";
+    case perf_event::INSTRUCTIONS: return "instructions";
+    case perf_event::BRANCH_MISSES: return "branch_misses";
+    case perf_event::L1D_READ_MISSES: return "l1d_read_misses";
+    case perf_event::LLC_MISSES: return "llc_misses";
+    case perf_event::COUNT: break;
+    }
+    return "unknown";
+}
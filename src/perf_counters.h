@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Host hardware counters of the calling thread, user space only. On linux
+// they are opened with perf_event_open, every event separately, so missing
+// events do not disable others. Without kernel support or permissions
+// isAvailable() is false and samples have no valid values.
+enum class perf_event : std::uint32_t {
+    CYCLES = 0,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    L1D_READ_MISSES,
+    LLC_MISSES,
+    COUNT
+};
+
+constexpr std::uint32_t perfEventsCount = (std::uint32_t)perf_event::COUNT;
+
+struct perf_sample {
+    std::array<std::uint64_t, perfEventsCount> values; // scaled if counter was multiplexed
+    std::array<bool, perfEventsCount> isValid;
+
+    inline bool has(const perf_event event) const { return isValid[(std::uint32_t)event]; }
+    inline std::uint64_t get(const perf_event event) const { return values[(std::uint32_t)event]; }
+};
+
+class perf_counters {
+public:
+    perf_counters();
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+    ~perf_counters();
+
+    inline bool isAvailable() const { return openedCount != 0; }
+    inline bool isCounted(const perf_event event) const { return descriptors[(std::uint32_t)event] >= 0; }
+
+    // Resets and enables every opened counter
+    void start();
+    // Disables counters and returns their values since start
+    perf_sample stop();
+
+    static const char* getEventName(const perf_event event);
+private:
+    std::array<int, perfEventsCount> descriptors;
+    std::uint32_t openedCount;
+};
+
+template <typename Body>
+perf_sample measureCounters(perf_counters& counters, Body body)
+{
+    counters.start();
+    body();
+    return counters.stop();
+}
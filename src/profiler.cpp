@@ -0,0 +1,98 @@
+#include <utility>
+#include <algorithm>
+
+#include "profiler.h"
+
+opcode_profiler::opcode_profiler() : operationCounts{}, addressCounts(maxSupportedMemory) {}
+
+void opcode_profiler::reset()
+{
+    operationCounts.fill(0);
+    std::fill(addressCounts.begin(), addressCounts.end(), 0);
+    statusCounts.clear();
+}
+
+const char* opcode_profiler::getOperationName(const instructions::operation op)
+{
+    static const char* const names[operationsCount] = {
+        "unknown", "ld", "st", "ldil", "ldiu", "add", "addi", "sub", "subi", "mul", "muli",
+        "srl", "srli", "sll", "slli", "not", "and", "or", "xor", "jmp", "brs", "brc", "call", "calli", "ret",
+        "vadd", "vsub", "vand", "vor", "vxor", "vcmpeq", "vld", "vst"
+    };
+    return (std::uint32_t)op < operationsCount ? names[(std::uint32_t)op] : "unknown";
+}
+
+std::uint64_t opcode_profiler::getRetiredInstructions() const
+{
+    std::uint64_t retired = 0;
+    for (std::uint64_t count : operationCounts)
+        retired += count;
+    return retired;
+}
+
+std::uint64_t opcode_profiler::getStatusCount(const status st) const
+{
+    auto found = statusCounts.find(st);
+    return found == statusCounts.end() ? 0 : found->second;
+}
+
+void opcode_profiler::report(std::ostream& out, const report_format format, const std::size_t maxAddresses) const
+{
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> hotAddresses;
+    for (std::uint32_t address = 0; address < addressCounts.size(); ++address)
+        if (addressCounts[address])
+            hotAddresses.emplace_back(addressCounts[address], address);
+    const std::size_t addressesCount = std::min(maxAddresses, hotAddresses.size());
+    std::partial_sort(hotAddresses.begin(), hotAddresses.begin() + addressesCount, hotAddresses.end(),
+                      [](const auto& left, const auto& right) {
+                          return left.first > right.first || (left.first == right.first && left.second < right.second);
+                      });
+    hotAddresses.resize(addressesCount);
+
+    const bool isJson = format == report_format::JSON;
+    const char* separator = "";
+    if (isJson)
+        out << "{\n  \"retired\": " << getRetiredInstructions() << ",\n  \"loads\": " << getLoadsCount()
+            << ",\n  \"stores\": " << getStoresCount() << ",\n  \"operations\": {";
+    else
+        out << "retired " << getRetiredInstructions() << "\nloads " << getLoadsCount()
+            << "\nstores " << getStoresCount() << "\noperations:\n";
+    for (std::uint32_t op = 0; op < operationsCount; ++op) {
+        if (!operationCounts[op])
+            continue;
+        const char* name = getOperationName((instructions::operation)op);
+        if (isJson)
+            out << separator << "\n    \"" << name << "\": " << operationCounts[op];
+        else
+            out << "  " << name << ' ' << operationCounts[op] << '\n';
+        separator = ",";
+    }
+
+    separator = "";
+    if (isJson)
+        out << "\n  },\n  \"statuses\": {";
+    else
+        out << "statuses:\n";
+    for (const auto& [st, count] : statusCounts) {
+        if (isJson)
+            out << separator << "\n    \"" << getStatusName(st) << "\": " << count;
+        else
+            out << "  " << getStatusName(st) << ' ' << count << '\n';
+        separator = ",";
+    }
+
+    separator = "";
+    if (isJson)
+        out << "\n  },\n  \"hot_addresses\": [";
+    else
+        out << "hot addresses:\n";
+    for (const auto& [count, address] : hotAddresses) {
+        if (isJson)
+            out << separator << "\n    { \"address\": " << address << ", \"count\": " << count << " }";
+        else
+            out << "  0x" << std::hex << address << std::dec << ' ' << count << '\n';
+        separator = ",";
+    }
+    if (isJson)
+        out << "\n  ]\n}\n";
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <map>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+
+#include "base.h"
+#include "instructions.h"
+#include "flags.h"
+
+// Profiling policies of basic_cpu. Interpreter calls onBeforeExecute before
+// every instruction changes state and onExecute after it, with status it
+// ended with. Policy with isEnabled false keeps cpu on its fastest path:
+// calls are empty and inlined away, JIT tier stays available. Policy with
+// isReversible keeps history for basic_cpu::stepBack, see undo_log.h.
+
+class guest_memory;
+
+constexpr std::uint32_t noMemoryAccess = 0xffffffff;
+
+struct execution_event {
+    std::uint32_t address;
+    cpu_register_t instruction;
+    const instructions::decoded_instruction& operands;
+    std::uint32_t memoryAddress;     // effective address of load or store, otherwise noMemoryAccess
+    const cpu_register_t* registers; // after execution
+    status st;
+};
+
+struct no_profiler {
+    static constexpr bool isEnabled = false;
+    static constexpr bool isReversible = false;
+
+    inline void onBeforeExecute(const std::uint32_t, const instructions::decoded_instruction&, const cpu_register_t*,
+                                const instructions::lazy_flags&, const guest_memory&) {}
+    inline void onExecute(const execution_event&) {}
+};
+
+enum class report_format : std::int32_t {
+    TEXT = 0,
+    JSON
+};
+
+// Counts retired instructions per operation and per guest address, loads,
+// stores and every not ok status. Profiled cpu always runs in interpreter.
+class opcode_profiler {
+public:
+    static constexpr bool isEnabled = true;
+    static constexpr bool isReversible = false;
+    static constexpr std::uint32_t operationsCount = instructions::operationsCount;
+
+    opcode_profiler();
+
+    inline void onBeforeExecute(const std::uint32_t, const instructions::decoded_instruction&, const cpu_register_t*,
+                                const instructions::lazy_flags&, const guest_memory&) {}
+    inline void onExecute(const execution_event& event)
+    {
+        if (event.st != status::STATUS_OK) {
+            ++statusCounts[event.st];
+            if (event.st < status::UNKNOWN_WARNING)
+                return;
+        }
+        ++operationCounts[(std::uint32_t)event.operands.op];
+        ++addressCounts[event.address];
+    }
+
+    void reset();
+    // Operations and statuses which never happened are skipped, addresses
+    // are sorted by count and limited to maxAddresses
+    void report(std::ostream& out, const report_format format, const std::size_t maxAddresses = 32) const;
+
+    static const char* getOperationName(const instructions::operation op);
+
+    std::uint64_t getRetiredInstructions() const;
+    inline std::uint64_t getOperationCount(const instructions::operation op) const { return operationCounts[(std::uint32_t)op]; }
+    inline std::uint64_t getAddressCount(const std::uint32_t address) const { return addressCounts[address]; }
+    inline std::uint64_t getLoadsCount() const { return getOperationCount(instructions::operation::LOAD); }
+    inline std::uint64_t getStoresCount() const { return getOperationCount(instructions::operation::STORE); }
+    std::uint64_t getStatusCount(const status st) const;
+private:
+    std::array<std::uint64_t, operationsCount> operationCounts;
+    std::vector<std::uint64_t> addressCounts; // one counter per byte of memory
+    std::map<status, std::uint64_t> statusCounts; // only rare statuses get here
+};
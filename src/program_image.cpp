@@ -0,0 +1,135 @@
+#include <memory>
+#include <fstream>
+#include <algorithm>
+
+#include "program_image.h"
+#include "mapped_file.h"
+
+namespace program_image {
+
+std::uint32_t checksum(const std::uint8_t* const data, const std::size_t size, const std::uint32_t initial)
+{
+    // Largest block for which sums do not overflow before modulo
+    constexpr std::size_t blockSize = 5552;
+    constexpr std::uint32_t modulo = 65521;
+
+    std::uint32_t a = initial & 0xffff;
+    std::uint32_t b = initial >> 16;
+    std::size_t offset = 0;
+    while (offset < size) {
+        const std::size_t end = std::min(size, offset + blockSize);
+        for (; offset < end; ++offset) {
+            a += data[offset];
+            b += a;
+        }
+        a %= modulo;
+        b %= modulo;
+    }
+    return (b << 16) | a;
+}
+
+status save(const std::string& path, const std::uint32_t entry, const std::vector<segment>& segments)
+{
+    std::vector<image_segment> table(segments.size());
+    std::uint32_t offset = sizeof(image_header) + segments.size() * sizeof(image_segment);
+    for (std::size_t index = 0; index < segments.size(); ++index) {
+        const segment& source = segments[index];
+        // Same page offset as load address, so whole pages can be mapped
+        offset += (source.loadAddress - offset) & guest_memory::pageMask;
+        table[index].fileOffset = offset;
+        table[index].fileSize = source.size;
+        table[index].loadAddress = source.loadAddress;
+        table[index].memorySize = std::max(source.memorySize, source.size);
+        table[index].checksum = checksum(static_cast<const std::uint8_t*>(source.data), source.size);
+        offset += source.size;
+    }
+
+    image_header header = {};
+    std::memcpy(header.magic, magicValue, sizeof(header.magic));
+    header.version = currentVersion;
+    header.entry = entry;
+    header.segmentsCount = segments.size();
+    header.tableChecksum = checksum(reinterpret_cast<const std::uint8_t*>(table.data()),
+                                    table.size() * sizeof(image_segment));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(image_segment));
+    for (std::size_t index = 0; index < segments.size(); ++index) {
+        const std::streamoff padding = table[index].fileOffset - file.tellp();
+        for (std::streamoff byte = 0; byte < padding; ++byte)
+            file.put(0);
+        file.write(static_cast<const char*>(segments[index].data), segments[index].size);
+    }
+    file.close();
+    return file ? status::STATUS_OK : status::FILE_ACCESS_ERROR;
+}
+
+status load(const std::string& path, guest_memory& memory, std::uint32_t& entry)
+{
+    std::shared_ptr<mapped_file> file = mapped_file::open(path);
+    if (!file)
+        return status::FILE_ACCESS_ERROR;
+
+    image_header header;
+    if (file->size() < sizeof(header))
+        return status::FILE_FORMAT_ERROR;
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (std::memcmp(header.magic, magicValue, sizeof(header.magic)) || header.version != currentVersion ||
+        sizeof(header) + (std::uint64_t)header.segmentsCount * sizeof(image_segment) > file->size())
+        return status::FILE_FORMAT_ERROR;
+
+    const std::uint8_t* const tableData = file->data() + sizeof(header);
+    const std::size_t tableSize = header.segmentsCount * sizeof(image_segment);
+    if (checksum(tableData, tableSize) != header.tableChecksum)
+        return status::FILE_CHECKSUM_ERROR;
+    std::vector<image_segment> table(header.segmentsCount);
+    std::memcpy(table.data(), tableData, tableSize);
+
+    // Memory is not touched until whole image is known to be valid. Data is
+    // read once here, mapped pages are not read again while loading.
+    for (const image_segment& current : table) {
+        if ((std::uint64_t)current.fileOffset + current.fileSize > file->size() ||
+            current.fileSize > current.memorySize ||
+            (std::uint64_t)current.loadAddress + current.memorySize > maxSupportedMemory)
+            return status::FILE_FORMAT_ERROR;
+        if (checksum(file->data() + current.fileOffset, current.fileSize) != current.checksum)
+            return status::FILE_CHECKSUM_ERROR;
+    }
+
+    for (const image_segment& current : table) {
+        const bool isMappable = (current.fileOffset & guest_memory::pageMask) ==
+                                (current.loadAddress & guest_memory::pageMask);
+        const std::uint8_t* source = file->data() + current.fileOffset;
+        std::uint32_t address = current.loadAddress;
+        std::uint32_t remaining = current.fileSize;
+        while (remaining) {
+            if (isMappable && !(address & guest_memory::pageMask) && remaining >= guest_memory::pageSize) {
+                const std::uint32_t count = remaining >> guest_memory::pageShift;
+                memory.mapPages(file, source, address >> guest_memory::pageShift, count);
+                source += count * guest_memory::pageSize;
+                address += count * guest_memory::pageSize;
+                remaining -= count * guest_memory::pageSize;
+                continue;
+            }
+            const std::uint32_t chunk = std::min(remaining, guest_memory::pageSize - (address & guest_memory::pageMask));
+            memory.write(address, source, chunk);
+            source += chunk;
+            address += chunk;
+            remaining -= chunk;
+        }
+
+        static const std::uint8_t zeroes[guest_memory::pageSize] = {};
+        remaining = current.memorySize - current.fileSize;
+        while (remaining) {
+            const std::uint32_t chunk = std::min(remaining, guest_memory::pageSize - (address & guest_memory::pageMask));
+            memory.write(address, zeroes, chunk);
+            address += chunk;
+            remaining -= chunk;
+        }
+    }
+    entry = header.entry;
+    return status::STATUS_OK;
+}
+
+}
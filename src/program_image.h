@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "base.h"
+#include "guest_memory.h"
+
+// Sectioned program image. File starts with image_header, segment table
+// follows it, then segment data. Writer places data at file offsets with the
+// same page offset as load address, so whole pages of a segment are mapped
+// into guest memory without copying, only unaligned edges are copied.
+// Values are stored in host byte order.
+namespace program_image {
+
+constexpr char magicValue[8] = { 'C', 'P', 'U', 'I', 'M', 'A', 'G', '\0' };
+constexpr std::uint32_t currentVersion = 1;
+
+struct image_header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entry;          // initial instructionPtr
+    std::uint32_t segmentsCount;
+    std::uint32_t tableChecksum;  // checksum of segment table
+};
+
+struct image_segment {
+    std::uint32_t fileOffset;
+    std::uint32_t fileSize;
+    std::uint32_t loadAddress;
+    std::uint32_t memorySize;     // memory after fileSize bytes is zeroed
+    std::uint32_t checksum;       // checksum of fileSize bytes of data
+};
+
+// Segment description for writer
+struct segment {
+    std::uint32_t loadAddress;
+    const void* data;
+    std::uint32_t size;
+    std::uint32_t memorySize;     // 0 means the same as size
+};
+
+// Adler-32, initial value is 1
+std::uint32_t checksum(const std::uint8_t* const data, const std::size_t size, const std::uint32_t initial = 1);
+
+status save(const std::string& path, const std::uint32_t entry, const std::vector<segment>& segments);
+// Validates whole image before memory is changed, on success every segment
+// is placed into memory and entry is set
+status load(const std::string& path, guest_memory& memory, std::uint32_t& entry);
+
+}
@@ -0,0 +1,113 @@
+#include <cstring>
+#include <algorithm>
+
+#include "replay.h"
+#include "event_log.h"
+
+replay_recorder::replay_recorder(const execution_tier _tier, const std::uint64_t _checkpointInterval) :
+    tier(_tier), checkpointInterval(std::max<std::uint64_t>(_checkpointInterval, 1)), machine(new cpu(_tier)),
+    instructionsCount(0) {}
+
+run_result replay_recorder::run(const std::uint64_t maxInstructions)
+{
+    if (checkpoints.empty())
+        takeCheckpoint();
+
+    run_result result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+    while (result.retiredInstructions < maxInstructions) {
+        const std::uint64_t untilCheckpoint = checkpointInterval - instructionsCount % checkpointInterval;
+        const run_result part = machine->run(std::min(maxInstructions - result.retiredInstructions, untilCheckpoint));
+        result.retiredInstructions += part.retiredInstructions;
+        result.reason = part.reason;
+        result.lastStatus = part.lastStatus;
+        instructionsCount += part.retiredInstructions;
+        if (part.retiredInstructions && instructionsCount % checkpointInterval == 0)
+            takeCheckpoint();
+        if (part.reason != stop_reason::INSTRUCTIONS_LIMIT)
+            break;
+    }
+    return result;
+}
+
+void replay_recorder::writeMemory(const std::uint32_t address, const void* const data, const std::uint32_t size)
+{
+    const std::uint8_t* const bytes = static_cast<const std::uint8_t*>(data);
+    addInput({ instructionsCount, replay_input_type::MEMORY, address, std::vector<std::uint8_t>(bytes, bytes + size) });
+}
+
+void replay_recorder::setRegister(const std::uint32_t index, const cpu_register_t value)
+{
+    std::vector<std::uint8_t> data(sizeof(value));
+    std::memcpy(data.data(), &value, sizeof(value));
+    addInput({ instructionsCount, replay_input_type::REGISTER, index, std::move(data) });
+}
+
+void replay_recorder::setInstructionPtr(const std::uint32_t address)
+{
+    addInput({ instructionsCount, replay_input_type::INSTRUCTION_PTR, address, {} });
+}
+
+status replay_recorder::seek(const std::uint64_t instruction, std::unique_ptr<cpu>& result) const
+{
+    if (instruction > instructionsCount || checkpoints.empty()) {
+        event_log::getDefault().push(log_record::make("replay_recorder::seek", status::UNKNOWN_ERROR));
+        return status::UNKNOWN_ERROR;
+    }
+
+    const auto found = std::upper_bound(checkpoints.begin(), checkpoints.end(), instruction,
+                                        [](const std::uint64_t value, const checkpoint& current) {
+                                            return value < current.instruction;
+                                        }) - 1;
+    std::unique_ptr<cpu> target = found->state->clone(tier);
+    std::uint64_t count = found->instruction;
+    std::size_t nextInput = found->inputIndex;
+    while (true) {
+        for (; nextInput < inputs.size() && inputs[nextInput].instruction == count; ++nextInput)
+            apply(inputs[nextInput], *target);
+        if (count == instruction)
+            break;
+
+        std::uint64_t stop = instruction;
+        if (nextInput < inputs.size())
+            stop = std::min(stop, inputs[nextInput].instruction);
+        const run_result part = target->run(stop - count);
+        count += part.retiredInstructions;
+        // Recorded run went further, so replayed one has diverged
+        if (count < stop) {
+            const status st = part.lastStatus < status::UNKNOWN_WARNING ? part.lastStatus : status::UNKNOWN_ERROR;
+            event_log::getDefault().push(log_record::make("replay_recorder::seek", st, target->getInstructionPtr()));
+            return st;
+        }
+    }
+    result = std::move(target);
+    return status::STATUS_OK;
+}
+
+void replay_recorder::takeCheckpoint()
+{
+    checkpoints.push_back({ instructionsCount, inputs.size(), machine->clone(execution_tier::INTERPRETER) });
+}
+
+void replay_recorder::addInput(replay_input&& input)
+{
+    if (checkpoints.empty())
+        takeCheckpoint();
+    apply(input, *machine);
+    inputs.push_back(std::move(input));
+}
+
+void replay_recorder::apply(const replay_input& input, cpu& target)
+{
+    switch (input.type) {
+    case replay_input_type::MEMORY:
+        target.getMemory().write(input.target, input.data.data(), input.data.size());
+        target.invalidateCode(input.target, input.data.size());
+        break;
+    case replay_input_type::REGISTER:
+        std::memcpy(&target.getRegisters()[input.target], input.data.data(), sizeof(cpu_register_t));
+        break;
+    case replay_input_type::INSTRUCTION_PTR:
+        target.setInstructionPtr(input.target);
+        break;
+    }
+}
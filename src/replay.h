@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "base.h"
+#include "cpu.h"
+
+enum class replay_input_type : std::int32_t {
+    MEMORY = 0,
+    REGISTER,
+    INSTRUCTION_PTR
+};
+
+// Change of cpu state made by host between runs. It is applied before
+// instruction with index instruction is executed.
+struct replay_input {
+    std::uint64_t instruction;
+    replay_input_type type;
+    std::uint32_t target; // address or register index
+    std::vector<std::uint8_t> data; // written bytes, register value or instruction pointer
+};
+
+// Records run of cpu so that any point of it can be restored later. Guest
+// code is deterministic, so the only inputs are changes made by host,
+// they are logged with instruction count at which they happened. Every
+// checkpointInterval retired instructions cpu is cloned, clone shares
+// memory pages with running cpu, so checkpoint keeps only registers and
+// pages written after it. Seek restores the nearest checkpoint and
+// executes at most checkpointInterval instructions forward.
+class replay_recorder {
+public:
+    static constexpr std::uint64_t defaultCheckpointInterval = 1 << 20;
+
+    explicit replay_recorder(const execution_tier _tier = execution_tier::INTERPRETER,
+                             const std::uint64_t _checkpointInterval = defaultCheckpointInterval);
+
+    // State set through getCpu() before the first run is a part of recording,
+    // after that every change has to be made by methods below
+    run_result run(const std::uint64_t maxInstructions);
+    void writeMemory(const std::uint32_t address, const void* const data, const std::uint32_t size);
+    void setRegister(const std::uint32_t index, const cpu_register_t value);
+    void setInstructionPtr(const std::uint32_t address);
+
+    // New cpu with the state recorded cpu had after retiring given count of
+    // instructions and applying inputs made at that point
+    status seek(const std::uint64_t instruction, std::unique_ptr<cpu>& result) const;
+
+    inline cpu& getCpu() { return *machine; }
+    inline const cpu& getCpu() const { return *machine; }
+    inline std::uint64_t getInstructionsCount() const { return instructionsCount; }
+    inline std::size_t getCheckpointsCount() const { return checkpoints.size(); }
+    inline const std::vector<replay_input>& getInputs() const { return inputs; }
+private:
+    struct checkpoint {
+        std::uint64_t instruction;
+        std::size_t inputIndex; // first input which is not applied to state
+        std::unique_ptr<cpu> state;
+    };
+
+    void takeCheckpoint();
+    void addInput(replay_input&& input);
+    static void apply(const replay_input& input, cpu& target);
+
+    const execution_tier tier;
+    const std::uint64_t checkpointInterval;
+    std::unique_ptr<cpu> machine;
+    std::uint64_t instructionsCount;
+    std::vector<checkpoint> checkpoints;
+    std::vector<replay_input> inputs;
+};
@@ -0,0 +1,69 @@
+#include <cstring>
+#include <algorithm>
+
+#include "shared_image.h"
+#include "program_image.h"
+
+shared_image::shared_image() : data(), entry(0) {}
+
+shared_image shared_image::fromBuffer(const std::uint8_t* const buffer, const std::uint32_t size,
+                                      const std::uint32_t loadAddress, const std::uint32_t entry)
+{
+    guest_memory memory;
+    std::vector<std::uint32_t> pageIndices;
+    const std::uint32_t end = loadAddress < maxSupportedMemory ? (std::uint32_t)std::min<std::uint64_t>((std::uint64_t)loadAddress + size, maxSupportedMemory) : loadAddress;
+    if (end > loadAddress) {
+        memory.write(loadAddress, buffer, end - loadAddress);
+        for (std::uint32_t page = loadAddress >> guest_memory::pageShift; page <= (end - 1) >> guest_memory::pageShift; ++page)
+            pageIndices.push_back(page);
+    }
+    return capture(memory, pageIndices, entry);
+}
+
+shared_image shared_image::fromMemory(const guest_memory& memory, const std::uint32_t entry)
+{
+    static const std::uint8_t zeroes[guest_memory::pageSize] = {};
+
+    std::vector<std::uint32_t> pageIndices;
+    for (std::uint32_t page = 0; page < guest_memory::pagesCount; ++page)
+        if (std::memcmp(memory.getReadPages()[page], zeroes, guest_memory::pageSize))
+            pageIndices.push_back(page);
+    return capture(memory, pageIndices, entry);
+}
+
+status shared_image::load(const std::string& path, shared_image& image)
+{
+    guest_memory memory;
+    std::uint32_t entry;
+    const status st = program_image::load(path, memory, entry);
+    if (st != status::STATUS_OK)
+        return st;
+    image = fromMemory(memory, entry);
+    return status::STATUS_OK;
+}
+
+shared_image shared_image::capture(const guest_memory& memory, const std::vector<std::uint32_t>& pageIndices,
+                                   const std::uint32_t entry)
+{
+    std::shared_ptr<image_data> captured = std::make_shared<image_data>();
+    captured->pages.reset(new image_page[pageIndices.size()]);
+    captured->pageIndices = pageIndices;
+    captured->hash = getContentHash(pageIndices.data(), pageIndices.size() * sizeof(std::uint32_t));
+    for (std::size_t index = 0; index < pageIndices.size(); ++index) {
+        std::memcpy(captured->pages[index].data, memory.getReadPages()[pageIndices[index]], guest_memory::pageSize);
+        captured->hash = getContentHash(captured->pages[index].data, guest_memory::pageSize, captured->hash);
+    }
+
+    shared_image image;
+    image.data = std::move(captured);
+    image.entry = entry;
+    return image;
+}
+
+void shared_image::map(guest_memory& memory) const
+{
+    if (!data)
+        return;
+    for (std::size_t index = 0; index < data->pageIndices.size(); ++index)
+        memory.mapPages(data, data->pages[index].data, data->pageIndices[index], 1);
+}
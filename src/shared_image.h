@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include "base.h"
+#include "guest_memory.h"
+
+// Read-only program shared by many cpus. Pages of program are copied once
+// into one reference counted buffer, every cpu maps them into its memory
+// and gets a private copy only of pages it writes. Copies of shared_image
+// are cheap handles to the same pages.
+class shared_image {
+public:
+    shared_image();
+
+    // Pages holding size bytes of data placed at loadAddress, the rest of
+    // these pages is zero. Data beyond the end of memory is dropped.
+    static shared_image fromBuffer(const std::uint8_t* const buffer, const std::uint32_t size,
+                                   const std::uint32_t loadAddress, const std::uint32_t entry);
+    // Every page of memory which is not zero
+    static shared_image fromMemory(const guest_memory& memory, const std::uint32_t entry);
+    // Program image file, see program_image.h. Pages which stay zero after
+    // loading are not part of image.
+    static status load(const std::string& path, shared_image& image);
+
+    // Other pages of memory are kept
+    void map(guest_memory& memory) const;
+
+    inline std::uint32_t getEntry() const { return entry; }
+    inline std::uint32_t getPagesCount() const { return data ? data->pageIndices.size() : 0; }
+    // Content hash of pages and their addresses
+    inline std::uint64_t getHash() const { return data ? data->hash : 0; }
+private:
+    struct alignas(guest_memory::pageSize) image_page {
+        std::uint8_t data[guest_memory::pageSize];
+    };
+
+    struct image_data {
+        std::unique_ptr<image_page[]> pages;
+        std::vector<std::uint32_t> pageIndices; // guest page of every image page
+        std::uint64_t hash;
+    };
+
+    static shared_image capture(const guest_memory& memory, const std::vector<std::uint32_t>& pageIndices,
+                                const std::uint32_t entry);
+
+    std::shared_ptr<const image_data> data;
+    std::uint32_t entry;
+};
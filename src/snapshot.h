@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+
+#include "base.h"
+#include "instructions.h"
+
+// On-disk layout of cpu snapshot. Header takes the first page of the file,
+// guest memory follows it page by page, so loader maps memory pages
+// straight from the file. Values are stored in host byte order.
+struct snapshot_header {
+    static constexpr char magicValue[8] = { 'C', 'P', 'U', 'S', 'N', 'A', 'P', '\0' };
+    static constexpr std::uint32_t currentVersion = 2;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t pageSize;
+    std::uint32_t memoryOffset; // page aligned offset of memory in file
+    std::uint32_t memorySize;
+    std::uint32_t registersCount;
+    std::uint32_t registerSize; // in bits
+    std::uint32_t instructionPtr;
+    cpu_register_t statusRegister;
+    cpu_register_t registers[default_cpu_properties::registersCount];
+    std::uint8_t vectorRegisters[instructions::vectorRegistersCount * instructions::vectorSize];
+};
@@ -0,0 +1,400 @@
+#include <cstring>
+#include <algorithm>
+
+#include "trace.h"
+#include "lz_codec.h"
+#include "program_image.h"
+
+namespace {
+
+enum record_flags : std::uint8_t {
+    JUMP = 0x1,
+    REGISTER_WRITE = 0x2,
+    MEMORY_ACCESS = 0x4,
+    WARNING = 0x8
+};
+constexpr std::uint32_t registerIndexShift = 4;
+
+inline std::uint32_t zigzag(const std::int32_t value)
+{
+    return ((std::uint32_t)value << 1) ^ (std::uint32_t)(value >> 31);
+}
+
+inline std::int32_t unzigzag(const std::uint32_t value)
+{
+    return (std::int32_t)(value >> 1) ^ -(std::int32_t)(value & 1);
+}
+
+inline std::uint8_t* writeVarint(std::uint8_t* output, std::uint32_t value)
+{
+    for (; value >= 0x80; value >>= 7)
+        *output++ = (std::uint8_t)(value | 0x80);
+    *output++ = (std::uint8_t)value;
+    return output;
+}
+
+// Returns false if varint runs out of input or is longer than 32 bits
+inline bool readVarint(const std::uint8_t*& position, const std::uint8_t* const end, std::uint32_t& value)
+{
+    value = 0;
+    for (std::uint32_t shift = 0; shift < 35; shift += 7) {
+        if (position == end)
+            return false;
+        const std::uint8_t byte = *position++;
+        value |= (std::uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+inline std::uint8_t* writeWord(std::uint8_t* output, const cpu_register_t value)
+{
+    std::memcpy(output, &value, sizeof(value));
+    return output + sizeof(value);
+}
+
+inline bool readWord(const std::uint8_t*& position, const std::uint8_t* const end, cpu_register_t& value)
+{
+    if ((std::size_t)(end - position) < sizeof(value))
+        return false;
+    std::memcpy(&value, position, sizeof(value));
+    position += sizeof(value);
+    return true;
+}
+
+// Vector registers are not traced, their instructions keep only the word
+inline bool isRegisterWrite(const instructions::operation op)
+{
+    return op != instructions::operation::STORE && op != instructions::operation::UNKNOWN && !instructions::isVector(op);
+}
+
+// Address before the first instruction, so trace starting at 0 needs no jump
+constexpr std::uint32_t initialAddress = (std::uint32_t)-(std::int32_t)sizeof(cpu_register_t);
+
+}
+
+trace_recorder::trace_recorder() :
+    isRecording(false),
+    chunkSize(defaultChunkSize),
+    recordedInstructions(0),
+    activeHeader(),
+    previousAddress(initialAddress),
+    previousMemoryAddress(0),
+    registers(),
+    activeSize(0),
+    pendingHeader(),
+    hasPending(false),
+    isStopping(false) {}
+
+trace_recorder::~trace_recorder()
+{
+    close();
+}
+
+status trace_recorder::open(const std::string& path, const cpu_register_t* const _registers,
+                            const std::uint32_t _chunkSize)
+{
+    close();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return status::FILE_ACCESS_ERROR;
+
+    trace_file_header header = {};
+    std::memcpy(header.magic, trace_file_header::magicValue, sizeof(header.magic));
+    header.version = trace_file_header::currentVersion;
+    header.registersCount = default_cpu_properties::registersCount;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    chunkSize = std::max<std::uint32_t>(_chunkSize, 2 * maxRecordSize);
+    recordedInstructions = 0;
+    previousAddress = initialAddress;
+    std::memcpy(registers, _registers, sizeof(registers));
+    active.resize(chunkSize);
+    pending.resize(chunkSize);
+    index.clear();
+    hasPending = false;
+    isStopping = false;
+    startChunk();
+    writer = std::thread(&trace_recorder::writerLoop, this);
+    isRecording = true;
+    return status::STATUS_OK;
+}
+
+status trace_recorder::close()
+{
+    if (!isRecording)
+        return status::STATUS_OK;
+    if (activeSize)
+        finishChunk();
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        isStopping = true;
+    }
+    writerWakeUp.notify_all();
+    writer.join();
+    isRecording = false;
+
+    trace_footer footer = {};
+    footer.indexOffset = file.tellp();
+    footer.instructionsCount = recordedInstructions;
+    footer.chunksCount = index.size();
+    std::memcpy(footer.magic, trace_file_header::magicValue, sizeof(footer.magic));
+    file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(trace_index_entry));
+    file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    file.close();
+    return file ? status::STATUS_OK : status::FILE_ACCESS_ERROR;
+}
+
+void trace_recorder::record(const execution_event& event)
+{
+    // Byte stores may alias any member, so state is kept in locals
+    std::uint8_t* const start = active.data() + activeSize;
+    std::uint8_t* output = start + 1;
+    const std::uint32_t address = event.address;
+    const std::uint32_t memoryAddress = event.memoryAddress;
+    const instructions::operation op = event.operands.op;
+    std::uint8_t flags = 0;
+    output = writeWord(output, event.instruction);
+
+    const std::uint32_t expectedAddress = previousAddress + sizeof(cpu_register_t);
+    previousAddress = address;
+    if (address != expectedAddress) {
+        flags |= JUMP;
+        output = writeVarint(output, zigzag((std::int32_t)(address - expectedAddress)));
+    }
+
+    if (isRegisterWrite(op)) {
+        const std::uint8_t registerIndex = event.operands.dstRegisterIndex;
+        const cpu_register_t value = event.registers[registerIndex];
+        const cpu_register_t previous = registers[registerIndex];
+        registers[registerIndex] = value;
+        flags |= REGISTER_WRITE | (registerIndex << registerIndexShift);
+        output = writeVarint(output, zigzag((std::int16_t)(value - previous)));
+    }
+
+    if (memoryAddress != noMemoryAccess) {
+        const std::uint32_t previous = previousMemoryAddress;
+        previousMemoryAddress = memoryAddress;
+        flags |= MEMORY_ACCESS;
+        output = writeVarint(output, zigzag((std::int32_t)(memoryAddress - previous)));
+        // Loaded value is the written register
+        if (op == instructions::operation::STORE)
+            output = writeWord(output, event.registers[event.operands.srcRegisterIndex]);
+    }
+
+    if (event.st != status::STATUS_OK) {
+        flags |= WARNING;
+        output = writeVarint(output, (std::uint32_t)-(std::int32_t)event.st);
+    }
+
+    *start = flags;
+    activeSize = output - active.data();
+    ++recordedInstructions;
+}
+
+void trace_recorder::startChunk()
+{
+    activeHeader.firstInstruction = recordedInstructions;
+    activeHeader.previousAddress = previousAddress;
+    std::memcpy(activeHeader.registers, registers, sizeof(registers));
+    previousMemoryAddress = 0;
+    activeSize = 0;
+}
+
+void trace_recorder::finishChunk()
+{
+    {
+        // Waits only if writer is still busy with the previous chunk
+        std::unique_lock<std::mutex> lock(writerMutex);
+        writerWakeUp.wait(lock, [this] { return !hasPending; });
+        pending.swap(active);
+        pendingHeader = activeHeader;
+        pendingHeader.instructionsCount = recordedInstructions - activeHeader.firstInstruction;
+        pendingHeader.rawSize = activeSize;
+        hasPending = true;
+    }
+    writerWakeUp.notify_all();
+    startChunk();
+}
+
+void trace_recorder::writerLoop()
+{
+    std::vector<std::uint8_t> compressed;
+    std::unique_lock<std::mutex> lock(writerMutex);
+    while (true) {
+        writerWakeUp.wait(lock, [this] { return hasPending || isStopping; });
+        if (!hasPending)
+            break;
+        trace_chunk_header header = pendingHeader;
+        lock.unlock();
+
+        // Recorder does not touch pending chunk until hasPending is reset
+        compressed.clear();
+        lz_codec::compress(pending.data(), header.rawSize, compressed);
+        header.compressedSize = compressed.size();
+        header.checksum = program_image::checksum(compressed.data(), compressed.size());
+        index.push_back({ header.firstInstruction, (std::uint64_t)file.tellp() });
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+
+        lock.lock();
+        hasPending = false;
+        writerWakeUp.notify_all();
+    }
+}
+
+status trace_reader::open(const std::string& path)
+{
+    file = mapped_file::open(path);
+    index.clear();
+    instructionsCount = 0;
+    if (!file)
+        return status::FILE_ACCESS_ERROR;
+
+    trace_file_header header;
+    trace_footer footer;
+    if (file->size() < sizeof(header) + sizeof(footer))
+        return status::FILE_FORMAT_ERROR;
+    std::memcpy(&header, file->data(), sizeof(header));
+    std::memcpy(&footer, file->data() + file->size() - sizeof(footer), sizeof(footer));
+    if (std::memcmp(header.magic, trace_file_header::magicValue, sizeof(header.magic)) ||
+        std::memcmp(footer.magic, trace_file_header::magicValue, sizeof(footer.magic)) ||
+        header.version != trace_file_header::currentVersion ||
+        header.registersCount != default_cpu_properties::registersCount ||
+        footer.indexOffset + (std::uint64_t)footer.chunksCount * sizeof(trace_index_entry) !=
+            file->size() - sizeof(footer))
+        return status::FILE_FORMAT_ERROR;
+
+    index.resize(footer.chunksCount);
+    std::memcpy(index.data(), file->data() + footer.indexOffset, index.size() * sizeof(trace_index_entry));
+    for (std::size_t chunk = 0; chunk < index.size(); ++chunk) {
+        if (index[chunk].offset + sizeof(trace_chunk_header) > footer.indexOffset ||
+            index[chunk].firstInstruction >= footer.instructionsCount ||
+            (chunk && index[chunk].firstInstruction <= index[chunk - 1].firstInstruction)) {
+            index.clear();
+            return status::FILE_FORMAT_ERROR;
+        }
+    }
+    if (footer.instructionsCount && (index.empty() || index.front().firstInstruction)) {
+        index.clear();
+        return status::FILE_FORMAT_ERROR;
+    }
+    instructionsCount = footer.instructionsCount;
+    return seek(0);
+}
+
+status trace_reader::loadChunk(const std::size_t chunk)
+{
+    trace_chunk_header header;
+    std::memcpy(&header, file->data() + index[chunk].offset, sizeof(header));
+    const std::uint64_t dataOffset = index[chunk].offset + sizeof(header);
+    const std::uint64_t nextFirst = chunk + 1 < index.size() ? index[chunk + 1].firstInstruction : instructionsCount;
+    if (header.firstInstruction != index[chunk].firstInstruction ||
+        header.firstInstruction + header.instructionsCount != nextFirst ||
+        dataOffset + header.compressedSize > file->size())
+        return status::FILE_FORMAT_ERROR;
+    const std::uint8_t* const data = file->data() + dataOffset;
+    if (program_image::checksum(data, header.compressedSize) != header.checksum)
+        return status::FILE_CHECKSUM_ERROR;
+    records.resize(header.rawSize);
+    if (!lz_codec::decompress(data, header.compressedSize, records.data(), records.size()))
+        return status::FILE_FORMAT_ERROR;
+
+    currentChunk = chunk;
+    position = 0;
+    nextInstruction = header.firstInstruction;
+    chunkEnd = nextFirst;
+    previousAddress = header.previousAddress;
+    previousMemoryAddress = 0;
+    std::memcpy(registers, header.registers, sizeof(registers));
+    return status::STATUS_OK;
+}
+
+status trace_reader::seek(const std::uint64_t instruction)
+{
+    if (!file || instruction > instructionsCount)
+        return status::UNKNOWN_ERROR;
+    if (index.empty()) {
+        nextInstruction = chunkEnd = 0;
+        return status::STATUS_OK;
+    }
+
+    const auto found = std::upper_bound(index.begin(), index.end(), instruction,
+                                        [](const std::uint64_t value, const trace_index_entry& entry) {
+                                            return value < entry.firstInstruction;
+                                        });
+    status st = loadChunk(found - index.begin() - 1);
+    if (st != status::STATUS_OK)
+        return st;
+    trace_entry skipped;
+    while (nextInstruction < instruction) {
+        if (!next(skipped))
+            return status::FILE_FORMAT_ERROR;
+    }
+    return status::STATUS_OK;
+}
+
+bool trace_reader::next(trace_entry& entry)
+{
+    if (nextInstruction >= instructionsCount)
+        return false;
+    if (nextInstruction == chunkEnd && loadChunk(currentChunk + 1) != status::STATUS_OK)
+        return false;
+
+    const std::uint8_t* input = records.data() + position;
+    const std::uint8_t* const end = records.data() + records.size();
+    if (input == end)
+        return false;
+    const std::uint8_t flags = *input++;
+    std::uint32_t value;
+
+    entry = {};
+    entry.index = nextInstruction;
+    if (!readWord(input, end, entry.instruction))
+        return false;
+
+    entry.address = previousAddress + sizeof(cpu_register_t);
+    if (flags & JUMP) {
+        if (!readVarint(input, end, value))
+            return false;
+        entry.address += unzigzag(value);
+    }
+
+    if (flags & REGISTER_WRITE) {
+        entry.hasRegisterWrite = true;
+        entry.registerIndex = (flags >> registerIndexShift) & (default_cpu_properties::registersCount - 1);
+        if (!readVarint(input, end, value))
+            return false;
+        registers[entry.registerIndex] += unzigzag(value);
+        entry.registerValue = registers[entry.registerIndex];
+    }
+
+    if (flags & MEMORY_ACCESS) {
+        entry.hasMemoryAccess = true;
+        if (!readVarint(input, end, value))
+            return false;
+        previousMemoryAddress += unzigzag(value);
+        entry.memoryAddress = previousMemoryAddress;
+        entry.isStore = !entry.hasRegisterWrite;
+        if (entry.isStore) {
+            if (!readWord(input, end, entry.memoryValue))
+                return false;
+        }
+        else {
+            entry.memoryValue = entry.registerValue;
+        }
+    }
+
+    entry.st = status::STATUS_OK;
+    if (flags & WARNING) {
+        if (!readVarint(input, end, value))
+            return false;
+        entry.st = (status)-(std::int32_t)value;
+    }
+
+    position = input - records.data();
+    previousAddress = entry.address;
+    ++nextInstruction;
+    return true;
+}
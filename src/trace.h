@@ -0,0 +1,162 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <condition_variable>
+
+#include "base.h"
+#include "profiler.h"
+#include "mapped_file.h"
+
+// Binary execution trace of retired instructions. File starts with
+// trace_file_header, then chunks follow, each is trace_chunk_header and
+// LZ compressed records, trace index and trace_footer close the file.
+// Chunk header keeps decoder state, so every chunk is decoded on its own.
+// Values are stored in host byte order.
+//
+// Record is a flags byte and 16-bit instruction word, then optional fields:
+// zigzag varint of address delta if address does not follow previous
+// instruction, zigzag varint of written register delta, zigzag varint of
+// memory address delta and 16-bit stored value, varint of negated status.
+// Typical alu instruction takes 4 bytes before compression.
+struct trace_file_header {
+    static constexpr char magicValue[8] = { 'C', 'P', 'U', 'T', 'R', 'A', 'C', 'E' };
+    static constexpr std::uint32_t currentVersion = 1;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t registersCount;
+};
+
+struct trace_chunk_header {
+    std::uint64_t firstInstruction;
+    std::uint32_t instructionsCount;
+    std::uint32_t rawSize;
+    std::uint32_t compressedSize;
+    std::uint32_t checksum; // Adler-32 of compressed records
+    std::uint32_t previousAddress; // address of instruction retired before chunk
+    cpu_register_t registers[default_cpu_properties::registersCount]; // last written values
+};
+
+struct trace_index_entry {
+    std::uint64_t firstInstruction;
+    std::uint64_t offset; // of chunk header
+};
+
+struct trace_footer {
+    std::uint64_t indexOffset;
+    std::uint64_t instructionsCount;
+    std::uint32_t chunksCount;
+    char magic[8];
+};
+
+struct trace_entry {
+    std::uint64_t index; // count of instructions retired before this one
+    std::uint32_t address;
+    cpu_register_t instruction;
+    bool hasRegisterWrite;
+    std::uint8_t registerIndex;
+    cpu_register_t registerValue;
+    bool hasMemoryAccess;
+    bool isStore;
+    std::uint32_t memoryAddress;
+    cpu_register_t memoryValue; // loaded or stored value
+    status st; // STATUS_OK or warning
+};
+
+// Profiling policy which records every retired instruction. Records go into
+// the active chunk, full chunk is passed to writer thread, which compresses
+// it and writes it to the file while the next chunk is filled.
+class trace_recorder {
+public:
+    static constexpr bool isEnabled = true;
+    static constexpr bool isReversible = false;
+    static constexpr std::uint32_t defaultChunkSize = 1 << 20;
+
+    trace_recorder();
+    trace_recorder(const trace_recorder&) = delete;
+    trace_recorder& operator=(const trace_recorder&) = delete;
+    ~trace_recorder();
+
+    // Registers are values before the first traced instruction
+    status open(const std::string& path, const cpu_register_t* const registers,
+                const std::uint32_t _chunkSize = defaultChunkSize);
+    // Writes the rest of records and index
+    status close();
+    inline bool isOpen() const { return isRecording; }
+    inline std::uint64_t getRecordedInstructions() const { return recordedInstructions; }
+
+    inline void onBeforeExecute(const std::uint32_t, const instructions::decoded_instruction&, const cpu_register_t*,
+                                const instructions::lazy_flags&, const guest_memory&) {}
+    inline void onExecute(const execution_event& event)
+    {
+        if (event.st < status::UNKNOWN_WARNING || !isOpen())
+            return;
+        record(event);
+        if (activeSize + maxRecordSize > chunkSize)
+            finishChunk();
+    }
+private:
+    static constexpr std::size_t maxRecordSize = 24;
+
+    void record(const execution_event& event);
+    void startChunk();
+    void finishChunk();
+    void writerLoop();
+
+    std::ofstream file; // used by writer thread while trace is open
+    bool isRecording;
+    std::uint32_t chunkSize;
+    std::uint64_t recordedInstructions;
+
+    // State of encoder, it is saved into header of every chunk
+    trace_chunk_header activeHeader;
+    std::uint32_t previousAddress;
+    std::uint32_t previousMemoryAddress;
+    cpu_register_t registers[default_cpu_properties::registersCount];
+    std::vector<std::uint8_t> active; // chunkSize bytes, activeSize of them are used
+    std::size_t activeSize;
+
+    // Chunk handed to writer thread
+    std::mutex writerMutex;
+    std::condition_variable writerWakeUp;
+    std::vector<std::uint8_t> pending;
+    trace_chunk_header pendingHeader;
+    bool hasPending;
+    bool isStopping;
+    std::vector<trace_index_entry> index;
+    std::thread writer;
+};
+
+// Reads trace written by trace_recorder. Seek finds chunk by index and
+// decodes records of this chunk up to requested instruction.
+class trace_reader {
+public:
+    status open(const std::string& path);
+    inline std::uint64_t getInstructionsCount() const { return instructionsCount; }
+
+    // Next read entry will be the one with given index
+    status seek(const std::uint64_t instruction);
+    // Returns false at the end of trace or if chunk is corrupted
+    bool next(trace_entry& entry);
+private:
+    status loadChunk(const std::size_t chunk);
+
+    std::shared_ptr<mapped_file> file;
+    std::vector<trace_index_entry> index;
+    std::uint64_t instructionsCount = 0;
+
+    std::size_t currentChunk = 0;
+    std::vector<std::uint8_t> records;
+    std::size_t position = 0;
+    std::uint64_t nextInstruction = 0;
+    std::uint64_t chunkEnd = 0; // index of the first instruction after current chunk
+    std::uint32_t previousAddress = 0;
+    std::uint32_t previousMemoryAddress = 0;
+    cpu_register_t registers[default_cpu_properties::registersCount] = {};
+};
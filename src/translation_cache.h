@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+#include "base.h"
+
+// On-disk layout of JIT translations, see jit_engine::save. Header is
+// followed by block table, offsets of absolute host addresses which are
+// patched on load, and code buffer up to its used size. Code is position
+// independent otherwise, so it is copied to the new buffer as is. codeHash
+// covers geometry and guest code of every valid block, checksum covers
+// everything after header. buildFingerprint identifies emitter and compiler
+// which made the code, see jit_engine::getBuildFingerprint. Values are stored
+// in host byte order.
+struct translation_cache_header {
+    static constexpr char magicValue[8] = { 'C', 'P', 'U', 'J', 'I', 'T', 'C', '\0' };
+    static constexpr std::uint32_t currentVersion = 3;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t registersCount;
+    std::uint32_t registerSize; // in bits
+    std::uint32_t maxInstructionsCount;
+    std::uint32_t contextSize;  // sizeof(jit_context), changes with layout used by code
+    std::uint32_t blocksCount;
+    std::uint32_t relocationsCount;
+    std::uint32_t codeSize;
+    std::uint32_t checksum;
+    std::uint64_t codeHash;
+    std::uint64_t buildFingerprint;
+};
+
+struct translation_cache_block {
+    static constexpr std::uint32_t noChainJump = 0xffffffff;
+
+    std::uint32_t startAddress;
+    std::uint32_t endAddress;
+    std::uint32_t codeOffset;
+    std::uint32_t chainJumpOffsets[2]; // noChainJump if unused
+    std::uint32_t chainTargets[2];
+    std::uint32_t isValid;
+};
@@ -0,0 +1,69 @@
+#include <cstring>
+#include <algorithm>
+
+#include "undo_log.h"
+
+undo_log::undo_log(const std::size_t _capacity) : entries(std::max<std::size_t>(_capacity, 1)), head(0), size(0) {}
+
+std::uint64_t undo_log::undo(const std::uint64_t count, std::uint32_t& instructionPtr, cpu_register_t* const registers,
+                             instructions::lazy_flags& flags, guest_memory& memory)
+{
+    const std::uint64_t reverted = std::min<std::uint64_t>(count, size);
+    for (std::uint64_t index = 0; index < reverted; ++index) {
+        head = head ? head - 1 : entries.size() - 1;
+        const undo_entry& entry = entries[head];
+        switch (entry.kind) {
+        case entry_kind::REGISTER:
+            registers[entry.registerIndex] = entry.value;
+            break;
+        case entry_kind::FLAGS_AND_REGISTER:
+            registers[entry.registerIndex] = entry.value;
+            flags.assign(entry.flags);
+            break;
+        case entry_kind::STORE_WORD:
+            memory.writeWord(entry.target, entry.value);
+            break;
+        case entry_kind::STORE_BYTE:
+            memory.writeByte(entry.target, entry.value);
+            break;
+        case entry_kind::VECTOR_REGISTER:
+            std::memcpy(instructions::getVectorRegister(registers, default_cpu_properties::registersCount, entry.registerIndex),
+                        vectors[head].data(), instructions::vectorSize);
+            break;
+        case entry_kind::STORE_VECTOR:
+            memory.write(entry.target, vectors[head].data(), instructions::vectorSize);
+            break;
+        }
+        instructionPtr = entry.address;
+    }
+    size -= reverted;
+    return reverted;
+}
+
+void undo_log::recordVector(const instructions::decoded_instruction& operands, const cpu_register_t* const registers,
+                            const guest_memory& memory)
+{
+    if (vectors.empty())
+        vectors.resize(entries.size());
+    undo_entry& entry = entries[head];
+    if (operands.op != instructions::operation::VECTOR_STORE) {
+        entry.kind = entry_kind::VECTOR_REGISTER;
+        entry.registerIndex = operands.dstRegisterIndex;
+        std::memcpy(vectors[head].data(), instructions::getVectorRegister(registers, default_cpu_properties::registersCount,
+                                                                          operands.dstRegisterIndex),
+                    instructions::vectorSize);
+        return;
+    }
+    // Store out of memory does not retire, so entry is not used
+    const std::uint32_t target = registers[operands.dstRegisterIndex];
+    entry.kind = entry_kind::STORE_VECTOR;
+    entry.target = target;
+    if (target <= maxSupportedMemory - instructions::vectorSize)
+        memory.read(target, vectors[head].data(), instructions::vectorSize);
+}
+
+void undo_log::clear()
+{
+    head = 0;
+    size = 0;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+#include "base.h"
+#include "profiler.h"
+#include "flags.h"
+#include "guest_memory.h"
+
+// Profiling policy which keeps history of the last retired instructions for
+// basic_cpu::stepBack. Ring buffer holds one fixed-size entry per
+// instruction: its address and the register value or memory bytes it
+// overwrote, flag setting operations also keep status register. Vector
+// instructions keep overwritten vector in parallel ring, it is allocated by
+// the first of them. The oldest entries are replaced when ring is full.
+// Changes made by host between runs are not recorded.
+class undo_log {
+public:
+    static constexpr bool isEnabled = true;
+    static constexpr bool isReversible = true;
+    static constexpr std::size_t defaultCapacity = 1 << 22;
+
+    explicit undo_log(const std::size_t _capacity = defaultCapacity);
+
+    inline void onBeforeExecute(const std::uint32_t address, const instructions::decoded_instruction& operands,
+                                const cpu_register_t* const registers, const instructions::lazy_flags& flags,
+                                const guest_memory& memory)
+    {
+        constexpr std::uint32_t lastWordAddress = maxSupportedMemory - sizeof(cpu_register_t);
+
+        undo_entry& entry = entries[head];
+        entry.address = address;
+        if (instructions::isVector(operands.op)) {
+            recordVector(operands, registers, memory);
+            return;
+        }
+        if (instructions::lazy_flags::isFlagSetting(operands.op)) {
+            entry.kind = entry_kind::FLAGS_AND_REGISTER;
+            entry.registerIndex = operands.dstRegisterIndex;
+            entry.value = registers[operands.dstRegisterIndex];
+            entry.flags = flags.get();
+            return;
+        }
+        if (operands.op != instructions::operation::STORE) {
+            entry.kind = entry_kind::REGISTER;
+            entry.registerIndex = operands.dstRegisterIndex;
+            entry.value = registers[operands.dstRegisterIndex];
+            return;
+        }
+        const std::uint32_t target = instructions::getEfficientAddress(registers[operands.dstRegisterIndex],
+                                                                       operands.immediate);
+        entry.target = target;
+        if (target <= lastWordAddress) {
+            entry.kind = entry_kind::STORE_WORD;
+            entry.value = memory.readWord(target);
+        }
+        else {
+            // Store of the last memory byte, out of memory store does not retire
+            entry.kind = entry_kind::STORE_BYTE;
+            entry.value = memory.readByte(target & (maxSupportedMemory - 1));
+        }
+    }
+    inline void onExecute(const execution_event& event)
+    {
+        if (event.st < status::UNKNOWN_WARNING)
+            return;
+        head = head + 1 == entries.size() ? 0 : head + 1;
+        if (size < entries.size())
+            ++size;
+    }
+
+    // Reverts up to count last instructions, instructionPtr is set to the
+    // oldest reverted one. Returns count of reverted instructions.
+    std::uint64_t undo(const std::uint64_t count, std::uint32_t& instructionPtr, cpu_register_t* const registers,
+                       instructions::lazy_flags& flags, guest_memory& memory);
+    void clear();
+
+    inline std::size_t getCapacity() const { return entries.size(); }
+    // Count of instructions stepBack can revert
+    inline std::size_t getSize() const { return size; }
+private:
+    void recordVector(const instructions::decoded_instruction& operands, const cpu_register_t* const registers,
+                      const guest_memory& memory);
+
+    static_assert(maxSupportedMemory <= 0x10000, "addresses are kept in 16 bits");
+
+    enum class entry_kind : std::uint8_t {
+        REGISTER = 0,
+        FLAGS_AND_REGISTER,
+        STORE_WORD,
+        STORE_BYTE,
+        VECTOR_REGISTER,
+        STORE_VECTOR
+    };
+
+    struct undo_entry {
+        std::uint16_t address;
+        entry_kind kind;
+        std::uint8_t registerIndex;
+        std::uint16_t target; // address of store
+        cpu_register_t value; // overwritten register or memory
+        cpu_register_t flags; // overwritten status register
+    };
+
+    std::vector<undo_entry> entries;
+    std::vector<std::array<std::uint8_t, instructions::vectorSize>> vectors; // empty or same size as entries
+    std::size_t head; // entry of the next instruction
+    std::size_t size;
+};
@@ -0,0 +1,241 @@
+#include <memory>
+#include <vector>
+#include <cstring>
+
+#include "gtest/gtest.h"
+#include "batch_cpu.h"
+#include "batch_kernels.h"
+
+namespace {
+
+void putInstruction(std::vector<std::uint8_t>& program, const std::uint32_t address, const cpu_register_t instruction)
+{
+    if (program.size() < address + sizeof(instruction))
+        program.resize(address + sizeof(instruction));
+    std::memcpy(&program[address], &instruction, sizeof(instruction));
+}
+
+}
+
+TEST(BatchCpuTests, lanes_run_same_program_on_different_inputs)
+{
+    std::vector<std::uint8_t> program;
+    putInstruction(program, 0, 0b0101'1000'0000'0011); // mul, dst register 0, immediate value 3
+    putInstruction(program, 2, 0b0011'1000'0000'0001); // add, dst register 0, immediate value 1
+    putInstruction(program, 4, 0b0111'0000'0010'0000); // sll, dst register 0, src register 1
+    putInstruction(program, 6, 0b1011'0100'0000'0000); // xor, dst register 2, src register 0
+
+    batch_cpu batch(40, program.data(), (std::uint32_t)program.size());
+    for (std::uint32_t lane = 0; lane < batch.getLanesCount(); ++lane) {
+        batch.setRegister(lane, 0, lane);
+        batch.setRegister(lane, 1, lane == 17 ? 100 : 1); // lane 17 fails at shift
+    }
+
+    const std::vector<run_result>& results = batch.run(4);
+    for (std::uint32_t lane = 0; lane < batch.getLanesCount(); ++lane) {
+        if (lane == 17) {
+            EXPECT_EQ(results[lane].retiredInstructions, 2);
+            EXPECT_EQ(results[lane].reason, stop_reason::ERROR);
+            EXPECT_EQ(results[lane].lastStatus, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
+            EXPECT_EQ(batch.getInstructionPtr(lane), 4);
+            EXPECT_EQ(batch.getRegister(lane, 0), lane * 3 + 1);
+            continue;
+        }
+        EXPECT_EQ(results[lane].retiredInstructions, 4);
+        EXPECT_EQ(results[lane].reason, stop_reason::INSTRUCTIONS_LIMIT);
+        EXPECT_EQ(batch.getInstructionPtr(lane), 8);
+        EXPECT_EQ(batch.getRegister(lane, 0), (lane * 3 + 1) << 1);
+        EXPECT_EQ(batch.getRegister(lane, 2), (lane * 3 + 1) << 1);
+    }
+}
+
+TEST(BatchCpuTests, lanes_with_different_start_addresses_converge)
+{
+    std::vector<std::uint8_t> program;
+    for (std::uint32_t address = 0; address < 20; address += 2)
+        putInstruction(program, address, 0b0011'1000'0000'0001); // add, dst register 0, immediate value 1
+
+    batch_cpu batch(3, program.data(), (std::uint32_t)program.size());
+    batch.setInstructionPtr(1, 4);
+    batch.setInstructionPtr(2, 8);
+
+    const std::vector<run_result>& results = batch.run(5);
+    for (std::uint32_t lane = 0; lane < 3; ++lane) {
+        EXPECT_EQ(results[lane].retiredInstructions, 5);
+        EXPECT_EQ(batch.getRegister(lane, 0), 5);
+        EXPECT_EQ(batch.getInstructionPtr(lane), 10 + lane * 4);
+    }
+
+    batch.run(100); // zeroed memory after program is ld r0, r0, 0
+    for (std::uint32_t lane = 0; lane < 3; ++lane) {
+        EXPECT_EQ(results[lane].retiredInstructions, 100);
+        EXPECT_EQ(batch.getInstructionPtr(lane), 210 + lane * 4);
+    }
+}
+
+// Every lane is compared with instructions handlers executed one by one
+TEST(BatchCpuTests, lanes_match_instruction_handlers)
+{
+    const cpu_base_properties properties(default_cpu_properties{});
+    const instructions::decode_table& table = *instructions::decode_table::getTable(properties);
+    const batch_kernels::kernel_isa hostIsa = batch_kernels::getIsa();
+    const std::uint32_t programSize = 2048;
+    const std::uint32_t lanesCount = 37;
+    const std::uint64_t maxInstructions = 3000;
+
+    std::uint32_t seed = 4242;
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    for (std::uint32_t isa = 0; isa <= (std::uint32_t)hostIsa; ++isa) {
+        batch_kernels::setIsa((batch_kernels::kernel_isa)isa);
+        for (std::uint32_t program = 0; program < 8; ++program) {
+            std::vector<std::uint8_t> code;
+            for (std::uint32_t address = 0; address < programSize; address += 2) {
+                cpu_register_t instruction = (random() % 12) << 12 | (random() & 0x0fff); // only registered opcodes
+                if (((instruction >> 12) == 6 || (instruction >> 12) == 7) && random() % 8)
+                    instruction = (instruction & 0xf700) | 0x0800 | (random() & 0xf); // mostly shifts by small immediate value
+                putInstruction(code, address, instruction);
+            }
+
+            std::vector<std::uint8_t> image(maxSupportedMemory, 0);
+            std::memcpy(image.data(), code.data(), programSize);
+
+            batch_cpu batch(lanesCount, code.data(), programSize);
+            std::vector<cpu_register_t> registers(lanesCount * 8);
+            for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+                for (std::uint32_t i = 0; i < 8; ++i) {
+                    registers[lane * 8 + i] = i < 4 ? random() : random() % 20;
+                    batch.setRegister(lane, i, registers[lane * 8 + i]);
+                }
+                batch.setInstructionPtr(lane, (lane % 4) * 2);
+            }
+
+            const std::vector<run_result>& results = batch.run(maxInstructions);
+            for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+                std::vector<std::uint8_t> memory(image);
+                guest_memory memoryView(memory.data(), maxSupportedMemory);
+                cpu_register_t* const regs = &registers[lane * 8];
+                std::uint32_t pc = (lane % 4) * 2;
+                std::uint64_t retired = 0;
+                status st = status::STATUS_OK;
+                while (retired < maxInstructions) {
+                    if (pc > maxSupportedMemory - sizeof(cpu_register_t)) {
+                        st = status::OUT_OF_MEMORY_ERROR;
+                        break;
+                    }
+                    cpu_register_t instruction;
+                    std::memcpy(&instruction, &image[pc], sizeof(instruction)); // program image is not changed by stores
+                    const instructions::decoded_instruction& operands = table[instruction];
+                    if ((st = operands.handler(operands, regs, memoryView, properties)) < status::UNKNOWN_WARNING)
+                        break;
+                    pc += sizeof(cpu_register_t);
+                    ++retired;
+                }
+
+                EXPECT_EQ(results[lane].retiredInstructions, retired) << "isa " << isa << " lane " << lane;
+                EXPECT_EQ(results[lane].lastStatus, st) << "isa " << isa << " lane " << lane;
+                EXPECT_EQ(batch.getInstructionPtr(lane), pc) << "isa " << isa << " lane " << lane;
+                for (std::uint32_t i = 0; i < 8; ++i)
+                    EXPECT_EQ(batch.getRegister(lane, i), regs[i]) << "isa " << isa << " lane " << lane;
+                EXPECT_EQ(std::memcmp(batch.getMemory(lane), memory.data(), maxSupportedMemory), 0);
+            }
+        }
+    }
+    batch_kernels::setIsa(hostIsa);
+}
+
+TEST(BatchCpuTests, lanes_take_different_branches)
+{
+    const cpu_register_t program[] = {
+        0b1110'1010'0000'0100, // call, link register 2, immediate value 4
+        0b0100'1001'0000'0001, // sub, dst register 1, immediate value 1
+        0b1101'0011'1111'1111, // branch if zero flag is clear, offset -1
+        0b1100'1111'1111'1101, // jmp, offset -3
+        0b0011'1000'0000'0010, // add, dst register 0, immediate value 2
+        0b1111'0100'0000'0000, // ret, register 2
+    };
+    const std::uint32_t lanesCount = 20;
+    batch_cpu batch(lanesCount, reinterpret_cast<const std::uint8_t*>(program), sizeof(program));
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane)
+        batch.setRegister(lane, 1, lane % 7 + 1);
+
+    const std::vector<run_result>& results = batch.run(40);
+    for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+        cpu machine;
+        machine.getMemory().write(0, program, sizeof(program));
+        machine.getRegisters()[1] = lane % 7 + 1;
+        const run_result expected = machine.run(40);
+        EXPECT_EQ(results[lane].retiredInstructions, expected.retiredInstructions) << lane;
+        EXPECT_EQ(batch.getInstructionPtr(lane), machine.getInstructionPtr()) << lane;
+        EXPECT_EQ(batch.getStatusRegister(lane), machine.getStatusRegister()) << lane;
+        for (std::uint32_t i = 0; i < 8; ++i)
+            EXPECT_EQ(batch.getRegister(lane, i), machine.getRegisters()[i]) << lane;
+    }
+}
+
+// Random programs with control flow, stores are left out, because they
+// change code of cpu, but not program of batch. Targets from registers may be
+// odd and fetch vector instructions, cpu stops before them as batch lanes do.
+TEST(BatchCpuTests, lanes_match_interpreter_on_control_flow)
+{
+    const cpu_base_properties properties(default_cpu_properties{});
+    const instructions::decode_table& table = *instructions::decode_table::getTable(properties);
+    const std::uint32_t programSize = 2048;
+    const std::uint32_t lanesCount = 37;
+    const std::uint64_t maxInstructions = 3000;
+
+    std::uint32_t seed = 77;
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    for (std::uint32_t program = 0; program < 8; ++program) {
+        std::vector<std::uint8_t> code;
+        for (std::uint32_t address = 0; address < programSize; address += 2) {
+            cpu_register_t opcode = random() % 15;
+            if (opcode == 1)
+                opcode = 12 + random() % 4; // more control flow instead of st
+            cpu_register_t instruction = opcode << 12 | (random() & 0x0fff);
+            if (opcode == 6 || opcode == 7)
+                instruction = (instruction & 0xf700) | 0x0800 | (random() & 0xf); // shifts by small immediate value
+            if (opcode == 15)
+                instruction &= ~0x0100; // ret, not vector instruction
+            putInstruction(code, address, instruction);
+        }
+
+        batch_cpu batch(lanesCount, code.data(), programSize);
+        std::vector<std::unique_ptr<cpu>> machines;
+        for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+            machines.push_back(std::make_unique<cpu>());
+            machines[lane]->getMemory().write(0, code.data(), programSize);
+            for (std::uint32_t i = 0; i < 8; ++i) {
+                const cpu_register_t value = random() % 4 ? random() % (programSize + 64) : random();
+                batch.setRegister(lane, i, value);
+                machines[lane]->getRegisters()[i] = value;
+            }
+            batch.setInstructionPtr(lane, (lane % 4) * 2);
+            machines[lane]->setInstructionPtr((lane % 4) * 2);
+        }
+
+        auto isAtVector = [&code, &table](const cpu& machine) {
+            const std::uint32_t pc = machine.getInstructionPtr();
+            cpu_register_t instruction = 0;
+            if (pc + sizeof(instruction) <= programSize)
+                std::memcpy(&instruction, &code[pc], sizeof(instruction));
+            return instructions::isVector(table[instruction].op);
+        };
+        const std::vector<run_result>& results = batch.run(maxInstructions);
+        for (std::uint32_t lane = 0; lane < lanesCount; ++lane) {
+            const run_result expected = machines[lane]->runUntil(isAtVector, maxInstructions);
+            const bool isStoppedAtVector = isAtVector(*machines[lane]) && expected.retiredInstructions < maxInstructions;
+            EXPECT_EQ(results[lane].retiredInstructions, expected.retiredInstructions) << "lane " << lane;
+            if (isStoppedAtVector) {
+                EXPECT_EQ(results[lane].lastStatus, status::UNSUPPORTED_INSTRUCTION_ERROR) << "lane " << lane;
+            }
+            else {
+                EXPECT_EQ(results[lane].reason, expected.reason) << "lane " << lane;
+                EXPECT_EQ(results[lane].lastStatus, expected.lastStatus) << "lane " << lane;
+            }
+            EXPECT_EQ(batch.getInstructionPtr(lane), machines[lane]->getInstructionPtr()) << "lane " << lane;
+            EXPECT_EQ(batch.getStatusRegister(lane), machines[lane]->getStatusRegister()) << "lane " << lane;
+            for (std::uint32_t i = 0; i < 8; ++i)
+                EXPECT_EQ(batch.getRegister(lane, i), machines[lane]->getRegisters()[i]) << "lane " << lane;
+        }
+    }
+}
@@ -0,0 +1,380 @@
+#include <thread>
+#include <vector>
+#include <cstring>
+
+#include "gtest/gtest.h"
+#include "cpu.h"
+#include "decode_table.h"
+
+class CpuTests : public testing::Test {
+protected:
+    CpuTests() : testing::Test(), machine() {}
+
+    void putInstruction(const std::uint32_t address, const cpu_register_t instruction)
+    {
+        machine.getMemory().write(address, &instruction, sizeof(instruction));
+    }
+
+    cpu machine;
+    status st;
+};
+
+TEST(DecodeTableTests, table_matches_instruction_decode)
+{
+    cpu_base_properties properties;
+    auto table = instructions::decode_table::getTable(properties);
+
+    cpu_register_t opCode = 0b0011'0000'0000'0000;
+    for (cpu_register_t operands = 0; operands < 0x1000; ++operands) {
+        const instructions::decoded_instruction expected = instructions::addition::decode(operands, properties);
+        const instructions::decoded_instruction& entry = (*table)[opCode | operands];
+        EXPECT_EQ(entry.handler, expected.handler);
+        EXPECT_EQ(entry.op, expected.op);
+        EXPECT_EQ(entry.dstRegisterIndex, expected.dstRegisterIndex);
+        EXPECT_EQ(entry.srcRegisterIndex, expected.srcRegisterIndex);
+        EXPECT_EQ(entry.immediate, expected.immediate);
+    }
+}
+
+TEST(DecodeTableTests, table_is_shared_between_same_properties)
+{
+    cpu_base_properties properties;
+    EXPECT_EQ(instructions::decode_table::getTable(properties), instructions::decode_table::getTable(cpu_base_properties()));
+}
+
+// Records of one table are executed by several threads against their own state
+TEST(DecodeTableTests, decoded_records_are_shared_between_threads)
+{
+    const cpu_base_properties properties;
+    const instructions::decode_table& table = *instructions::decode_table::getDefaultTable();
+    const instructions::decoded_instruction* const program[] = {
+        &table[0b0011'1000'0000'0011], // add, dst register 0, immediate value 3
+        &table[0b0101'0000'0010'0000], // mul, dst register 0, src register 1
+        &table[0b0001'0100'0000'0000], // st, dst register 2, src register 0, immediate value 0
+    };
+    std::vector<std::thread> threads;
+    std::vector<cpu_register_t> results(8);
+    for (std::uint32_t thread = 0; thread < results.size(); ++thread) {
+        threads.emplace_back([&, thread]() {
+            guest_memory memory;
+            cpu_register_t registers[8] = { 0, (cpu_register_t)thread, 0x100 };
+            for (std::uint32_t round = 0; round < 1000; ++round)
+                for (const instructions::decoded_instruction* operands : program)
+                    operands->handler(*operands, registers, memory, properties);
+            results[thread] = memory.readWord(0x100);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    for (std::uint32_t thread = 0; thread < results.size(); ++thread) {
+        cpu_register_t expected = 0;
+        for (std::uint32_t round = 0; round < 1000; ++round)
+            expected = (cpu_register_t)((expected + 3) * thread);
+        EXPECT_EQ(results[thread], expected);
+    }
+}
+
+TEST_F(CpuTests, decode_and_execute_addition)
+{
+    putInstruction(0, 0b0011'1000'0000'0101); // add, isImmediate bit is true, dst register 0, immediate value 5
+    machine.getRegisters()[0] = 10;
+
+    EXPECT_EQ(machine.decodeInstruction(), status::STATUS_OK);
+    EXPECT_EQ(machine.executeInstruction(), status::STATUS_OK);
+    EXPECT_EQ(machine.getRegisters()[0], 15);
+}
+
+TEST_F(CpuTests, decode_and_execute_load_last_byte)
+{
+    putInstruction(2, 0b0000'0000'0100'0000); // ld, dst register 0, src register 1, immediate value 0
+    machine.getMemory().writeByte(maxSupportedMemory - 1, 170);
+    machine.getRegisters()[1] = maxSupportedMemory - 1;
+    machine.setInstructionPtr(2);
+
+    EXPECT_EQ(machine.decodeInstruction(), status::STATUS_OK);
+    EXPECT_EQ(machine.executeInstruction(), status::LAST_MEMORY_BYTE_WARNING);
+    EXPECT_EQ(machine.getRegisters()[0], 170);
+}
+
+// Default geometry uses every opcode, so only not decoded instruction is unknown
+TEST_F(CpuTests, execute_unknown_instruction)
+{
+    EXPECT_EQ(machine.executeInstruction(), status::ATTEMPT_TO_EXECUTE_UNKNOWN_INSTRUCTION);
+
+    putInstruction(0, 0b1111'0000'0000'0000); // ret, src register 0
+    EXPECT_EQ(machine.decodeInstruction(), status::STATUS_OK);
+}
+
+TEST_F(CpuTests, run_stops_on_instructions_limit)
+{
+    putInstruction(0, 0b0011'1000'0000'0001); // add, dst register 0, immediate value 1
+    putInstruction(2, 0b0011'1000'0000'0001);
+    putInstruction(4, 0b0011'1000'0000'0001);
+
+    run_result result = machine.run(2);
+    EXPECT_EQ(result.retiredInstructions, 2);
+    EXPECT_EQ(result.reason, stop_reason::INSTRUCTIONS_LIMIT);
+    EXPECT_EQ(result.lastStatus, status::STATUS_OK);
+    EXPECT_EQ(machine.getRegisters()[0], 2);
+    EXPECT_EQ(machine.getInstructionPtr(), 4);
+}
+
+TEST_F(CpuTests, run_stops_on_error)
+{
+    putInstruction(0, 0b0011'1000'0000'0001); // add, dst register 0, immediate value 1
+    putInstruction(2, 0b0110'1000'0001'1000); // srl, dst register 0, immediate value 24
+
+    run_result result = machine.run(10);
+    EXPECT_EQ(result.retiredInstructions, 1);
+    EXPECT_EQ(result.reason, stop_reason::ERROR);
+    EXPECT_EQ(result.lastStatus, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
+    EXPECT_EQ(machine.getInstructionPtr(), 2);
+}
+
+TEST_F(CpuTests, run_stops_at_end_of_memory)
+{
+    machine.setInstructionPtr(maxSupportedMemory - 4); // two zero words are ld r0, [r0 + 0]
+
+    run_result result = machine.run(10);
+    EXPECT_EQ(result.retiredInstructions, 2);
+    EXPECT_EQ(result.reason, stop_reason::END_OF_MEMORY);
+    EXPECT_EQ(result.lastStatus, status::OUT_OF_MEMORY_ERROR);
+}
+
+TEST_F(CpuTests, run_until_predicate)
+{
+    for (std::uint32_t address = 0; address < 20; address += 2)
+        putInstruction(address, 0b0011'1000'0000'0011); // add, dst register 0, immediate value 3
+
+    run_result result = machine.runUntil([](const cpu& machine) { return machine.getRegisters()[0] >= 9; });
+    EXPECT_EQ(result.retiredInstructions, 3);
+    EXPECT_EQ(result.reason, stop_reason::PREDICATE);
+    EXPECT_EQ(machine.getInstructionPtr(), 6);
+}
+
+// Counting loop, then call of subroutine and jump over it
+const cpu_register_t loopProgram[] = {
+    0b0010'0000'0000'1010, // ldi lower, dst register 0, immediate value 10
+    0b0010'0010'0000'0000, // ldi lower, dst register 1, immediate value 0
+    0b0011'1001'0000'0011, // add, dst register 1, immediate value 3
+    0b0100'1000'0000'0001, // sub, dst register 0, immediate value 1
+    0b1101'0011'1111'1110, // br if zero flag is clear, offset -2
+    0b1110'1111'0000'0010, // call, link register 7, offset 2
+    0b1100'0000'0000'0011, // jmp, offset 3
+    0b0010'0100'0101'0101, // ldi lower, dst register 2, immediate value 0x55
+    0b1111'1110'0000'0000, // ret, src register 7
+    0b1000'0110'0000'0000, // not, dst register 3
+};
+constexpr std::uint64_t loopProgramInstructions = 2 + 10 * 3 + 5;
+
+TEST_F(CpuTests, run_loop_and_call)
+{
+    machine.getMemory().write(0, loopProgram, sizeof(loopProgram));
+
+    run_result result = machine.run(loopProgramInstructions);
+    EXPECT_EQ(result.retiredInstructions, loopProgramInstructions);
+    EXPECT_EQ(machine.getInstructionPtr(), sizeof(loopProgram));
+    EXPECT_EQ(machine.getRegisters()[0], 0);
+    EXPECT_EQ(machine.getRegisters()[1], 30);
+    EXPECT_EQ(machine.getRegisters()[2], 0x55);
+    EXPECT_EQ(machine.getRegisters()[3], 0xffff);
+    EXPECT_EQ(machine.getRegisters()[7], 12);
+}
+
+TEST_F(CpuTests, step_by_step_loop_and_call)
+{
+    machine.getMemory().write(0, loopProgram, sizeof(loopProgram));
+
+    for (std::uint64_t retired = 0; retired < loopProgramInstructions; ++retired) {
+        ASSERT_EQ(machine.decodeInstruction(), status::STATUS_OK);
+        ASSERT_EQ(machine.executeInstruction(), status::STATUS_OK);
+        machine.setInstructionPtr(machine.getInstructionPtr() + sizeof(cpu_register_t));
+    }
+    EXPECT_EQ(machine.getInstructionPtr(), sizeof(loopProgram));
+    EXPECT_EQ(machine.getRegisters()[1], 30);
+    EXPECT_EQ(machine.getRegisters()[7], 12);
+}
+
+TEST(CpuResetTests, reset_cpu_matches_new_cpu)
+{
+    const cpu_register_t program[] = {
+        0b0011'1000'0000'0011, // add, dst register 0, immediate value 3
+        0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+        0b0100'1011'0000'0001, // sub, dst register 3, immediate value 1
+    };
+    for (const execution_tier tier : { execution_tier::INTERPRETER, execution_tier::JIT }) {
+        cpu machine(tier);
+        machine.setFusionTable(instructions::fusion_table::getDefault());
+        for (std::uint32_t round = 0; round < 3; ++round) {
+            machine.getMemory().write(0x100, program, sizeof(program));
+            machine.getRegisters()[1] = 0x8000 + round * 0x1000;
+            machine.setInstructionPtr(0x100);
+            ASSERT_EQ(machine.run(3).retiredInstructions, 3);
+            EXPECT_EQ(machine.getMemory().readWord(0x8000 + round * 0x1000), 3);
+            EXPECT_EQ(machine.getStatusRegister(), instructions::NEGATIVE_FLAG | instructions::CARRY_FLAG);
+
+            machine.reset();
+            cpu reference;
+            EXPECT_EQ(machine.getInstructionPtr(), 0);
+            EXPECT_EQ(machine.getStatusRegister(), 0);
+            for (std::uint32_t i = 0; i < cpu::geometry::registersCount; ++i)
+                EXPECT_EQ(machine.getRegisters()[i], 0);
+            EXPECT_TRUE(machine.getMemory() == reference.getMemory());
+        }
+    }
+}
+
+TEST(CpuResetTests, reset_clears_step_back_history)
+{
+    reversible_cpu machine;
+    machine.getMemory().writeWord(0, 0b0011'1000'0000'0001); // add, dst register 0, immediate value 1
+    machine.run(1);
+    machine.reset();
+    EXPECT_EQ(machine.stepBack(1), 0);
+    EXPECT_EQ(machine.getProfiler().getSize(), 0);
+}
+
+// Random straight-line programs are executed by run loop and by
+// decode/execute pair, results have to be the same
+TEST(CpuRunTests, run_matches_step_by_step_execution)
+{
+    std::uint32_t seed = 12345;
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    const std::uint32_t programSize = 4096;
+    for (std::uint32_t program = 0; program < 32; ++program) {
+        cpu machine, reference;
+        for (std::uint32_t address = 0; address < programSize; address += 2) {
+            cpu_register_t instruction = (random() % 12) << 12 | (random() & 0x0fff); // only registered opcodes
+            if ((instruction >> 12) == 6 || (instruction >> 12) == 7)
+                instruction = (instruction & 0xf700) | 0x0800 | (random() & 0xf); // shifts by small immediate value
+            machine.getMemory().write(address, &instruction, sizeof(instruction));
+            reference.getMemory().write(address, &instruction, sizeof(instruction));
+        }
+        for (std::uint32_t i = 0; i < 8; ++i)
+            machine.getRegisters()[i] = reference.getRegisters()[i] = random();
+
+        run_result result = machine.run(programSize / 2);
+
+        std::uint64_t retired = 0;
+        status st = status::STATUS_OK;
+        while (retired < programSize / 2) {
+            if ((st = reference.decodeInstruction()) < status::UNKNOWN_WARNING)
+                break;
+            if ((st = reference.executeInstruction()) < status::UNKNOWN_WARNING)
+                break;
+            reference.setInstructionPtr(reference.getInstructionPtr() + sizeof(cpu_register_t));
+            ++retired;
+        }
+
+        EXPECT_EQ(result.retiredInstructions, retired);
+        EXPECT_EQ(result.lastStatus, st);
+        EXPECT_EQ(machine.getInstructionPtr(), reference.getInstructionPtr());
+        for (std::uint32_t i = 0; i < 8; ++i)
+            EXPECT_EQ(machine.getRegisters()[i], reference.getRegisters()[i]);
+        EXPECT_TRUE(machine.getMemory() == reference.getMemory());
+    }
+}
+
+namespace {
+
+// Sum of two vectors and mask of lanes where the first one is zero
+const cpu_register_t vectorProgram[] = {
+    0b1111'0011'1100'0000, // vld, vector 0, address register 1
+    0b1111'0101'1100'1000, // vld, vector 1, address register 2
+    0b1111'0001'0000'0010, // vadd, dst vector 0, src vector 1
+    0b1111'0111'1110'0000, // vst, vector 0, address register 3
+    0b1111'0001'1010'1000, // vcmpeq, dst vector 1, src vector 0
+    0b1111'1001'1110'1000, // vst, vector 1, address register 4
+    0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+};
+
+template <typename Machine>
+void setUpVectorProgram(Machine& machine)
+{
+    machine.getMemory().write(0, vectorProgram, sizeof(vectorProgram));
+    for (std::uint32_t lane = 0; lane < instructions::vectorSize; ++lane) {
+        machine.getMemory().writeByte(0x1000 + lane, lane % 3 ? lane * 17 : 0);
+        machine.getMemory().writeByte(0x1010 + lane, 0xf0 + lane);
+    }
+    machine.getRegisters()[1] = 0x1000;
+    machine.getRegisters()[2] = 0x1010;
+    machine.getRegisters()[3] = 0x2000;
+    machine.getRegisters()[4] = 0x2010;
+}
+
+template <typename Machine>
+void expectVectorProgramResult(const Machine& machine)
+{
+    for (std::uint32_t lane = 0; lane < instructions::vectorSize; ++lane) {
+        const std::uint8_t first = lane % 3 ? lane * 17 : 0;
+        const std::uint8_t sum = first + 0xf0 + lane;
+        EXPECT_EQ(machine.getMemory().readByte(0x2000 + lane), sum) << lane;
+        EXPECT_EQ(machine.getMemory().readByte(0x2010 + lane), first ? 0x00 : 0xff) << lane;
+        EXPECT_EQ(machine.getVectorRegister(0)[lane], sum);
+    }
+    EXPECT_EQ(machine.getRegisters()[0], 1);
+}
+
+constexpr std::uint64_t vectorProgramInstructions = sizeof(vectorProgram) / sizeof(cpu_register_t);
+
+}
+
+TEST(VectorRunTests, run_vector_program)
+{
+    for (const execution_tier tier : { execution_tier::INTERPRETER, execution_tier::JIT }) {
+        cpu machine(tier);
+        setUpVectorProgram(machine);
+        EXPECT_EQ(machine.run(vectorProgramInstructions).retiredInstructions, vectorProgramInstructions);
+        expectVectorProgramResult(machine);
+
+        std::unique_ptr<cpu> copy = machine.clone();
+        EXPECT_EQ(std::memcmp(copy->getVectorRegister(0), machine.getVectorRegister(0),
+                              instructions::vectorRegistersCount * instructions::vectorSize), 0);
+        machine.reset();
+        for (std::uint32_t lane = 0; lane < instructions::vectorSize; ++lane)
+            EXPECT_EQ(machine.getVectorRegister(1)[lane], 0);
+    }
+}
+
+TEST(VectorRunTests, step_by_step_vector_program)
+{
+    cpu machine;
+    setUpVectorProgram(machine);
+    for (std::uint64_t retired = 0; retired < vectorProgramInstructions; ++retired) {
+        ASSERT_EQ(machine.decodeInstruction(), status::STATUS_OK);
+        ASSERT_EQ(machine.executeInstruction(), status::STATUS_OK);
+        machine.setInstructionPtr(machine.getInstructionPtr() + sizeof(cpu_register_t));
+    }
+    expectVectorProgramResult(machine);
+}
+
+TEST(VectorRunTests, step_back_reverts_vector_instructions)
+{
+    reversible_cpu machine;
+    setUpVectorProgram(machine);
+    ASSERT_EQ(machine.run(vectorProgramInstructions).retiredInstructions, vectorProgramInstructions);
+    expectVectorProgramResult(machine);
+
+    EXPECT_EQ(machine.stepBack(vectorProgramInstructions), vectorProgramInstructions);
+    EXPECT_EQ(machine.getInstructionPtr(), 0);
+    for (std::uint32_t lane = 0; lane < instructions::vectorSize; ++lane) {
+        EXPECT_EQ(machine.getMemory().readByte(0x2000 + lane), 0);
+        EXPECT_EQ(machine.getMemory().readByte(0x2010 + lane), 0);
+        EXPECT_EQ(machine.getVectorRegister(0)[lane], 0);
+        EXPECT_EQ(machine.getVectorRegister(1)[lane], 0);
+    }
+    EXPECT_EQ(machine.run(vectorProgramInstructions).retiredInstructions, vectorProgramInstructions);
+    expectVectorProgramResult(machine);
+}
+
+TEST(VectorRunTests, vector_store_out_of_memory_stops_run)
+{
+    cpu machine;
+    machine.getMemory().writeWord(0, 0b1111'0111'1110'0000); // vst, vector 0, address register 3
+    machine.getRegisters()[3] = 0xfff8;
+    run_result result = machine.run(1);
+    EXPECT_EQ(result.reason, stop_reason::ERROR);
+    EXPECT_EQ(result.lastStatus, status::OUT_OF_MEMORY_ERROR);
+    EXPECT_EQ(machine.getInstructionPtr(), 0);
+}
@@ -0,0 +1,81 @@
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "event_log.h"
+#include "cpu.h"
+
+class EventLogTests : public testing::Test {
+protected:
+    event_log::sink makeSink()
+    {
+        return [this](const std::string& line) {
+            std::lock_guard<std::mutex> lock(linesMutex);
+            lines.push_back(line);
+        };
+    }
+
+    std::mutex linesMutex;
+    std::vector<std::string> lines;
+};
+
+TEST_F(EventLogTests, formats_records_of_every_thread)
+{
+    event_log log(makeSink(), 1000);
+    std::vector<std::thread> threads;
+    for (std::uint32_t thread = 0; thread < 4; ++thread)
+        threads.emplace_back([&log, thread]() {
+            for (std::uint32_t index = 0; index < 50; ++index)
+                log.push(log_record::make("test::push", status::OUT_OF_MEMORY_ERROR, thread * 0x100 + index));
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+
+    instructions::decoded_instruction operands = { nullptr, instructions::operation::ADD_IMMEDIATE, 1, 0, 5 };
+    log.push(log_record::make("test::operands", status::LAST_MEMORY_BYTE_WARNING, 0x10, operands));
+    log.flush();
+
+    ASSERT_EQ(lines.size(), 201);
+    EXPECT_EQ(lines[0].rfind("Error: test::push, code - ", 0), 0);
+    EXPECT_EQ(lines.back(), "Warning: test::operands, code - -499 LAST_MEMORY_BYTE_WARNING, pc 0x0010, "
+                            "op 6, dst 1, src 0, immediate 5");
+    EXPECT_EQ(log.getDroppedCount(), 0);
+}
+
+TEST_F(EventLogTests, rate_limits_repeated_records)
+{
+    {
+        event_log log(makeSink(), 10);
+        for (std::uint32_t index = 0; index < 1000; ++index)
+            log.push(log_record::make("test::repeated", status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH));
+        log.push(log_record::make("test::other", status::UNKNOWN_ERROR));
+        log.flush();
+        EXPECT_EQ(lines.size(), 11);
+        EXPECT_EQ(log.getSuppressedCount(), 990);
+    }
+    // Suppressed records are reported when log is destroyed
+    ASSERT_EQ(lines.size(), 12);
+    EXPECT_NE(lines.back().find("990 more records of test::repeated"), std::string::npos);
+}
+
+TEST_F(EventLogTests, full_ring_drops_records)
+{
+    event_log log(makeSink(), 1000000, 16);
+    std::uint32_t pushed = 0;
+    for (; pushed < 100000 && !log.getDroppedCount(); ++pushed)
+        log.push(log_record::make("test::overflow", status::UNKNOWN_ERROR));
+    log.flush();
+    EXPECT_GT(log.getDroppedCount(), 0);
+    EXPECT_EQ(lines.size() - 1 + log.getDroppedCount(), pushed);
+    EXPECT_NE(lines.back().find("records dropped"), std::string::npos);
+}
+
+TEST(CpuLogTests, step_errors_go_to_default_log)
+{
+    cpu machine;
+    machine.setInstructionPtr(maxSupportedMemory - 1);
+    EXPECT_EQ(machine.decodeInstruction(), status::OUT_OF_MEMORY_ERROR);
+    event_log::getDefault().flush();
+}
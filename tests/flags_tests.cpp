@@ -0,0 +1,225 @@
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "flags.h"
+#include "fusion.h"
+#include "cpu.h"
+
+using instructions::operation;
+using instructions::lazy_flags;
+
+namespace {
+
+constexpr std::uint32_t programLength = 0x1000;
+
+// Flags computed right away from wide results, independent of lazy_flags
+cpu_register_t eagerFlags(const operation op, const cpu_register_t left, const cpu_register_t right)
+{
+    const std::int64_t signedLeft = (std::int16_t)left;
+    const std::int64_t signedRight = (std::int16_t)right;
+    std::int64_t wide = 0;
+    std::int64_t signedWide = 0;
+    bool isCarry = false;
+    switch (op) {
+    case operation::ADD_REGISTER:
+    case operation::ADD_IMMEDIATE:
+        wide = (std::int64_t)left + right;
+        signedWide = signedLeft + signedRight;
+        isCarry = wide > 0xffff;
+        break;
+    case operation::SUB_REGISTER:
+    case operation::SUB_IMMEDIATE:
+        wide = (std::int64_t)left - right;
+        signedWide = signedLeft - signedRight;
+        isCarry = wide < 0;
+        break;
+    case operation::MUL_REGISTER:
+    case operation::MUL_IMMEDIATE:
+        wide = (std::int64_t)left * right;
+        signedWide = signedLeft * signedRight;
+        isCarry = wide > 0xffff;
+        break;
+    case operation::SRL_REGISTER:
+    case operation::SRL_IMMEDIATE:
+        wide = (std::int64_t)left >> right;
+        signedWide = (std::int16_t)wide;
+        isCarry = right && ((std::int64_t)left >> (right - 1)) & 0x1;
+        break;
+    default:
+        wide = (std::int64_t)left << right;
+        signedWide = (std::int16_t)wide;
+        isCarry = (wide >> 16) & 0x1;
+        break;
+    }
+    const cpu_register_t result = (cpu_register_t)wide;
+    cpu_register_t bits = 0;
+    if (result == 0)
+        bits |= instructions::ZERO_FLAG;
+    if (result & 0x8000)
+        bits |= instructions::NEGATIVE_FLAG;
+    if (isCarry)
+        bits |= instructions::CARRY_FLAG;
+    if (signedWide < INT16_MIN || signedWide > INT16_MAX)
+        bits |= instructions::OVERFLOW_FLAG;
+    return bits;
+}
+
+// Random add, sub, mul and shifts, shifts by register use small amounts
+std::vector<cpu_register_t> makeProgram(const std::uint32_t seed)
+{
+    std::mt19937 random(seed);
+    std::vector<cpu_register_t> program;
+    for (std::uint32_t index = 0; index < programLength; ++index) {
+        const cpu_register_t opcode = 3 + random() % 5; // add, sub, mul, srl, sll
+        const cpu_register_t dst = random() % 8;
+        const cpu_register_t isImmediate = opcode >= 6 || random() % 2;
+        cpu_register_t operand = random() % 256;
+        if (opcode >= 6)
+            operand %= 17;
+        else if (!isImmediate)
+            operand = (random() % 8) << 5;
+        program.push_back(opcode << 12 | isImmediate << 11 | dst << 8 | operand);
+    }
+    return program;
+}
+
+void setUp(cpu& machine, const std::vector<cpu_register_t>& program)
+{
+    machine.getMemory().write(0, program.data(), program.size() * sizeof(cpu_register_t));
+    for (std::uint32_t index = 0; index < cpu::geometry::registersCount; ++index)
+        machine.getRegisters()[index] = 0x1111 * index + 0x7ff0;
+}
+
+}
+
+TEST(FlagsTests, lazy_flags_match_eager_flags)
+{
+    const operation operations[] = { operation::ADD_REGISTER, operation::SUB_REGISTER, operation::MUL_REGISTER,
+                                     operation::SRL_REGISTER, operation::SLL_REGISTER };
+    const cpu_register_t values[] = { 0x0, 0x1, 0x2, 0x7f, 0xff, 0x7fff, 0x8000, 0x8001, 0xfffe, 0xffff, 0x1234, 0xabcd };
+    for (const operation op : operations) {
+        for (const cpu_register_t left : values) {
+            for (const cpu_register_t right : values) {
+                cpu_register_t result;
+                if (op == operation::ADD_REGISTER)
+                    result = left + right;
+                else if (op == operation::SUB_REGISTER)
+                    result = left - right;
+                else if (op == operation::MUL_REGISTER)
+                    result = left * right;
+                else if (right > 16)
+                    continue;
+                else
+                    result = op == operation::SRL_REGISTER ? left >> right : left << right;
+                lazy_flags flags = { operation::UNKNOWN, 0, 0, 0 };
+                flags.set(op, left, right, result);
+                EXPECT_EQ(flags.get(), eagerFlags(op, left, right)) << (int)op << " " << left << " " << right;
+            }
+        }
+    }
+}
+
+TEST(FlagsTests, interpreter_flags_match_eager_flags)
+{
+    const std::vector<cpu_register_t> program = makeProgram(1);
+    cpu machine;
+    setUp(machine, program);
+    machine.setStatusRegister(0xf);
+    const std::shared_ptr<const instructions::decode_table> table = instructions::decode_table::getTable(default_cpu_properties());
+    for (std::uint32_t index = 0; index < programLength; ++index) {
+        const instructions::decoded_instruction& operands = (*table)[program[index]];
+        const cpu_register_t left = machine.getRegisters()[operands.dstRegisterIndex];
+        const cpu_register_t right = lazy_flags::getRightOperand(operands, machine.getRegisters());
+        ASSERT_EQ(machine.run(1).retiredInstructions, 1);
+        EXPECT_EQ(machine.getStatusRegister(), eagerFlags(operands.op, left, right));
+    }
+}
+
+TEST(FlagsTests, failed_and_non_flag_instructions_keep_flags)
+{
+    cpu machine;
+    machine.getMemory().writeWord(0, 0b0111'0000'0010'0000); // sll, dst register 0, src register 1
+    machine.getMemory().writeWord(2, 0b1000'0000'0000'0000); // not, dst register 0
+    machine.getRegisters()[1] = 17;
+    machine.setStatusRegister(instructions::CARRY_FLAG);
+    EXPECT_EQ(machine.run(1).reason, stop_reason::ERROR);
+    EXPECT_EQ(machine.getStatusRegister(), instructions::CARRY_FLAG);
+
+    machine.setInstructionPtr(2);
+    EXPECT_EQ(machine.run(1).retiredInstructions, 1);
+    EXPECT_EQ(machine.getStatusRegister(), instructions::CARRY_FLAG);
+}
+
+TEST(FlagsTests, step_by_step_execution_sets_flags)
+{
+    cpu machine;
+    machine.getMemory().writeWord(0, 0b0100'1000'0000'0001); // sub, dst register 0, immediate value 1
+    EXPECT_EQ(machine.decodeInstruction(), status::STATUS_OK);
+    EXPECT_EQ(machine.executeInstruction(), status::STATUS_OK);
+    EXPECT_EQ(machine.getStatusRegister(), instructions::NEGATIVE_FLAG | instructions::CARRY_FLAG);
+}
+
+TEST(FlagsTests, jit_run_matches_interpreter)
+{
+    const std::vector<cpu_register_t> program = makeProgram(2);
+    for (const std::uint64_t count : { 1, 2, 3, 63, 64, 65, 100, 1000, 4096 }) {
+        cpu interpreted;
+        cpu translated(execution_tier::JIT);
+        setUp(interpreted, program);
+        setUp(translated, program);
+        interpreted.runUntil([](const cpu&) { return false; }, count);
+        translated.run(count);
+        EXPECT_EQ(translated.getStatusRegister(), interpreted.getStatusRegister()) << count;
+        for (std::uint32_t index = 0; index < cpu::geometry::registersCount; ++index)
+            EXPECT_EQ(translated.getRegisters()[index], interpreted.getRegisters()[index]);
+    }
+}
+
+TEST(FlagsTests, fused_run_matches_interpreter)
+{
+    const cpu_register_t program[] = {
+        0b0010'0100'1111'1111, // ldi lower, dst register 2, immediate value 0xff
+        0b0011'0011'0100'0000, // add, dst register 3, src register 2
+        0b0000'0000'0100'0000, // ld, dst register 0, src register 1, immediate value 0
+        0b0011'0000'0000'0000, // add, dst register 0, src register 0
+        0b0100'1011'0000'0001, // sub, dst register 3, immediate value 1
+        0b1101'1000'0000'0001, // br if carry flag is set, offset 1
+    };
+    cpu interpreted;
+    cpu fused;
+    fused.setFusionTable(instructions::fusion_table::getDefault());
+    for (cpu* machine : { &interpreted, &fused }) {
+        machine->getMemory().write(0, program, sizeof(program));
+        machine->getMemory().writeWord(0x8000, 0x8000);
+        machine->getRegisters()[1] = 0x8000;
+        machine->getRegisters()[3] = 1;
+    }
+    for (std::uint32_t pair = 0; pair < 3; ++pair) {
+        interpreted.runUntil([](const cpu&) { return false; }, 2);
+        fused.run(2);
+        EXPECT_EQ(fused.getStatusRegister(), interpreted.getStatusRegister());
+        EXPECT_EQ(fused.getInstructionPtr(), interpreted.getInstructionPtr());
+    }
+    EXPECT_EQ(fused.getFusionCount(instructions::operation::FUSED_LOAD_IMMEDIATE_ADD), 1);
+    EXPECT_EQ(fused.getFusionCount(instructions::operation::FUSED_LOAD_ADD), 1);
+    EXPECT_EQ(fused.getFusionCount(instructions::operation::FUSED_SUB_BRANCH), 1);
+}
+
+TEST(FlagsTests, step_back_and_clone_keep_flags)
+{
+    const std::vector<cpu_register_t> program = makeProgram(3);
+    reversible_cpu machine;
+    machine.getMemory().write(0, program.data(), program.size() * sizeof(cpu_register_t));
+    std::vector<cpu_register_t> history;
+    for (std::uint32_t index = 0; index < 32; ++index) {
+        history.push_back(machine.getStatusRegister());
+        machine.run(1);
+    }
+    std::unique_ptr<reversible_cpu> copy = machine.clone();
+    EXPECT_EQ(copy->getStatusRegister(), machine.getStatusRegister());
+    for (std::uint32_t index = 32; index > 0; --index) {
+        EXPECT_EQ(machine.stepBack(1), 1);
+        EXPECT_EQ(machine.getStatusRegister(), history[index - 1]);
+    }
+}
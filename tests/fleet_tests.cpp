@@ -0,0 +1,86 @@
+#include <vector>
+#include <mutex>
+#include <cstring>
+
+#include "gtest/gtest.h"
+#include "cpu_fleet.h"
+
+namespace {
+
+std::vector<std::uint8_t> makeProgram(const std::uint32_t size, std::uint32_t seed)
+{
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    std::vector<std::uint8_t> program(size);
+    for (std::uint32_t address = 0; address + 1 < size; address += 2) {
+        cpu_register_t instruction = (random() % 12) << 12 | (random() & 0x0fff); // only registered opcodes
+        if ((instruction >> 12) == 6 || (instruction >> 12) == 7)
+            instruction = (instruction & 0xf700) | 0x0800 | (random() & 0xf); // shifts by small immediate value
+        std::memcpy(&program[address], &instruction, sizeof(instruction));
+    }
+    return program;
+}
+
+}
+
+TEST(CpuFleetTests, results_match_single_cpu_runs)
+{
+    std::vector<std::vector<std::uint8_t>> programs;
+    for (std::uint32_t program = 0; program < 16; ++program)
+        programs.push_back(makeProgram(256 + program * 128, program + 1));
+
+    cpu_fleet fleet(4, 100);
+    std::vector<fleet_job> jobs;
+    for (std::uint32_t job = 0; job < 200; ++job) {
+        const std::vector<std::uint8_t>& program = programs[job % programs.size()];
+        jobs.push_back({ program.data(), (std::uint32_t)program.size(), job % 8 * 2, job % 8 * 2, job * 37 % 1500 });
+        EXPECT_EQ(fleet.addJob(jobs.back()), job);
+    }
+    fleet_stats stats = fleet.run();
+
+    std::uint64_t retired = 0;
+    for (std::size_t job = 0; job < jobs.size(); ++job) {
+        cpu reference;
+        reference.getMemory().write(jobs[job].loadAddress, jobs[job].image, jobs[job].imageSize);
+        reference.setInstructionPtr(jobs[job].entry);
+        run_result result = reference.run(jobs[job].maxInstructions);
+        retired += result.retiredInstructions;
+
+        const fleet_job_result& jobResult = fleet.getResults()[job];
+        EXPECT_EQ(jobResult.result.retiredInstructions, result.retiredInstructions);
+        EXPECT_EQ(jobResult.result.reason, result.reason);
+        EXPECT_EQ(jobResult.result.lastStatus, result.lastStatus);
+        EXPECT_EQ(jobResult.instructionPtr, reference.getInstructionPtr());
+        for (std::uint32_t i = 0; i < cpu::geometry::registersCount; ++i)
+            EXPECT_EQ(jobResult.registers[i], reference.getRegisters()[i]);
+    }
+    EXPECT_EQ(stats.retiredInstructions, retired);
+}
+
+TEST(CpuFleetTests, long_job_is_time_sliced)
+{
+    // zeroed memory is ld r0, r0, 0, so every job runs until its budget ends
+    const std::uint8_t image[2] = {};
+    cpu_fleet fleet(1, 1000);
+    fleet.addJob({ image, sizeof(image), 0, 0, 30000 });
+    for (std::uint32_t job = 0; job < 3; ++job)
+        fleet.addJob({ image, sizeof(image), 0, 0, 2000 });
+
+    std::mutex lock;
+    std::vector<std::size_t> completed;
+    fleet.setCompletionHandler([&](const std::size_t job, const cpu& machine) {
+        std::lock_guard<std::mutex> guard(lock);
+        completed.push_back(job);
+        EXPECT_EQ(machine.getInstructionPtr(), fleet.getResults()[job].result.retiredInstructions * 2);
+    });
+    fleet.run();
+
+    ASSERT_EQ(completed.size(), 4);
+    EXPECT_EQ(completed.back(), 0);
+    EXPECT_EQ(fleet.getResults()[0].result.retiredInstructions, 30000);
+
+    // jobs added later are run by the next call
+    fleet.addJob({ image, sizeof(image), 0, 0, 10 });
+    fleet_stats stats = fleet.run();
+    EXPECT_EQ(stats.retiredInstructions, 10);
+    EXPECT_EQ(completed.size(), 5);
+}
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+#include "fusion.h"
+#include "cpu.h"
+
+using instructions::operation;
+using instructions::fusion_table;
+
+namespace {
+
+const cpu_register_t program[] = {
+    0b0010'0100'0011'0100, // ldi lower, dst register 2, immediate value 0x34
+    0b0010'0101'0001'0010, // ldi upper, dst register 2, immediate value 0x12
+    0b0010'1010'0111'1111, // ldi lower, dst register 5, immediate value 0x7f
+    0b0011'0110'1010'0000, // add, dst register 6, src register 5
+    0b0000'0000'0100'0000, // ld, dst register 0, src register 1, immediate value 0
+    0b0011'0011'0000'0000, // add, dst register 3, src register 0
+    0b0011'1001'0000'0010, // add, dst register 1, immediate value 2
+    0b0100'1100'0000'0001, // sub, dst register 4, immediate value 1
+    0b1101'0011'1111'1000, // br if zero flag is clear, offset -8
+    0b0011'1111'0000'0001, // add, dst register 7, immediate value 1
+};
+constexpr std::uint32_t iterations = 10;
+constexpr std::uint32_t passInstructions = 9 * iterations + 1;
+
+void setUp(cpu& machine)
+{
+    machine.getMemory().write(0, program, sizeof(program));
+    for (std::uint32_t index = 0; index < iterations; ++index)
+        machine.getMemory().writeWord(0x8000 + index * sizeof(cpu_register_t), 0x1111 * (index + 1));
+    machine.getRegisters()[1] = 0x8000;
+    machine.getRegisters()[4] = iterations;
+}
+
+void expectSameState(const cpu& expected, const cpu& actual)
+{
+    EXPECT_EQ(expected.getInstructionPtr(), actual.getInstructionPtr());
+    EXPECT_EQ(expected.getStatusRegister(), actual.getStatusRegister());
+    for (std::uint32_t index = 0; index < cpu::geometry::registersCount; ++index)
+        EXPECT_EQ(expected.getRegisters()[index], actual.getRegisters()[index]);
+    EXPECT_TRUE(expected.getMemory() == actual.getMemory());
+}
+
+}
+
+TEST(FusionTests, fused_run_matches_unfused_run)
+{
+    cpu fused;
+    cpu plain;
+    fused.setFusionTable(fusion_table::getDefault());
+    setUp(fused);
+    setUp(plain);
+    EXPECT_EQ(fused.run(passInstructions).retiredInstructions, passInstructions);
+    EXPECT_EQ(plain.run(passInstructions).retiredInstructions, passInstructions);
+    expectSameState(plain, fused);
+    EXPECT_EQ(fused.getInstructionPtr(), sizeof(program));
+    EXPECT_EQ(fused.getRegisters()[2], 0x1234);
+
+    EXPECT_EQ(fused.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_PAIR), iterations);
+    EXPECT_EQ(fused.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_ADD), iterations);
+    EXPECT_EQ(fused.getFusionCount(operation::FUSED_LOAD_ADD), iterations);
+    EXPECT_EQ(fused.getFusionCount(operation::FUSED_SUB_BRANCH), iterations);
+    EXPECT_EQ(fused.getFusionCount(operation::ADD_REGISTER), 0);
+    EXPECT_EQ(plain.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_PAIR), 0);
+
+    // Budget which ends inside of pair is not exceeded
+    fused.reset();
+    plain.reset();
+    EXPECT_EQ(fused.getFusionCount(operation::FUSED_SUB_BRANCH), 0);
+    setUp(fused);
+    setUp(plain);
+    for (std::uint32_t step = 0; step < passInstructions / 7; ++step) {
+        EXPECT_EQ(fused.run(7).retiredInstructions, 7);
+        EXPECT_EQ(plain.run(7).retiredInstructions, 7);
+        expectSameState(plain, fused);
+    }
+    EXPECT_GT(fused.getFusionCount(operation::FUSED_SUB_BRANCH), 0);
+}
+
+TEST(FusionTests, table_enables_only_listed_pairs)
+{
+    cpu machine;
+    machine.setFusionTable(std::make_shared<const fusion_table>(std::vector<operation>{ operation::FUSED_LOAD_IMMEDIATE_PAIR }));
+    setUp(machine);
+    machine.run(passInstructions);
+    EXPECT_EQ(machine.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_PAIR), iterations);
+    EXPECT_EQ(machine.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_ADD), 0);
+    EXPECT_EQ(machine.getFusionCount(operation::FUSED_SUB_BRANCH), 0);
+    EXPECT_STREQ(fusion_table::getName(operation::FUSED_SUB_BRANCH), "sub+branch");
+
+    // Load at the last memory word runs alone through its handler
+    cpu edge;
+    edge.setFusionTable(fusion_table::getDefault());
+    setUp(edge);
+    edge.getRegisters()[1] = 0xffff;
+    edge.setInstructionPtr(4 * sizeof(cpu_register_t));
+    run_result result = edge.run(1);
+    EXPECT_EQ(result.retiredInstructions, 1);
+    EXPECT_EQ(result.lastStatus, status::LAST_MEMORY_BYTE_WARNING);
+    EXPECT_EQ(edge.getFusionCount(operation::FUSED_LOAD_ADD), 0);
+
+    // JIT tier ignores the table
+    cpu translated(execution_tier::JIT);
+    translated.setFusionTable(fusion_table::getDefault());
+    setUp(translated);
+    EXPECT_EQ(translated.run(passInstructions).retiredInstructions, passInstructions);
+    EXPECT_EQ(translated.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_PAIR), 0);
+}
+
+TEST(FusionTests, patched_code_is_not_fused_as_old_pair)
+{
+    const cpu_register_t patched = 0b0010'0111'0101'0110; // ldi upper, dst register 3, immediate value 0x56
+    for (const bool isFused : { false, true }) {
+        // Host writes code and reports it
+        cpu host;
+        if (isFused)
+            host.setFusionTable(fusion_table::getDefault());
+        setUp(host);
+        host.run(2);
+        host.getMemory().writeWord(sizeof(cpu_register_t), patched);
+        host.invalidateCode(sizeof(cpu_register_t), sizeof(cpu_register_t));
+        host.setInstructionPtr(0);
+        host.run(2);
+        EXPECT_EQ(host.getRegisters()[2], 0x1234);
+        EXPECT_EQ(host.getRegisters()[3], 0x5600);
+        EXPECT_EQ(host.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_PAIR), isFused ? 1 : 0);
+
+        // Guest store rewrites the second word of the fused pair
+        cpu guest;
+        if (isFused)
+            guest.setFusionTable(fusion_table::getDefault());
+        setUp(guest);
+        guest.run(2);
+        guest.getRegisters()[5] = patched;
+        guest.getRegisters()[6] = sizeof(cpu_register_t);
+        guest.getMemory().writeWord(0x4000, 0b0001'1101'0100'0000); // st, dst register 6, src register 5, immediate value 0
+        guest.setInstructionPtr(0x4000);
+        guest.run(1);
+        guest.setInstructionPtr(0);
+        guest.run(2);
+        EXPECT_EQ(guest.getRegisters()[2], 0x1234);
+        EXPECT_EQ(guest.getRegisters()[3], 0x5600);
+        EXPECT_EQ(guest.getFusionCount(operation::FUSED_LOAD_IMMEDIATE_PAIR), isFused ? 1 : 0);
+    }
+}
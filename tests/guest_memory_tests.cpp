@@ -0,0 +1,141 @@
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "guest_memory.h"
+#include "cpu.h"
+
+TEST(GuestMemoryTests, clone_shares_pages_until_write)
+{
+    guest_memory memory;
+    memory.writeWord(0x1000, 0x1234);
+    EXPECT_EQ(memory.getPrivatePagesCount(), 1);
+
+    std::unique_ptr<guest_memory> copy = memory.clone();
+    EXPECT_EQ(memory.getPrivatePagesCount(), 0);
+    EXPECT_EQ(copy->getPrivatePagesCount(), 0);
+    EXPECT_EQ(memory.getReadPages()[1], copy->getReadPages()[1]);
+    EXPECT_TRUE(memory == *copy);
+
+    copy->writeWord(0x1000, 0x5678);
+    EXPECT_EQ(copy->getPrivatePagesCount(), 1);
+    EXPECT_TRUE(copy->isPrivatePage(1));
+    EXPECT_EQ(copy->readWord(0x1000), 0x5678);
+    EXPECT_EQ(memory.readWord(0x1000), 0x1234);
+
+    memory.writeWord(0x3000, 0x9abc);
+    EXPECT_EQ(memory.getPrivatePagesCount(), 1);
+    EXPECT_EQ(copy->readWord(0x3000), 0);
+    EXPECT_TRUE(memory != *copy);
+}
+
+TEST(GuestMemoryTests, last_owner_writes_without_copy)
+{
+    guest_memory memory;
+    memory.writeByte(0x2000, 0);
+    const std::uint8_t* page = memory.getReadPages()[2];
+    memory.clone().reset();
+
+    EXPECT_FALSE(memory.isPrivatePage(2));
+    memory.writeByte(0x2000, 1);
+    EXPECT_EQ(memory.getReadPages()[2], page);
+    EXPECT_EQ(memory.readByte(0x2000), 1);
+}
+
+TEST(GuestMemoryTests, new_memory_shares_zero_page)
+{
+    guest_memory memory;
+    guest_memory other;
+    EXPECT_EQ(memory.getPrivatePagesCount(), 0);
+    EXPECT_EQ(memory.getReadPages()[0], other.getReadPages()[guest_memory::pagesCount - 1]);
+    EXPECT_EQ(memory.readWord(0x1234), 0);
+
+    memory.writeWord(0x1234, 0x5678);
+    EXPECT_TRUE(memory.isPrivatePage(1));
+    EXPECT_EQ(memory.readWord(0x1234), 0x5678);
+    EXPECT_EQ(other.readWord(0x1234), 0);
+}
+
+TEST(GuestMemoryTests, reset_zeroes_pages_in_place)
+{
+    guest_memory memory;
+    memory.writeWord(0x1000, 0x1234);
+    std::unique_ptr<guest_memory> copy = memory.clone();
+    copy->writeWord(0x5000, 0x5678);
+
+    copy->reset();
+    EXPECT_EQ(copy->getPrivatePagesCount(), 1); // page written by copy is kept
+    EXPECT_EQ(copy->readWord(0x1000), 0);
+    EXPECT_EQ(copy->readWord(0x5000), 0);
+    EXPECT_EQ(memory.readWord(0x1000), 0x1234);
+    EXPECT_TRUE(*copy == guest_memory());
+
+    memory.reset();
+    EXPECT_EQ(memory.getPrivatePagesCount(), 0); // page shared with copy is released
+    EXPECT_EQ(memory.readWord(0x1000), 0);
+    memory.writeWord(0x2000, 0x9abc);
+    const std::uint8_t* page = memory.getReadPages()[2];
+    memory.reset();
+    EXPECT_EQ(memory.getReadPages()[2], page);
+    EXPECT_EQ(memory.readWord(0x2000), 0);
+}
+
+TEST(GuestMemoryTests, word_across_page_boundary)
+{
+    guest_memory memory;
+    std::unique_ptr<guest_memory> copy = memory.clone();
+
+    copy->writeWord(guest_memory::pageSize - 1, 0xabcd);
+    EXPECT_EQ(copy->readByte(guest_memory::pageSize - 1), 0xcd);
+    EXPECT_EQ(copy->readByte(guest_memory::pageSize), 0xab);
+    EXPECT_EQ(copy->readWord(guest_memory::pageSize - 1), 0xabcd);
+    EXPECT_EQ(copy->getPrivatePagesCount(), 2);
+    EXPECT_EQ(memory.readWord(guest_memory::pageSize - 1), 0);
+}
+
+TEST(GuestMemoryTests, view_writes_into_flat_memory)
+{
+    std::unique_ptr<std::uint8_t[]> flat(new std::uint8_t[maxSupportedMemory]{});
+    guest_memory view(flat.get(), maxSupportedMemory);
+    view.writeWord(0x4321, 0xbeef);
+    EXPECT_EQ(flat[0x4321], 0xef);
+    EXPECT_EQ(flat[0x4322], 0xbe);
+
+    std::unique_ptr<guest_memory> copy = view.clone();
+    copy->writeWord(0x4321, 0);
+    EXPECT_EQ(view.readWord(0x4321), 0xbeef);
+    EXPECT_EQ(view.getPrivatePagesCount(), guest_memory::pagesCount);
+}
+
+class CpuCloneTests : public testing::TestWithParam<execution_tier> {};
+
+TEST_P(CpuCloneTests, clone_continues_from_same_state)
+{
+    cpu machine(GetParam());
+    const cpu_register_t program[] = {
+        0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+        0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+        0b0011'1001'0000'0010, // add, dst register 1, immediate value 2
+    };
+    for (std::uint32_t address = 0; address < 3000; address += sizeof(program))
+        machine.getMemory().write(address, program, sizeof(program));
+    machine.getRegisters()[1] = 0x8000;
+
+    machine.run(300);
+    std::unique_ptr<cpu> copy = machine.clone();
+    EXPECT_EQ(copy->getInstructionPtr(), machine.getInstructionPtr());
+    EXPECT_EQ(copy->getMemory().getPrivatePagesCount(), 0);
+
+    run_result result = machine.run(300);
+    run_result copyResult = copy->run(300);
+    EXPECT_EQ(copyResult.retiredInstructions, result.retiredInstructions);
+    EXPECT_EQ(copy->getInstructionPtr(), machine.getInstructionPtr());
+    for (std::uint32_t i = 0; i < cpu::geometry::registersCount; ++i)
+        EXPECT_EQ(copy->getRegisters()[i], machine.getRegisters()[i]);
+    EXPECT_TRUE(copy->getMemory() == machine.getMemory());
+    EXPECT_EQ(copy->getMemory().getPrivatePagesCount(), 1); // only stored page is copied
+
+    copy->getMemory().writeWord(0x8000, 0xffff);
+    EXPECT_EQ(machine.getMemory().readWord(0x8000), 1);
+}
+
+INSTANTIATE_TEST_SUITE_P(Tiers, CpuCloneTests, testing::Values(execution_tier::INTERPRETER, execution_tier::JIT));
@@ -1,18 +1,30 @@
 #include <memory>
+#include <cstring>
 
 #include "gtest/gtest.h"
 #include "instructions.h"
-
-#define DECODE_AND_EXECUTE(st) instruction.decodeOperands(); \
-                               st = instruction.executeInstruction();
+#include "decode_table.h"
 
 class InstructionsTests : public testing::Test {
 protected:
-    InstructionsTests() : testing::Test(), memory(new std::uint8_t[maxSupportedMemory]{}), registers(new cpu_register_t[8]{}), properties() {}
+    InstructionsTests() : testing::Test(), memory(new std::uint8_t[maxSupportedMemory]{}), registers(new cpu_register_t[8 + instructions::vectorBankWords]{}),
+                          properties(), memoryView(memory.get(), maxSupportedMemory) {}
+
+    template <typename Instruction>
+    status decodeAndExecute(const cpu_register_t instruction)
+    {
+        const instructions::decoded_instruction operands = Instruction::decode(instruction, properties);
+        return operands.handler(operands, registers.get(), memoryView, properties);
+    }
+    inline std::uint8_t* vector(const std::uint32_t index)
+    {
+        return instructions::getVectorRegister(registers.get(), properties.registersCount, index);
+    }
 
     std::unique_ptr<std::uint8_t[]> memory;
     std::unique_ptr<cpu_register_t[]> registers;
     cpu_base_properties properties;
+    guest_memory memoryView;
 
     status st;
 };
@@ -20,9 +32,8 @@ protected:
 // Load 2 bytes from 0 and 1 addresses to 0 register
 TEST_F(InstructionsTests, base_load)
 {
-    instructions::load instruction(registers.get(), memory.get(), properties);
     memory[0] = 170; memory[1] = 170;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load>(0);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)43690);
@@ -30,12 +41,10 @@ TEST_F(InstructionsTests, base_load)
 
 TEST_F(InstructionsTests, load_with_immediate_value)
 {
-    instructions::load instruction(registers.get(), memory.get(), properties);
     memory[1] = 170; memory[2] = 170;
     registers[1] = 0;
     cpu_register_t currentInstruction = 0b0000'0000'0100'0001; // dst register 0, src register value 0, immediate value 1
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)43690);
@@ -43,12 +52,10 @@ TEST_F(InstructionsTests, load_with_immediate_value)
 
 TEST_F(InstructionsTests, load_with_negative_immediate_value)
 {
-    instructions::load instruction(registers.get(), memory.get(), properties);
     memory[0] = 170; memory[1] = 170;
     registers[1] = 32;
     cpu_register_t currentInstruction = 0b0000'0000'0110'0000; // dst register 0, src register value 0, immediate value 1
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)43690);
@@ -56,12 +63,10 @@ TEST_F(InstructionsTests, load_with_negative_immediate_value)
 
 TEST_F(InstructionsTests, load_register_and_immediate)
 {
-    instructions::load instruction(registers.get(), memory.get(), properties);
     memory[5] = 170; memory[6] = 170;
     registers[1] = (cpu_register_t)4;
     cpu_register_t currentInstruction = 0b0000'0000'0100'0001; // dst register 0, src register value 4, immediate value 1
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)43690);
@@ -69,12 +74,10 @@ TEST_F(InstructionsTests, load_register_and_immediate)
 
 TEST_F(InstructionsTests, load_last_byte)
 {
-    instructions::load instruction(registers.get(), memory.get(), properties);
     memory[maxSupportedMemory - 1] = 170;
     registers[1] = maxSupportedMemory - 1;
     cpu_register_t currentInstruction = 0b0000'0000'0100'0000; // dst register 0, src 1, immediate value 0
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load>(currentInstruction);
 
     EXPECT_EQ(st, status::LAST_MEMORY_BYTE_WARNING);
     EXPECT_EQ(registers[0], (cpu_register_t)170);
@@ -82,11 +85,9 @@ TEST_F(InstructionsTests, load_last_byte)
 
 TEST_F(InstructionsTests, load_out_of_memory)
 {
-    instructions::load instruction(registers.get(), memory.get(), properties);
     registers[1] = maxSupportedMemory - 1;
     cpu_register_t currentInstruction = 0b0000'0000'0100'0001; // dst register 0, src 1, immediate value 0
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load>(currentInstruction);
 
     EXPECT_EQ(st, status::OUT_OF_MEMORY_ERROR);
 }
@@ -94,11 +95,9 @@ TEST_F(InstructionsTests, load_out_of_memory)
 
 TEST_F(InstructionsTests, base_store)
 {
-    instructions::store instruction(registers.get(), memory.get(), properties);
     registers[0] = 43690;
     cpu_register_t currentInstruction = 0b0000'0010'0000'0000; // dst register 1 => 0, src register value 43690, immediate value 0
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::store>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(memory[0], 170);
@@ -107,11 +106,9 @@ TEST_F(InstructionsTests, base_store)
 
 TEST_F(InstructionsTests, store_with_immediate_value)
 {
-    instructions::store instruction(registers.get(), memory.get(), properties);
     registers[0] = 43690;
     cpu_register_t currentInstruction = 0b0000'0010'0000'0001; // dst register 1, src register 0, immediate value 1
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::store>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(memory[1], 170);
@@ -120,11 +117,9 @@ TEST_F(InstructionsTests, store_with_immediate_value)
 
 TEST_F(InstructionsTests, store_with_negative_immediate_value)
 {
-    instructions::store instruction(registers.get(), memory.get(), properties);
     registers[0] = 43690; registers[1] = 32;
     cpu_register_t currentInstruction = 0b0000'0010'0010'0000; // dst register 1, src register 0, immediate value -32
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::store>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(memory[0], 170);
@@ -133,11 +128,9 @@ TEST_F(InstructionsTests, store_with_negative_immediate_value)
 
 TEST_F(InstructionsTests, store_register_and_immediate)
 {
-    instructions::store instruction(registers.get(), memory.get(), properties);
     registers[0] = 43690; registers[1] = 32;
     cpu_register_t currentInstruction = 0b0000'0010'0000'0010; // dst register 1, src register 0, immediate value 2
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::store>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(memory[34], 170);
@@ -146,11 +139,9 @@ TEST_F(InstructionsTests, store_register_and_immediate)
 
 TEST_F(InstructionsTests, store_last_byte)
 {
-    instructions::store instruction(registers.get(), memory.get(), properties);
     registers[0] = 43690; registers[1] = maxSupportedMemory - 1;
     cpu_register_t currentInstruction = 0b0000'0010'0000'0000; // dst register 1, src register 0, immediate value 0
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::store>(currentInstruction);
 
     EXPECT_EQ(st, status::LAST_MEMORY_BYTE_WARNING);
     EXPECT_EQ(memory[maxSupportedMemory - 1], 170);
@@ -158,11 +149,9 @@ TEST_F(InstructionsTests, store_last_byte)
 
 TEST_F(InstructionsTests, store_out_of_memory)
 {
-    instructions::store instruction(registers.get(), memory.get(), properties);
     registers[1] = maxSupportedMemory - 1;
     cpu_register_t currentInstruction = 0b0000'0010'0000'0001; // dst register 1, src register 0, immediate value 1
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::store>(currentInstruction);
 
     EXPECT_EQ(st, status::OUT_OF_MEMORY_ERROR);
 }
@@ -170,10 +159,8 @@ TEST_F(InstructionsTests, store_out_of_memory)
 
 TEST_F(InstructionsTests, load_immediate_lower_byte)
 {
-    instructions::load_immediate instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'1010'1010; // dst register 0, isUpper bit is false, immediate value 170
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load_immediate>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 170);
@@ -181,10 +168,8 @@ TEST_F(InstructionsTests, load_immediate_lower_byte)
 
 TEST_F(InstructionsTests, load_immediate_upper_byte)
 {
-    instructions::load_immediate instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0001'1010'1010; // dst register 0, isUpper bit is true, immediate value 170
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load_immediate>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 43520);
@@ -192,32 +177,26 @@ TEST_F(InstructionsTests, load_immediate_upper_byte)
 
 TEST_F(InstructionsTests, load_immediate_lower_byte_than_upper_byte)
 {
-    instructions::load_immediate instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'1010'1010; // dst register 0, isUpper bit is false, immediate value 170
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load_immediate>(currentInstruction);
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 170);
 
     currentInstruction = 0b0000'0001'1010'1010; // dst register 0, isUpper bit is true, immediate value 170
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load_immediate>(currentInstruction);
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 43690);
 }
 
 TEST_F(InstructionsTests, load_immediate_upper_byte_than_lower_byte)
 {
-    instructions::load_immediate instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0001'1010'1010; // dst register 0, isUpper bit is true, immediate value 170
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load_immediate>(currentInstruction);
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 43520);
 
     currentInstruction = 0b0000'0000'1010'1010; // dst register 0, isUpper bit is false, immediate value 170
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::load_immediate>(currentInstruction);
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 43690);
 }
@@ -225,11 +204,9 @@ TEST_F(InstructionsTests, load_immediate_upper_byte_than_lower_byte)
 
 TEST_F(InstructionsTests, addition_with_positive_immediate_value)
 {
-    instructions::addition instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0111'1111; // isImmediate bit is true, dst register 0, immediate value 127
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 5;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::addition>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 132);
@@ -237,11 +214,9 @@ TEST_F(InstructionsTests, addition_with_positive_immediate_value)
 
 TEST_F(InstructionsTests, addition_with_negative_immediate_value)
 {
-    instructions::addition instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'1010'1010; // isImmediate bit is true, dst register 0, immediate value -86
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 5;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::addition>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)-81);
@@ -249,11 +224,9 @@ TEST_F(InstructionsTests, addition_with_negative_immediate_value)
 
 TEST_F(InstructionsTests, addition_with_register_value_base)
 {
-    instructions::addition instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, scr register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 5, registers[1] = 10;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::addition>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 15);
@@ -261,11 +234,9 @@ TEST_F(InstructionsTests, addition_with_register_value_base)
 
 TEST_F(InstructionsTests, addition_with_register_value_with_overflow)
 {
-    instructions::addition instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, scr register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 32769, registers[1] = 32768;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::addition>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 1);
@@ -274,11 +245,9 @@ TEST_F(InstructionsTests, addition_with_register_value_with_overflow)
 
 TEST_F(InstructionsTests, subtraction_with_positive_immediate_value)
 {
-    instructions::subtraction instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0000'0101; // isImmediate bit is true, dst register 0, immediate value 5
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 10;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::subtraction>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 5);
@@ -286,11 +255,9 @@ TEST_F(InstructionsTests, subtraction_with_positive_immediate_value)
 
 TEST_F(InstructionsTests, subtraction_with_negative_immediate_value)
 {
-    instructions::subtraction instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'1010'1010; // isImmediate bit is true, dst register 0, immediate value -86
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 5;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::subtraction>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 91);
@@ -298,11 +265,9 @@ TEST_F(InstructionsTests, subtraction_with_negative_immediate_value)
 
 TEST_F(InstructionsTests, subtraction_with_register_value_base)
 {
-    instructions::subtraction instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, scr register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 10, registers[1] = 5;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::subtraction>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 5);
@@ -310,11 +275,9 @@ TEST_F(InstructionsTests, subtraction_with_register_value_base)
 
 TEST_F(InstructionsTests, subtraction_with_register_value_with_overflow)
 {
-    instructions::subtraction instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, scr register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 10, registers[1] = 11;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::subtraction>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)-1);
@@ -323,11 +286,9 @@ TEST_F(InstructionsTests, subtraction_with_register_value_with_overflow)
 
 TEST_F(InstructionsTests, multiplication_with_positive_immediate_value)
 {
-    instructions::multiplication instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0000'0101; // isImmediate bit is true, dst register 0, immediate value 5
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 10;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::multiplication>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 50);
@@ -335,11 +296,9 @@ TEST_F(InstructionsTests, multiplication_with_positive_immediate_value)
 
 TEST_F(InstructionsTests, multiplication_with_negative_immediate_value)
 {
-    instructions::multiplication instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'1010'1010; // isImmediate bit is true, dst register 0, immediate value -86
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 5;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::multiplication>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], (cpu_register_t)-430);
@@ -347,11 +306,9 @@ TEST_F(InstructionsTests, multiplication_with_negative_immediate_value)
 
 TEST_F(InstructionsTests, multiplication_with_register_value_base)
 {
-    instructions::multiplication instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, scr register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 10, registers[1] = 5;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::multiplication>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 50);
@@ -359,11 +316,9 @@ TEST_F(InstructionsTests, multiplication_with_register_value_base)
 
 TEST_F(InstructionsTests, multiplication_with_register_value_with_overflow)
 {
-    instructions::multiplication instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, scr register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 1024, registers[1] = 65;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::multiplication>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 1024);
@@ -372,11 +327,9 @@ TEST_F(InstructionsTests, multiplication_with_register_value_with_overflow)
 
 TEST_F(InstructionsTests, shift_right_logical_immediate_base)
 {
-    instructions::shift_right_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0000'0010; // isImmediate bit is true, dst register 0, immediate value 2
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 24;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_right_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 24 >> 2);
@@ -384,31 +337,25 @@ TEST_F(InstructionsTests, shift_right_logical_immediate_base)
 
 TEST_F(InstructionsTests, shift_right_logical_immediate_more_than_16_bits)
 {
-    instructions::shift_right_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0001'1000; // isImmediate bit is true, dst register 0, immediate value 24
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_right_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, shift_right_logical_negative_immediate)
 {
-    instructions::shift_right_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0010'0000; // isImmediate bit is true, dst register 0, immediate value -32
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_right_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, shift_right_logical_base)
 {
-    instructions::shift_right_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 24; registers[1] = 2;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_right_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 24 >> 2);
@@ -416,22 +363,18 @@ TEST_F(InstructionsTests, shift_right_logical_base)
 
 TEST_F(InstructionsTests, shift_right_logical_more_than_16_bits)
 {
-    instructions::shift_right_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[1] = 24;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_right_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, shift_right_logical_negative)
 {
-    instructions::shift_right_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[1] = (cpu_register_t)-1;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_right_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
@@ -439,11 +382,9 @@ TEST_F(InstructionsTests, shift_right_logical_negative)
 
 TEST_F(InstructionsTests, shift_left_logical_immediate_base)
 {
-    instructions::shift_left_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0000'0010; // isImmediate bit is true, dst register 0, immediate value 2
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 6;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_left_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 6 << 2);
@@ -451,31 +392,25 @@ TEST_F(InstructionsTests, shift_left_logical_immediate_base)
 
 TEST_F(InstructionsTests, shift_left_logical_immediate_more_than_16_bits)
 {
-    instructions::shift_left_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0001'1000; // isImmediate bit is true, dst register 0, immediate value 24
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_left_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, shift_left_logical_negative_immediate)
 {
-    instructions::shift_left_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'1000'0010'0000; // isImmediate bit is true, dst register 0, immediate value -32
-    instruction.setCurrentInstruction(currentInstruction);
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_left_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, shift_left_logical_base)
 {
-    instructions::shift_left_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 6; registers[1] = 2;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_left_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 6 << 2);
@@ -483,31 +418,26 @@ TEST_F(InstructionsTests, shift_left_logical_base)
 
 TEST_F(InstructionsTests, shift_left_logical_more_than_16_bits)
 {
-    instructions::shift_left_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[1] = 24;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_left_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, shift_left_logical_negative)
 {
-    instructions::shift_left_logical instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0010'0000; // isImmediate bit is false, dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[1] = (cpu_register_t)-1;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::shift_left_logical>(currentInstruction);
 
     EXPECT_EQ(st, status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH);
 }
 
 TEST_F(InstructionsTests, bitwise_not)
 {
-    instructions::bitwise_not instruction(registers.get(), memory.get(), properties);
     registers[0] = 0b0101'0101'0101'0101;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::bitwise_not>(0);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 0b1010'1010'1010'1010);
@@ -515,12 +445,10 @@ TEST_F(InstructionsTests, bitwise_not)
 
 TEST_F(InstructionsTests, bitwise_and)
 {
-    instructions::bitwise_and instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0100'0000; // dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 164;
     registers[1] = 21;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::bitwise_and>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 4);
@@ -528,12 +456,10 @@ TEST_F(InstructionsTests, bitwise_and)
 
 TEST_F(InstructionsTests, bitwise_or)
 {
-    instructions::bitwise_or instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0100'0000; // dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 164;
     registers[1] = 21;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::bitwise_or>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 181);
@@ -541,13 +467,190 @@ TEST_F(InstructionsTests, bitwise_or)
 
 TEST_F(InstructionsTests, bitwise_xor)
 {
-    instructions::bitwise_xor instruction(registers.get(), memory.get(), properties);
     cpu_register_t currentInstruction = 0b0000'0000'0100'0000; // dst register 0, src register 1
-    instruction.setCurrentInstruction(currentInstruction);
     registers[0] = 164;
     registers[1] = 21;
-    DECODE_AND_EXECUTE(st);
+    st = decodeAndExecute<instructions::bitwise_xor>(currentInstruction);
 
     EXPECT_EQ(st, status::STATUS_OK);
     EXPECT_EQ(registers[0], 177);
 }
+
+TEST(ControlFlowTests, decode_control_flow)
+{
+    default_cpu_properties properties;
+    instructions::decoded_instruction operands = instructions::jump::decode(0b1100'1111'1111'1101, properties);
+    EXPECT_EQ(operands.op, instructions::operation::JUMP);
+    EXPECT_EQ(operands.immediate, (cpu_register_t)-6);
+
+    operands = instructions::branch::decode(0b1101'1000'0000'0100, properties); // carry flag is set, offset 4
+    EXPECT_EQ(operands.op, instructions::operation::BRANCH_IF_SET);
+    EXPECT_EQ(operands.srcRegisterIndex, 2);
+    EXPECT_EQ(operands.immediate, 8);
+    operands = instructions::branch::decode(0b1101'0111'1111'1111, properties); // negative flag is clear, offset -1
+    EXPECT_EQ(operands.op, instructions::operation::BRANCH_IF_CLEAR);
+    EXPECT_EQ(operands.srcRegisterIndex, 1);
+    EXPECT_EQ(operands.immediate, (cpu_register_t)-2);
+
+    operands = instructions::call::decode(0b1110'1101'1000'0000, properties); // link register 5, offset -128
+    EXPECT_EQ(operands.op, instructions::operation::CALL_IMMEDIATE);
+    EXPECT_EQ(operands.dstRegisterIndex, 5);
+    EXPECT_EQ(operands.immediate, (cpu_register_t)-256);
+    operands = instructions::call::decode(0b1110'0101'0110'0000, properties); // link register 5, target register 3
+    EXPECT_EQ(operands.op, instructions::operation::CALL_REGISTER);
+    EXPECT_EQ(operands.srcRegisterIndex, 3);
+
+    operands = instructions::return_from_call::decode(0b1111'1010'0000'0000, properties);
+    EXPECT_EQ(operands.op, instructions::operation::RETURN);
+    EXPECT_EQ(operands.srcRegisterIndex, 5);
+
+    cpu_register_t registers[8] = { 0, 0, 0, 0x1234 };
+    operands = instructions::call::decode(0b1110'0101'0110'0000, properties);
+    EXPECT_EQ(instructions::control_flow_base::getTarget(0x100, operands, registers), 0x1234);
+    operands = instructions::jump::decode(0b1100'1111'1111'1101, properties);
+    EXPECT_EQ(instructions::control_flow_base::getTarget(0x2, operands, registers), 0xfffc);
+}
+
+TEST(VectorTests, decode_vector_instructions)
+{
+    cpu_base_properties properties;
+    instructions::decoded_instruction operands;
+    operands = instructions::return_from_call::decode(0b1111'0001'0000'1110, properties); // vadd, dst vector 1, src vector 3
+    EXPECT_EQ(operands.op, instructions::operation::VECTOR_ADD);
+    EXPECT_EQ(operands.dstRegisterIndex, 1);
+    EXPECT_EQ(operands.srcRegisterIndex, 3);
+    operands = instructions::return_from_call::decode(0b1111'0001'1011'0100, properties); // vcmpeq, dst vector 2, src vector 2
+    EXPECT_EQ(operands.op, instructions::operation::VECTOR_COMPARE_EQUAL);
+    EXPECT_EQ(operands.dstRegisterIndex, 2);
+    EXPECT_EQ(operands.srcRegisterIndex, 2);
+    operands = instructions::return_from_call::decode(0b1111'1011'1101'1000, properties); // vld, vector 3, address register 5
+    EXPECT_EQ(operands.op, instructions::operation::VECTOR_LOAD);
+    EXPECT_EQ(operands.dstRegisterIndex, 3);
+    EXPECT_EQ(operands.srcRegisterIndex, 5);
+    operands = instructions::return_from_call::decode(0b1111'1011'1110'1000, properties); // vst, vector 1, address register 5
+    EXPECT_EQ(operands.op, instructions::operation::VECTOR_STORE);
+    EXPECT_EQ(operands.dstRegisterIndex, 5);
+    EXPECT_EQ(operands.srcRegisterIndex, 1);
+
+    // Return ignores bits before vector bit
+    operands = instructions::return_from_call::decode(0b1111'1010'1111'1111, properties);
+    EXPECT_EQ(operands.op, instructions::operation::RETURN);
+    EXPECT_FALSE(instructions::isControlFlow(instructions::operation::VECTOR_ADD));
+}
+
+TEST(VectorTests, geometry_without_room_has_no_vector_instructions)
+{
+    const cpu_base_properties wide(16, 32, 16); // return register takes bits 11..7
+    instructions::decoded_instruction operands = instructions::return_from_call::decode(0b1111'0000'0100'0000, wide);
+    EXPECT_EQ(operands.op, instructions::operation::UNKNOWN);
+    operands = instructions::return_from_call::decode(0b1111'1000'1000'0000, wide);
+    EXPECT_EQ(operands.op, instructions::operation::RETURN);
+    EXPECT_EQ(operands.srcRegisterIndex, 17);
+
+    const std::shared_ptr<const instructions::decode_table> table = instructions::decode_table::getTable(wide);
+    EXPECT_EQ((*table)[0b1111'0000'0111'1110].op, instructions::operation::UNKNOWN);
+}
+
+TEST_F(InstructionsTests, vector_arithmetic)
+{
+    for (std::uint32_t lane = 0; lane < instructions::vectorSize; ++lane) {
+        vector(0)[lane] = 0xf0 + lane;
+        vector(1)[lane] = lane % 2 ? 0xf0 + lane : 0x20;
+    }
+    vector(2)[0] = 0xaa;
+
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0001'0001'0000); // vadd, dst vector 2, src vector 0
+    EXPECT_EQ(st, status::STATUS_OK);
+    EXPECT_EQ(vector(2)[0], 0x9a);
+    EXPECT_EQ(vector(2)[15], 0xff);
+
+    std::uint8_t expected[instructions::vectorSize];
+    std::memcpy(vector(3), vector(0), instructions::vectorSize);
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0001'1011'1010); // vcmpeq, dst vector 3, src vector 1
+    EXPECT_EQ(st, status::STATUS_OK);
+    for (std::uint32_t lane = 0; lane < instructions::vectorSize; ++lane)
+        expected[lane] = lane % 2 ? 0xff : 0x00;
+    EXPECT_EQ(std::memcmp(vector(3), expected, sizeof(expected)), 0);
+
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0001'0010'0000); // vsub, dst vector 0, src vector 0
+    EXPECT_EQ(st, status::STATUS_OK);
+    std::memset(expected, 0, sizeof(expected));
+    EXPECT_EQ(std::memcmp(vector(0), expected, sizeof(expected)), 0);
+
+    std::memset(vector(0), 0x0f, instructions::vectorSize);
+    decodeAndExecute<instructions::return_from_call>(0b1111'0001'0100'1000); // vand, dst vector 1, src vector 0
+    EXPECT_EQ(vector(1)[0], 0x00);
+    EXPECT_EQ(vector(1)[1], 0x01);
+    decodeAndExecute<instructions::return_from_call>(0b1111'0001'0110'1000); // vor
+    EXPECT_EQ(vector(1)[1], 0x0f);
+    decodeAndExecute<instructions::return_from_call>(0b1111'0001'1000'1000); // vxor
+    EXPECT_EQ(vector(1)[1], 0x00);
+}
+
+TEST_F(InstructionsTests, vector_load_and_store)
+{
+    for (std::uint32_t index = 0; index < instructions::vectorSize; ++index)
+        memory[0x101 + index] = index + 1;
+    registers[2] = 0x101;
+    registers[3] = 0xfff0;
+
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0101'1100'1000); // vld, vector 1, address register 2
+    EXPECT_EQ(st, status::STATUS_OK);
+    EXPECT_EQ(std::memcmp(vector(1), &memory[0x101], instructions::vectorSize), 0);
+
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0111'1110'1000); // vst, vector 1, address register 3
+    EXPECT_EQ(st, status::STATUS_OK);
+    EXPECT_EQ(std::memcmp(&memory[0xfff0], &memory[0x101], instructions::vectorSize), 0);
+
+    // Vector has to be inside of memory as a whole
+    registers[3] = 0xfff1;
+    memory[0xfff1] = 0;
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0111'1110'1000);
+    EXPECT_EQ(st, status::OUT_OF_MEMORY_ERROR);
+    EXPECT_EQ(memory[0xfff1], 0);
+    st = decodeAndExecute<instructions::return_from_call>(0b1111'0111'1100'1000); // vld, vector 1, address register 3
+    EXPECT_EQ(st, status::OUT_OF_MEMORY_ERROR);
+}
+
+TEST(StaticPropertiesTests, static_properties_match_runtime_properties)
+{
+    cpu_base_properties runtime;
+    cpu_base_properties converted = default_cpu_properties();
+
+    EXPECT_EQ(runtime.bitsPerInstruction, default_cpu_properties::bitsPerInstruction);
+    EXPECT_EQ(runtime.bitsPerRegister, default_cpu_properties::bitsPerRegister);
+    EXPECT_EQ(runtime.instructionMask, default_cpu_properties::instructionMask);
+    EXPECT_EQ(converted.registersCount, runtime.registersCount);
+    EXPECT_EQ(converted.maxInstructionsCount, runtime.maxInstructionsCount);
+}
+
+TEST(StaticPropertiesTests, decode_is_constant_expression)
+{
+    constexpr default_cpu_properties properties;
+    constexpr instructions::decoded_instruction operands =
+        instructions::load::decode(0b0000'0110'0111'1110, properties); // dst register 3, src register 1, immediate value -2
+
+    static_assert(operands.dstRegisterIndex == 3, "dst register");
+    static_assert(operands.srcRegisterIndex == 1, "src register");
+    static_assert(operands.immediate == (cpu_register_t)-2, "immediate value");
+}
+
+TEST(StaticPropertiesTests, static_decode_matches_runtime_decode)
+{
+    cpu_base_properties runtime;
+    default_cpu_properties compileTime;
+    for (std::uint32_t instruction = 0; instruction <= 0xffff; ++instruction) {
+        instructions::decoded_instruction expected = instructions::addition::decode(instruction, runtime);
+        instructions::decoded_instruction operands = instructions::addition::decode(instruction, compileTime);
+        EXPECT_EQ(operands.op, expected.op);
+        EXPECT_EQ(operands.dstRegisterIndex, expected.dstRegisterIndex);
+        EXPECT_EQ(operands.srcRegisterIndex, expected.srcRegisterIndex);
+        EXPECT_EQ(operands.immediate, expected.immediate);
+
+        expected = instructions::load_immediate::decode(instruction, runtime);
+        operands = instructions::load_immediate::decode(instruction, compileTime);
+        EXPECT_EQ(operands.op, expected.op);
+        EXPECT_EQ(operands.dstRegisterIndex, expected.dstRegisterIndex);
+        EXPECT_EQ(operands.immediate, expected.immediate);
+    }
+}
@@ -0,0 +1,258 @@
+#include <string>
+#include <cstring>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "cpu.h"
+
+class JitTests : public testing::Test {
+protected:
+    JitTests() : testing::Test(), machine(execution_tier::JIT) {}
+
+    void putInstruction(const std::uint32_t address, const cpu_register_t instruction)
+    {
+        machine.getMemory().write(address, &instruction, sizeof(instruction));
+    }
+
+    cpu machine;
+};
+
+TEST_F(JitTests, arithmetic_block)
+{
+    putInstruction(0, 0b0010'0000'0000'0011); // ldi, dst register 0, lower byte 3
+    putInstruction(2, 0b0010'0011'0000'0001); // ldi, dst register 1, upper byte 1
+    putInstruction(4, 0b0011'0000'0010'0000); // add, dst register 0, src register 1
+    putInstruction(6, 0b0101'1000'0000'0011); // mul, dst register 0, immediate value 3
+    putInstruction(8, 0b0100'1000'1111'1111); // sub, dst register 0, immediate value -1
+    putInstruction(10, 0b0110'1000'0000'0001); // srl, dst register 0, immediate value 1
+    putInstruction(12, 0b1000'0010'0000'0000); // not, dst register 1
+
+    run_result result = machine.run(7);
+    EXPECT_EQ(result.retiredInstructions, 7);
+    EXPECT_EQ(result.reason, stop_reason::INSTRUCTIONS_LIMIT);
+    EXPECT_EQ(machine.getRegisters()[0], (cpu_register_t)(((259 * 3) + 1) >> 1));
+    EXPECT_EQ(machine.getRegisters()[1], (cpu_register_t)~256);
+    EXPECT_EQ(machine.getInstructionPtr(), 14);
+}
+
+TEST_F(JitTests, budget_smaller_than_block)
+{
+    for (std::uint32_t address = 0; address < 40; address += 2)
+        putInstruction(address, 0b0011'1000'0000'0001); // add, dst register 0, immediate value 1
+
+    run_result result = machine.run(5);
+    EXPECT_EQ(result.retiredInstructions, 5);
+    EXPECT_EQ(machine.getRegisters()[0], 5);
+
+    result = machine.run(15);
+    EXPECT_EQ(result.retiredInstructions, 15);
+    EXPECT_EQ(machine.getRegisters()[0], 20);
+}
+
+TEST_F(JitTests, load_store_edge_cases_fall_back_to_interpreter)
+{
+    putInstruction(0, 0b0001'0010'0000'0000); // st, dst register 1, src register 0, immediate value 0
+    putInstruction(2, 0b0000'0100'0100'0000); // ld, dst register 2, src register 1, immediate value 0
+    putInstruction(4, 0b0000'0110'0100'0001); // ld, dst register 3, src register 1, immediate value 1
+    machine.getRegisters()[0] = 0xabcd;
+    machine.getRegisters()[1] = maxSupportedMemory - 1;
+
+    run_result result = machine.run(10);
+    EXPECT_EQ(result.retiredInstructions, 2);
+    EXPECT_EQ(result.reason, stop_reason::ERROR);
+    EXPECT_EQ(result.lastStatus, status::OUT_OF_MEMORY_ERROR);
+    EXPECT_EQ(machine.getMemory().readByte(maxSupportedMemory - 1), 0xcd);
+    EXPECT_EQ(machine.getRegisters()[2], 0xcd);
+    EXPECT_EQ(machine.getInstructionPtr(), 4);
+}
+
+// Store rewrites instruction which is already translated in the same block
+TEST_F(JitTests, store_into_code_invalidates_translation)
+{
+    putInstruction(0, 0b0001'0010'0000'0000); // st, dst register 1, src register 0, immediate value 0
+    putInstruction(2, 0b0011'1011'0000'0001); // add, dst register 3, immediate value 1
+    putInstruction(4, 0b0011'1011'0000'0001); // add, dst register 3, immediate value 1
+    machine.getRegisters()[0] = 0b0011'1011'0000'0101; // add, dst register 3, immediate value 5
+    machine.getRegisters()[1] = 4;
+
+    machine.run(3);
+    EXPECT_EQ(machine.getRegisters()[3], 6);
+
+    // Run translated block again with original code
+    putInstruction(4, 0b0011'1011'0000'0001);
+    machine.invalidateCode(4, 2);
+    machine.getRegisters()[1] = 2;
+    machine.getRegisters()[3] = 0;
+    machine.setInstructionPtr(0);
+    machine.run(3);
+    EXPECT_EQ(machine.getRegisters()[3], 6);
+}
+
+TEST_F(JitTests, loop_runs_in_chained_blocks)
+{
+    putInstruction(0, 0b0010'0000'1110'1000); // ldi lower, dst register 0, immediate value 232
+    putInstruction(2, 0b0010'0001'0000'0011); // ldi upper, dst register 0, immediate value 3
+    putInstruction(4, 0b0011'1001'0000'0010); // add, dst register 1, immediate value 2
+    putInstruction(6, 0b0100'1000'0000'0001); // sub, dst register 0, immediate value 1
+    putInstruction(8, 0b1101'0011'1111'1110); // br if zero flag is clear, offset -2
+    putInstruction(10, 0b1000'0100'0000'0000); // not, dst register 2
+
+    run_result result = machine.run(2 + 3 * 1000 + 1);
+    EXPECT_EQ(result.retiredInstructions, 2 + 3 * 1000 + 1);
+    EXPECT_EQ(machine.getRegisters()[1], 2000);
+    EXPECT_EQ(machine.getRegisters()[2], 0xffff);
+    EXPECT_EQ(machine.getInstructionPtr(), 12);
+    EXPECT_EQ(machine.getStatusRegister(), instructions::ZERO_FLAG);
+}
+
+// Translated, chained and invalidated code leaves no writable and
+// executable mapping behind
+TEST_F(JitTests, code_buffer_is_never_writable_and_executable)
+{
+    putInstruction(0, 0b0011'1001'0000'0010); // add, dst register 1, immediate value 2
+    putInstruction(2, 0b1100'1111'1111'1111); // jmp, offset -1
+    machine.run(100);
+    putInstruction(0, 0b0011'1001'0000'0011); // add, dst register 1, immediate value 3
+    machine.invalidateCode(0, 2);
+    machine.getRegisters()[1] = 0;
+    machine.setInstructionPtr(0);
+    machine.run(10);
+    EXPECT_EQ(machine.getRegisters()[1], 15);
+
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    while (std::getline(maps, line))
+        EXPECT_EQ(line.find(" rwx"), std::string::npos) << line;
+}
+
+TEST(JitRunTests, translated_code_matches_interpreter)
+{
+    std::uint32_t seed = 777;
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    const std::uint32_t programSize = 8192;
+    for (std::uint32_t program = 0; program < 32; ++program) {
+        cpu machine(execution_tier::JIT), reference;
+        for (std::uint32_t address = 0; address < programSize; address += 2) {
+            cpu_register_t instruction = (random() % 12) << 12 | (random() & 0x0fff);
+            if ((instruction >> 12) == 6 || (instruction >> 12) == 7)
+                instruction = (instruction & 0xf700) | ((random() & 0x7) ? 0x0800 : 0x0) | (random() & 0x1f);
+            machine.getMemory().write(address, &instruction, sizeof(instruction));
+            reference.getMemory().write(address, &instruction, sizeof(instruction));
+        }
+        for (std::uint32_t i = 0; i < 8; ++i)
+            machine.getRegisters()[i] = reference.getRegisters()[i] = random() & 0x3f;
+
+        // Run in slices, so blocks are entered with different budgets
+        run_result result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+        run_result expected = reference.run(programSize / 2);
+        while (result.reason == stop_reason::INSTRUCTIONS_LIMIT && result.retiredInstructions < expected.retiredInstructions) {
+            run_result slice = machine.run(97);
+            result.retiredInstructions += slice.retiredInstructions;
+            result.reason = slice.reason;
+            result.lastStatus = slice.lastStatus;
+        }
+        if (result.reason == stop_reason::INSTRUCTIONS_LIMIT && expected.reason != stop_reason::INSTRUCTIONS_LIMIT) {
+            run_result slice = machine.run(1);
+            result.reason = slice.reason;
+            result.lastStatus = slice.lastStatus;
+        }
+
+        EXPECT_EQ(result.retiredInstructions, expected.retiredInstructions);
+        EXPECT_EQ(result.reason, expected.reason);
+        EXPECT_EQ(result.lastStatus, expected.lastStatus);
+        EXPECT_EQ(machine.getInstructionPtr(), reference.getInstructionPtr());
+        for (std::uint32_t i = 0; i < 8; ++i)
+            EXPECT_EQ(machine.getRegisters()[i], reference.getRegisters()[i]);
+        EXPECT_TRUE(machine.getMemory() == reference.getMemory());
+    }
+}
+
+// Random programs with jumps, branches and calls, chained blocks have to
+// follow the same path as interpreter
+TEST(JitRunTests, translated_control_flow_matches_interpreter)
+{
+    std::uint32_t seed = 4242;
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    const std::uint32_t programSize = 4096;
+    for (std::uint32_t program = 0; program < 32; ++program) {
+        cpu machine(execution_tier::JIT), reference;
+        for (std::uint32_t address = 0; address < programSize; address += 2) {
+            cpu_register_t opCode = random() % 8 ? random() % 12 : 12 + random() % 4;
+            cpu_register_t instruction = opCode << 12 | (random() & 0x0fff);
+            if (opCode == 6 || opCode == 7)
+                instruction = (instruction & 0xf700) | 0x0800 | (random() & 0xf);
+            machine.getMemory().write(address, &instruction, sizeof(instruction));
+            reference.getMemory().write(address, &instruction, sizeof(instruction));
+        }
+        for (std::uint32_t i = 0; i < 8; ++i)
+            machine.getRegisters()[i] = reference.getRegisters()[i] = random() & 0xffe;
+
+        run_result expected = reference.runUntil([](const cpu&) { return false; }, 20000);
+        run_result result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+        while (result.reason == stop_reason::INSTRUCTIONS_LIMIT && result.retiredInstructions < expected.retiredInstructions) {
+            run_result slice = machine.run(std::min<std::uint64_t>(997, expected.retiredInstructions - result.retiredInstructions));
+            result.retiredInstructions += slice.retiredInstructions;
+            result.reason = slice.reason;
+            result.lastStatus = slice.lastStatus;
+        }
+        if (result.reason == stop_reason::INSTRUCTIONS_LIMIT && expected.reason != stop_reason::INSTRUCTIONS_LIMIT) {
+            run_result slice = machine.run(1);
+            result.reason = slice.reason;
+            result.lastStatus = slice.lastStatus;
+        }
+
+        EXPECT_EQ(result.retiredInstructions, expected.retiredInstructions);
+        EXPECT_EQ(result.reason, expected.reason);
+        EXPECT_EQ(machine.getInstructionPtr(), reference.getInstructionPtr());
+        EXPECT_EQ(machine.getStatusRegister(), reference.getStatusRegister());
+        for (std::uint32_t i = 0; i < 8; ++i)
+            EXPECT_EQ(machine.getRegisters()[i], reference.getRegisters()[i]);
+        EXPECT_TRUE(machine.getMemory() == reference.getMemory());
+    }
+}
+
+// Random programs mixing scalar and vector instructions, vector arithmetic
+// is translated and vector loads and stores leave translated code
+TEST(JitRunTests, translated_vector_code_matches_interpreter)
+{
+    std::uint32_t seed = 2025;
+    auto random = [&seed]() { seed = seed * 1103515245 + 12345; return (cpu_register_t)(seed >> 16); };
+    const std::uint32_t programSize = 4096;
+    for (std::uint32_t program = 0; program < 16; ++program) {
+        cpu machine(execution_tier::JIT), reference;
+        for (std::uint32_t address = 0; address < programSize; address += 2) {
+            cpu_register_t instruction = (random() % 12) << 12 | (random() & 0x0fff);
+            if ((instruction >> 12) == 6 || (instruction >> 12) == 7)
+                instruction = (instruction & 0xf700) | 0x0800 | (random() & 0xf);
+            if (random() % 2)
+                instruction = 0xf100 | (random() & 0x0eff); // vector instruction
+            machine.getMemory().write(address, &instruction, sizeof(instruction));
+            reference.getMemory().write(address, &instruction, sizeof(instruction));
+        }
+        for (std::uint32_t i = 0; i < 8; ++i)
+            machine.getRegisters()[i] = reference.getRegisters()[i] = 0x2000 + (random() & 0x3fff);
+
+        run_result expected = reference.run(programSize / 2);
+        run_result result = { 0, stop_reason::INSTRUCTIONS_LIMIT, status::STATUS_OK };
+        while (result.reason == stop_reason::INSTRUCTIONS_LIMIT && result.retiredInstructions < expected.retiredInstructions) {
+            run_result slice = machine.run(std::min<std::uint64_t>(97, expected.retiredInstructions - result.retiredInstructions));
+            result.retiredInstructions += slice.retiredInstructions;
+            result.reason = slice.reason;
+            result.lastStatus = slice.lastStatus;
+        }
+        if (result.reason == stop_reason::INSTRUCTIONS_LIMIT && expected.reason != stop_reason::INSTRUCTIONS_LIMIT) {
+            run_result slice = machine.run(1);
+            result.reason = slice.reason;
+            result.lastStatus = slice.lastStatus;
+        }
+
+        EXPECT_EQ(result.retiredInstructions, expected.retiredInstructions);
+        EXPECT_EQ(result.reason, expected.reason);
+        EXPECT_EQ(machine.getInstructionPtr(), reference.getInstructionPtr());
+        for (std::uint32_t i = 0; i < 8; ++i)
+            EXPECT_EQ(machine.getRegisters()[i], reference.getRegisters()[i]);
+        EXPECT_EQ(std::memcmp(machine.getVectorRegister(0), reference.getVectorRegister(0),
+                              instructions::vectorRegistersCount * instructions::vectorSize), 0);
+        EXPECT_TRUE(machine.getMemory() == reference.getMemory());
+    }
+}
@@ -0,0 +1,21 @@
+#include "gtest/gtest.h"
+#include "perf_counters.h"
+#include "cpu.h"
+
+TEST(PerfCountersTests, counts_run_or_reports_nothing)
+{
+    cpu machine;
+    perf_counters counters;
+    perf_sample sample = measureCounters(counters, [&machine]() { machine.run(100000); });
+
+    for (std::uint32_t event = 0; event < perfEventsCount; ++event) {
+        EXPECT_EQ(sample.isValid[event], counters.isCounted((perf_event)event));
+        if (!sample.isValid[event]) {
+            EXPECT_EQ(sample.values[event], 0);
+        }
+    }
+    if (sample.has(perf_event::INSTRUCTIONS)) {
+        EXPECT_GT(sample.get(perf_event::INSTRUCTIONS), 100000);
+    }
+    EXPECT_STREQ(perf_counters::getEventName(perf_event::LLC_MISSES), "llc_misses");
+}
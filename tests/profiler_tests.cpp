@@ -0,0 +1,79 @@
+#include <sstream>
+
+#include "gtest/gtest.h"
+#include "profiler.h"
+#include "cpu.h"
+
+using instructions::operation;
+
+TEST(ProfilerTests, counts_operations_addresses_and_statuses)
+{
+    profiled_cpu machine(execution_tier::JIT);
+    const cpu_register_t program[] = {
+        0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+        0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+        0b0000'0100'0100'0000, // ld, dst register 2, src register 1, immediate value 0
+    };
+    for (std::uint32_t address = 0; address < 60; address += sizeof(program))
+        machine.getMemory().write(address, program, sizeof(program));
+    machine.getRegisters()[1] = 0x8000;
+
+    run_result result = machine.run(30);
+    EXPECT_EQ(result.retiredInstructions, 30);
+    const opcode_profiler& profiler = machine.getProfiler();
+    EXPECT_EQ(profiler.getRetiredInstructions(), 30);
+    EXPECT_EQ(profiler.getOperationCount(operation::ADD_IMMEDIATE), 10);
+    EXPECT_EQ(profiler.getStoresCount(), 10);
+    EXPECT_EQ(profiler.getLoadsCount(), 10);
+    EXPECT_EQ(profiler.getAddressCount(0), 1);
+    EXPECT_EQ(profiler.getAddressCount(1), 0);
+    EXPECT_EQ(profiler.getStatusCount(status::STATUS_OK), 0);
+
+    machine.getRegisters()[1] = 0xffff; // load of the last memory byte
+    machine.setInstructionPtr(4);
+    machine.run(1);
+    EXPECT_EQ(profiler.getStatusCount(status::LAST_MEMORY_BYTE_WARNING), 1);
+    EXPECT_EQ(profiler.getLoadsCount(), 11);
+
+    machine.getMemory().writeWord(0x100, 0b0110'1000'0001'0001); // srl, dst register 0, immediate value 17
+    machine.setInstructionPtr(0x100);
+    EXPECT_EQ(machine.run(1).reason, stop_reason::ERROR);
+    EXPECT_EQ(profiler.getStatusCount(status::SHIFT_BY_NEGATIVE_VALUE_OR_VALUE_MORE_THAN_CPU_BIT_DEPTH), 1);
+    EXPECT_EQ(profiler.getRetiredInstructions(), 31);
+
+    std::ostringstream json;
+    profiler.report(json, report_format::JSON, 2);
+    EXPECT_NE(json.str().find("\"addi\": 10"), std::string::npos);
+    EXPECT_NE(json.str().find("\"LAST_MEMORY_BYTE_WARNING\": 1"), std::string::npos);
+    EXPECT_NE(json.str().find("\"address\": 4, \"count\": 2"), std::string::npos);
+
+    std::ostringstream text;
+    profiler.report(text, report_format::TEXT);
+    EXPECT_NE(text.str().find("ld 11"), std::string::npos);
+
+    machine.getProfiler().reset();
+    EXPECT_EQ(profiler.getRetiredInstructions(), 0);
+    EXPECT_EQ(profiler.getAddressCount(0), 0);
+}
+
+TEST(ProfilerTests, profiled_cpu_matches_plain_cpu)
+{
+    const cpu_register_t program[] = {
+        0b0011'1000'0000'0011, // add, dst register 0, immediate value 3
+        0b0101'0001'0000'0000, // mul, dst register 1, src register 0
+        0b1011'0001'0000'0000, // xor, dst register 1, src register 0
+    };
+    cpu plain;
+    profiled_cpu profiled;
+    for (std::uint32_t address = 0; address < 600; address += sizeof(program)) {
+        plain.getMemory().write(address, program, sizeof(program));
+        profiled.getMemory().write(address, program, sizeof(program));
+    }
+
+    EXPECT_EQ(plain.run(300).retiredInstructions, profiled.run(300).retiredInstructions);
+    EXPECT_EQ(plain.getInstructionPtr(), profiled.getInstructionPtr());
+    for (std::uint32_t i = 0; i < cpu::geometry::registersCount; ++i)
+        EXPECT_EQ(plain.getRegisters()[i], profiled.getRegisters()[i]);
+    EXPECT_EQ(profiled.getProfiler().getOperationCount(operation::XOR), 100);
+    EXPECT_TRUE(std::is_empty<no_profiler>::value);
+}
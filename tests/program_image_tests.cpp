@@ -0,0 +1,80 @@
+#include <vector>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "program_image.h"
+#include "cpu.h"
+
+namespace {
+
+constexpr cpu_register_t addOne = 0b0011'1000'0000'0001; // add, dst register 0, immediate value 1
+
+}
+
+TEST(ProgramImageTests, load_maps_aligned_pages_and_sets_entry)
+{
+    const std::string path = testing::TempDir() + "image_load.bin";
+    std::vector<cpu_register_t> code(guest_memory::pageSize + 3, addOne); // two pages and 6 bytes
+    const std::uint8_t data[] = { 1, 2, 3, 4, 5 };
+    ASSERT_EQ(program_image::save(path, 0x1000, {
+        { 0x1000, code.data(), (std::uint32_t)(code.size() * sizeof(cpu_register_t)), 0 },
+        { 0x5003, data, sizeof(data), 16 },
+    }), status::STATUS_OK);
+
+    cpu machine;
+    machine.getMemory().writeByte(0x5010, 0xff);
+    ASSERT_EQ(machine.loadImage(path), status::STATUS_OK);
+    EXPECT_EQ(machine.getInstructionPtr(), 0x1000);
+    EXPECT_FALSE(machine.getMemory().isPrivatePage(1));
+    EXPECT_FALSE(machine.getMemory().isPrivatePage(2));
+    EXPECT_TRUE(machine.getMemory().isPrivatePage(3)); // unaligned tail is copied
+    EXPECT_EQ(machine.getMemory().readWord(0x3004), addOne);
+    EXPECT_EQ(machine.getMemory().readWord(0x3006), 0);
+    EXPECT_EQ(machine.getMemory().readByte(0x5003), 1);
+    EXPECT_EQ(machine.getMemory().readByte(0x5007), 5);
+    EXPECT_EQ(machine.getMemory().readByte(0x5010), 0); // zeroed up to memorySize
+
+    run_result result = machine.run(code.size());
+    EXPECT_EQ(result.retiredInstructions, code.size());
+    EXPECT_EQ(machine.getRegisters()[0], code.size());
+    EXPECT_EQ(machine.getInstructionPtr(), 0x1000 + code.size() * sizeof(cpu_register_t));
+}
+
+TEST(ProgramImageTests, corrupted_image_keeps_memory)
+{
+    const std::string path = testing::TempDir() + "image_corrupted.bin";
+    std::vector<cpu_register_t> code(guest_memory::pageSize / sizeof(cpu_register_t), addOne);
+    ASSERT_EQ(program_image::save(path, 0, {
+        { 0, code.data(), guest_memory::pageSize, 0 },
+    }), status::STATUS_OK);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(guest_memory::pageSize + 100);
+        file.put(0x55);
+    }
+
+    cpu machine;
+    machine.getMemory().writeWord(0, 0x1234);
+    machine.setInstructionPtr(2);
+    EXPECT_EQ(machine.loadImage(path), status::FILE_CHECKSUM_ERROR);
+    EXPECT_EQ(machine.getMemory().readWord(0), 0x1234);
+    EXPECT_EQ(machine.getInstructionPtr(), 2);
+
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.write("CPUIMAH", 8);
+    }
+    EXPECT_EQ(machine.loadImage(path), status::FILE_FORMAT_ERROR);
+    EXPECT_EQ(machine.loadImage(testing::TempDir() + "image_missing.bin"), status::FILE_ACCESS_ERROR);
+}
+
+TEST(ProgramImageTests, checksum_matches_adler32)
+{
+    const char text[] = "Wikipedia";
+    EXPECT_EQ(program_image::checksum(reinterpret_cast<const std::uint8_t*>(text), sizeof(text) - 1), 0x11e60398u);
+    std::vector<std::uint8_t> bytes(100000, 0xff);
+    const std::uint32_t whole = program_image::checksum(bytes.data(), bytes.size());
+    const std::uint32_t parts = program_image::checksum(bytes.data() + 7000, bytes.size() - 7000,
+                                                        program_image::checksum(bytes.data(), 7000));
+    EXPECT_EQ(whole, parts);
+}
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+#include "replay.h"
+
+namespace {
+
+const cpu_register_t program[] = {
+    0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+    0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+    0b0011'1001'0000'0010, // add, dst register 1, immediate value 2
+    0b0101'0011'0000'0000, // mul, dst register 3, src register 0
+};
+const std::uint8_t patch[] = { 1, 2, 3, 4, 5 };
+
+void setUp(cpu& machine)
+{
+    for (std::uint32_t address = 0; address < 0x2000; address += sizeof(program))
+        machine.getMemory().write(address, program, sizeof(program));
+    machine.getRegisters()[1] = 0x8000;
+}
+
+// Same scenario as recorded one, stopped after count instructions
+std::unique_ptr<cpu> runReference(const std::uint64_t count)
+{
+    std::unique_ptr<cpu> machine(new cpu());
+    setUp(*machine);
+    machine->run(std::min<std::uint64_t>(count, 3000));
+    if (count >= 3000) {
+        machine->getMemory().write(0x8100, patch, sizeof(patch));
+        machine->getRegisters()[4] = 77;
+        machine->setInstructionPtr(0x100);
+        machine->run(count - 3000);
+    }
+    return machine;
+}
+
+void expectSameState(const cpu& expected, const cpu& actual)
+{
+    EXPECT_EQ(expected.getInstructionPtr(), actual.getInstructionPtr());
+    for (std::uint32_t index = 0; index < cpu::geometry::registersCount; ++index)
+        EXPECT_EQ(expected.getRegisters()[index], actual.getRegisters()[index]);
+    EXPECT_TRUE(expected.getMemory() == actual.getMemory());
+}
+
+class ReplayTests : public testing::TestWithParam<execution_tier> {};
+
+}
+
+TEST_P(ReplayTests, seek_restores_state_at_any_instruction)
+{
+    replay_recorder recorder(GetParam(), 256);
+    setUp(recorder.getCpu());
+    EXPECT_EQ(recorder.run(3000).retiredInstructions, 3000);
+    recorder.writeMemory(0x8100, patch, sizeof(patch));
+    recorder.setRegister(4, 77);
+    recorder.setInstructionPtr(0x100);
+    EXPECT_EQ(recorder.run(2000).retiredInstructions, 2000);
+    EXPECT_EQ(recorder.getInstructionsCount(), 5000);
+    EXPECT_EQ(recorder.getCheckpointsCount(), 20);
+    EXPECT_EQ(recorder.getInputs().size(), 3);
+
+    for (const std::uint64_t count : { 0, 1, 255, 256, 2999, 3000, 3001, 4500, 5000 }) {
+        std::unique_ptr<cpu> restored;
+        ASSERT_EQ(recorder.seek(count, restored), status::STATUS_OK);
+        expectSameState(*runReference(count), *restored);
+    }
+    std::unique_ptr<cpu> restored;
+    ASSERT_EQ(recorder.seek(5000, restored), status::STATUS_OK);
+    expectSameState(recorder.getCpu(), *restored);
+    EXPECT_EQ(recorder.seek(5001, restored), status::UNKNOWN_ERROR);
+}
+
+TEST_P(ReplayTests, seek_replays_run_stopped_by_error)
+{
+    replay_recorder recorder(GetParam(), 100);
+    setUp(recorder.getCpu());
+    recorder.getCpu().getMemory().writeWord(0x200, 0b0110'1000'0001'0001); // srl, dst register 0, immediate value 17
+    EXPECT_EQ(recorder.run(1000).reason, stop_reason::ERROR);
+    EXPECT_EQ(recorder.getInstructionsCount(), 256);
+    recorder.writeMemory(0x200, program, sizeof(cpu_register_t));
+    EXPECT_EQ(recorder.run(100).retiredInstructions, 100);
+
+    std::unique_ptr<cpu> restored;
+    ASSERT_EQ(recorder.seek(356, restored), status::STATUS_OK);
+    expectSameState(recorder.getCpu(), *restored);
+    ASSERT_EQ(recorder.seek(256, restored), status::STATUS_OK);
+    EXPECT_EQ(restored->getMemory().readWord(0x200), program[0]);
+}
+
+INSTANTIATE_TEST_SUITE_P(Tiers, ReplayTests, testing::Values(execution_tier::INTERPRETER, execution_tier::JIT));
@@ -0,0 +1,111 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "shared_image.h"
+#include "program_image.h"
+#include "cpu_fleet.h"
+#include "cpu.h"
+
+namespace {
+
+constexpr cpu_register_t addOne = 0b0011'1000'0000'0001; // add, dst register 0, immediate value 1
+
+}
+
+TEST(SharedImageTests, cpus_share_pages_until_write)
+{
+    std::vector<cpu_register_t> code(guest_memory::pageSize / 2 + 2, addOne); // one page and 4 bytes
+    const shared_image image = shared_image::fromBuffer(reinterpret_cast<const std::uint8_t*>(code.data()),
+                                                        code.size() * sizeof(cpu_register_t), 0x1000, 0x1000);
+    EXPECT_EQ(image.getPagesCount(), 2);
+
+    std::vector<std::unique_ptr<cpu>> machines;
+    for (std::uint32_t index = 0; index < 4; ++index) {
+        machines.emplace_back(new cpu());
+        machines.back()->mapImage(image);
+        EXPECT_EQ(machines.back()->getInstructionPtr(), 0x1000);
+        EXPECT_EQ(machines.back()->getMemory().getPrivatePagesCount(), 0);
+        EXPECT_EQ(machines.back()->getMemory().getReadPages()[1], machines.front()->getMemory().getReadPages()[1]);
+    }
+
+    cpu& first = *machines.front();
+    EXPECT_EQ(first.run(code.size()).retiredInstructions, code.size());
+    EXPECT_EQ(first.getRegisters()[0], code.size());
+    EXPECT_EQ(first.getMemory().getPrivatePagesCount(), 0); // code is only read
+
+    first.getMemory().writeWord(0x1000, 0);
+    EXPECT_TRUE(first.getMemory().isPrivatePage(1));
+    EXPECT_EQ(machines[1]->getMemory().readWord(0x1000), addOne);
+    EXPECT_EQ(first.getMemory().readWord(0x2000), addOne);
+
+    first.reset();
+    EXPECT_EQ(first.getMemory().readWord(0x2000), 0);
+    EXPECT_EQ(machines[1]->getMemory().readWord(0x2000), addOne);
+}
+
+TEST(SharedImageTests, image_outlives_source)
+{
+    shared_image image;
+    {
+        guest_memory memory;
+        memory.writeWord(0x4000, addOne);
+        memory.writeWord(0xfffe, addOne);
+        image = shared_image::fromMemory(memory, 0x4000);
+    }
+    EXPECT_EQ(image.getPagesCount(), 2);
+
+    cpu machine;
+    machine.mapImage(image);
+    image = shared_image();
+    EXPECT_EQ(machine.getMemory().readWord(0x4000), addOne);
+    EXPECT_EQ(machine.getMemory().readWord(0xfffe), addOne);
+    EXPECT_EQ(machine.run(1).retiredInstructions, 1);
+}
+
+TEST(SharedImageTests, load_matches_program_image)
+{
+    const std::string path = testing::TempDir() + "shared_image_load.bin";
+    std::vector<cpu_register_t> code(100, addOne);
+    const std::uint8_t data[] = { 1, 2, 3 };
+    ASSERT_EQ(program_image::save(path, 0x0200, {
+        { 0x0200, code.data(), (std::uint32_t)(code.size() * sizeof(cpu_register_t)), 0 },
+        { 0x7003, data, sizeof(data), 0 },
+    }), status::STATUS_OK);
+
+    shared_image image;
+    ASSERT_EQ(shared_image::load(path, image), status::STATUS_OK);
+    EXPECT_EQ(image.getPagesCount(), 2);
+    EXPECT_EQ(shared_image::load(path + ".missing", image), status::FILE_ACCESS_ERROR);
+
+    cpu loaded;
+    cpu mapped;
+    ASSERT_EQ(loaded.loadImage(path), status::STATUS_OK);
+    mapped.mapImage(image);
+    EXPECT_EQ(mapped.getInstructionPtr(), loaded.getInstructionPtr());
+    EXPECT_TRUE(mapped.getMemory() == loaded.getMemory());
+}
+
+TEST(SharedImageTests, fleet_jobs_of_one_program_share_pages)
+{
+    std::vector<cpu_register_t> code(guest_memory::pageSize, addOne); // two pages
+    code.back() = 0b0001'0010'0000'0000; // st, dst register 1, src register 0, immediate value 0
+    const std::uint8_t* const program = reinterpret_cast<const std::uint8_t*>(code.data());
+
+    cpu_fleet fleet(2, 1000);
+    for (std::uint32_t job = 0; job < 16; ++job)
+        fleet.addJob({ program, (std::uint32_t)(code.size() * sizeof(cpu_register_t)), 0, 0, code.size() });
+    std::vector<std::uint32_t> privatePages(16);
+    std::vector<const std::uint8_t*> codePages(16);
+    fleet.setCompletionHandler([&](const std::size_t job, const cpu& machine) {
+        privatePages[job] = machine.getMemory().getPrivatePagesCount();
+        codePages[job] = machine.getMemory().getReadPages()[1];
+    });
+    fleet.run();
+
+    for (std::uint32_t job = 0; job < 16; ++job) {
+        EXPECT_EQ(fleet.getResults()[job].result.retiredInstructions, code.size());
+        EXPECT_EQ(fleet.getResults()[job].registers[0], code.size() - 1);
+        EXPECT_EQ(privatePages[job], 1); // only page written by store at address 0
+        EXPECT_EQ(codePages[job], codePages[0]);
+    }
+}
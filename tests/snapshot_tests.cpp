@@ -0,0 +1,92 @@
+#include <memory>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "snapshot.h"
+#include "cpu.h"
+
+namespace {
+
+void loadCounterProgram(cpu& machine)
+{
+    const cpu_register_t program[] = {
+        0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+        0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+        0b0011'1001'0000'0010, // add, dst register 1, immediate value 2
+    };
+    for (std::uint32_t address = 0; address < 3000; address += sizeof(program))
+        machine.getMemory().write(address, program, sizeof(program));
+    machine.getRegisters()[1] = 0x8000;
+}
+
+}
+
+class SnapshotTests : public testing::TestWithParam<execution_tier> {};
+
+TEST_P(SnapshotTests, restored_cpu_continues_from_same_state)
+{
+    const std::string path = testing::TempDir() + "snapshot_round_trip.bin";
+    cpu machine(GetParam());
+    loadCounterProgram(machine);
+    machine.run(300);
+    machine.getVectorRegister(3)[15] = 0x5a;
+    ASSERT_EQ(machine.saveSnapshot(path), status::STATUS_OK);
+
+    cpu restored(GetParam());
+    ASSERT_EQ(restored.loadSnapshot(path), status::STATUS_OK);
+    EXPECT_EQ(restored.getInstructionPtr(), machine.getInstructionPtr());
+    EXPECT_EQ(restored.getVectorRegister(3)[15], 0x5a);
+    EXPECT_EQ(restored.getMemory().getPrivatePagesCount(), 0);
+    EXPECT_TRUE(restored.getMemory() == machine.getMemory());
+
+    run_result result = machine.run(300);
+    run_result restoredResult = restored.run(300);
+    EXPECT_EQ(restoredResult.retiredInstructions, result.retiredInstructions);
+    EXPECT_EQ(restored.getInstructionPtr(), machine.getInstructionPtr());
+    for (std::uint32_t i = 0; i < cpu::geometry::registersCount; ++i)
+        EXPECT_EQ(restored.getRegisters()[i], machine.getRegisters()[i]);
+    EXPECT_TRUE(restored.getMemory() == machine.getMemory());
+    EXPECT_EQ(restored.getMemory().getPrivatePagesCount(), 1); // only stored page is copied
+}
+
+INSTANTIATE_TEST_SUITE_P(Tiers, SnapshotTests, testing::Values(execution_tier::INTERPRETER, execution_tier::JIT));
+
+TEST(SnapshotFileTests, writes_do_not_reach_file)
+{
+    const std::string path = testing::TempDir() + "snapshot_private.bin";
+    cpu machine;
+    machine.getMemory().writeWord(0x2000, 0x1234);
+    ASSERT_EQ(machine.saveSnapshot(path), status::STATUS_OK);
+
+    cpu first;
+    ASSERT_EQ(first.loadSnapshot(path), status::STATUS_OK);
+    first.getMemory().writeWord(0x2000, 0x5678);
+    EXPECT_EQ(first.getMemory().readWord(0x2000), 0x5678);
+
+    cpu second;
+    ASSERT_EQ(second.loadSnapshot(path), status::STATUS_OK);
+    EXPECT_EQ(second.getMemory().readWord(0x2000), 0x1234);
+
+    std::unique_ptr<cpu> copy = second.clone();
+    EXPECT_EQ(copy->getMemory().readWord(0x2000), 0x1234);
+}
+
+TEST(SnapshotFileTests, rejects_bad_files)
+{
+    const std::string path = testing::TempDir() + "snapshot_bad.bin";
+    cpu machine;
+    ASSERT_EQ(machine.saveSnapshot(path), status::STATUS_OK);
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        file.write("CPUSNAQ", 8);
+    }
+    EXPECT_EQ(machine.loadSnapshot(path), status::FILE_FORMAT_ERROR);
+
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(snapshot_header::magicValue, sizeof(snapshot_header::magicValue));
+    }
+    EXPECT_EQ(machine.loadSnapshot(path), status::FILE_FORMAT_ERROR);
+
+    EXPECT_EQ(machine.loadSnapshot(testing::TempDir() + "snapshot_missing.bin"), status::FILE_ACCESS_ERROR);
+}
@@ -0,0 +1,155 @@
+#include <array>
+#include <random>
+#include <vector>
+#include <fstream>
+
+#include "gtest/gtest.h"
+#include "lz_codec.h"
+#include "trace.h"
+#include "cpu.h"
+
+namespace {
+
+const cpu_register_t program[] = {
+    0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+    0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+    0b0000'0100'0100'0000, // ld, dst register 2, src register 1, immediate value 0
+    0b0101'0011'0000'0000, // mul, dst register 3, src register 0
+};
+
+struct reference_step {
+    std::uint32_t address;
+    std::array<cpu_register_t, cpu::geometry::registersCount> registers; // after execution
+};
+
+// Same scenario for traced and plain cpu: straight code, jump back and
+// load of the last memory byte
+template <typename Machine, typename Step>
+void runScenario(Machine& machine, Step step)
+{
+    for (std::uint32_t address = 0; address < 0x2000; address += sizeof(program))
+        machine.getMemory().write(address, program, sizeof(program));
+    machine.getRegisters()[1] = 0x8000;
+    step(machine, 3000);
+    machine.setInstructionPtr(4);
+    machine.getRegisters()[1] = 0xffff;
+    step(machine, 1);
+    machine.setInstructionPtr(0x100);
+    machine.getRegisters()[1] = 0x9000;
+    step(machine, 100);
+}
+
+}
+
+TEST(TraceTests, lz_codec_round_trip)
+{
+    std::vector<std::uint8_t> repetitive(100000);
+    for (std::size_t index = 0; index < repetitive.size(); ++index)
+        repetitive[index] = (index % 12) * 7;
+    std::vector<std::uint8_t> random(5000);
+    std::mt19937 generator(1);
+    for (std::uint8_t& byte : random)
+        byte = generator();
+
+    for (const std::vector<std::uint8_t>* data : { &repetitive, &random }) {
+        std::vector<std::uint8_t> compressed;
+        lz_codec::compress(data->data(), data->size(), compressed);
+        std::vector<std::uint8_t> decompressed(data->size());
+        ASSERT_TRUE(lz_codec::decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size()));
+        EXPECT_EQ(decompressed, *data);
+        EXPECT_FALSE(lz_codec::decompress(compressed.data(), compressed.size() - 1, decompressed.data(),
+                                          decompressed.size()));
+    }
+    std::vector<std::uint8_t> compressed;
+    lz_codec::compress(repetitive.data(), repetitive.size(), compressed);
+    EXPECT_LT(compressed.size(), repetitive.size() / 50);
+}
+
+TEST(TraceTests, trace_matches_single_stepped_cpu)
+{
+    const std::string path = testing::TempDir() + "trace_run.bin";
+    traced_cpu traced(execution_tier::JIT);
+    runScenario(traced, [&path](traced_cpu& machine, const std::uint64_t count) {
+        if (!machine.getProfiler().isOpen()) {
+            ASSERT_EQ(machine.getProfiler().open(path, machine.getRegisters(), 256), status::STATUS_OK);
+        }
+        EXPECT_EQ(machine.run(count).retiredInstructions, count);
+    });
+    ASSERT_EQ(traced.getProfiler().close(), status::STATUS_OK);
+    EXPECT_EQ(traced.getProfiler().getRecordedInstructions(), 3101);
+
+    std::vector<reference_step> reference;
+    cpu plain;
+    runScenario(plain, [&reference](cpu& machine, const std::uint64_t count) {
+        for (std::uint64_t index = 0; index < count; ++index) {
+            reference_step step = { machine.getInstructionPtr(), {} };
+            machine.run(1);
+            std::copy(machine.getRegisters(), machine.getRegisters() + step.registers.size(), step.registers.begin());
+            reference.push_back(step);
+        }
+    });
+
+    trace_reader reader;
+    ASSERT_EQ(reader.open(path), status::STATUS_OK);
+    ASSERT_EQ(reader.getInstructionsCount(), reference.size());
+    trace_entry entry;
+    std::uint64_t stores = 0;
+    for (std::size_t index = 0; index < reference.size(); ++index) {
+        ASSERT_TRUE(reader.next(entry));
+        EXPECT_EQ(entry.index, index);
+        ASSERT_EQ(entry.address, reference[index].address);
+        EXPECT_EQ(entry.instruction, plain.getMemory().readWord(entry.address));
+        if (entry.hasRegisterWrite) {
+            ASSERT_EQ(entry.registerValue, reference[index].registers[entry.registerIndex]);
+        }
+        if (entry.isStore) {
+            EXPECT_EQ(entry.memoryAddress, reference[index].registers[1]);
+            EXPECT_EQ(entry.memoryValue, reference[index].registers[0]);
+            ++stores;
+        }
+    }
+    EXPECT_FALSE(reader.next(entry));
+    EXPECT_EQ(stores, 775);
+
+    ASSERT_EQ(reader.seek(3000), status::STATUS_OK);
+    ASSERT_TRUE(reader.next(entry));
+    EXPECT_EQ(entry.address, 4);
+    EXPECT_TRUE(entry.hasMemoryAccess);
+    EXPECT_FALSE(entry.isStore);
+    EXPECT_EQ(entry.memoryAddress, 0xffff);
+    EXPECT_EQ(entry.st, status::LAST_MEMORY_BYTE_WARNING);
+    ASSERT_TRUE(reader.next(entry));
+    EXPECT_EQ(entry.address, 0x100);
+    EXPECT_EQ(entry.registerValue, reference[3001].registers[0]);
+}
+
+TEST(TraceTests, reader_rejects_broken_files)
+{
+    trace_reader reader;
+    EXPECT_EQ(reader.open(testing::TempDir() + "trace_missing.bin"), status::FILE_ACCESS_ERROR);
+
+    const std::string path = testing::TempDir() + "trace_broken.bin";
+    {
+        traced_cpu machine;
+        for (std::uint32_t address = 0; address < 0x1000; address += sizeof(program))
+            machine.getMemory().write(address, program, sizeof(program));
+        ASSERT_EQ(machine.getProfiler().open(path, machine.getRegisters(), 64), status::STATUS_OK);
+        machine.run(1000);
+    } // recorder closes the trace
+
+    std::vector<char> content;
+    {
+        std::ifstream file(path, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    ASSERT_EQ(reader.open(path), status::STATUS_OK);
+    EXPECT_EQ(reader.getInstructionsCount(), 1000);
+
+    // Byte in compressed records of the first chunk
+    content[sizeof(trace_file_header) + sizeof(trace_chunk_header) + 2] ^= 0x55;
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(content.data(), content.size());
+    EXPECT_EQ(reader.open(path), status::FILE_CHECKSUM_ERROR);
+
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(content.data(), content.size() - 1);
+    EXPECT_EQ(reader.open(path), status::FILE_FORMAT_ERROR);
+}
@@ -0,0 +1,189 @@
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include "gtest/gtest.h"
+#include "translation_cache.h"
+#include "decode_table.h"
+#include "cpu_fleet.h"
+#include "jit.h"
+#include "cpu.h"
+
+namespace {
+
+// Loop of 100 iterations, then branch on carry which reads flags through helper call
+const cpu_register_t program[] = {
+    0b0010'0010'0110'0100, // ldi lower, dst register 1, immediate value 100
+    0b0011'1000'0000'0011, // add, dst register 0, immediate value 3
+    0b0100'1001'0000'0001, // sub, dst register 1, immediate value 1
+    0b1101'0011'1111'1110, // branch if zero flag is clear, offset -2
+    0b1101'1000'0000'0010, // branch if carry flag is set, offset 2
+    0b0011'1010'0000'0001, // add, dst register 2, immediate value 1
+};
+constexpr std::uint64_t programInstructions = 303;
+
+void expectProgramDone(const cpu& machine)
+{
+    EXPECT_EQ(machine.getRegisters()[0], 300);
+    EXPECT_EQ(machine.getRegisters()[1], 0);
+    EXPECT_EQ(machine.getRegisters()[2], 1);
+    EXPECT_EQ(machine.getInstructionPtr(), sizeof(program));
+}
+
+std::string saveTranslations(const std::string& name)
+{
+    const std::string path = testing::TempDir() + name;
+    cpu machine(execution_tier::JIT);
+    machine.getMemory().write(0, program, sizeof(program));
+    EXPECT_EQ(machine.run(programInstructions).retiredInstructions, programInstructions);
+    expectProgramDone(machine);
+    EXPECT_EQ(machine.saveTranslations(path), status::STATUS_OK);
+    return path;
+}
+
+}
+
+TEST(TranslationCacheTests, warm_start_runs_loaded_translations)
+{
+    const std::string path = saveTranslations("translations_warm.jit");
+
+    cpu_base_properties properties;
+    jit_engine engine(properties, instructions::decode_table::getTable(properties));
+    guest_memory memory;
+    memory.write(0, program, sizeof(program));
+    ASSERT_EQ(engine.load(path, memory), status::STATUS_OK);
+    EXPECT_TRUE(engine.isCodeAddress(0));
+    EXPECT_NE(engine.getBlock(2, memory), nullptr);
+
+    cpu machine(execution_tier::JIT);
+    machine.getMemory().write(0, program, sizeof(program));
+    ASSERT_EQ(machine.loadTranslations(path), status::STATUS_OK);
+    EXPECT_EQ(machine.run(programInstructions).retiredInstructions, programInstructions);
+    expectProgramDone(machine);
+
+    // Loaded translations are invalidated by stores into code as usual
+    machine.getMemory().writeWord(sizeof(program), 0b0001'0111'0000'0000); // st, dst register 3, src register 4
+    machine.invalidateCode(sizeof(program), sizeof(cpu_register_t));
+    machine.getRegisters()[3] = 2;
+    machine.getRegisters()[4] = 0b0011'1000'0000'0101; // add, dst register 0, immediate value 5
+    EXPECT_EQ(machine.run(1).retiredInstructions, 1);
+    machine.setInstructionPtr(0);
+    machine.getRegisters()[0] = 0;
+    EXPECT_EQ(machine.run(programInstructions).retiredInstructions, programInstructions);
+    EXPECT_EQ(machine.getRegisters()[0], 500);
+}
+
+TEST(TranslationCacheTests, changed_code_is_stale)
+{
+    const std::string path = saveTranslations("translations_stale.jit");
+
+    cpu machine(execution_tier::JIT);
+    machine.getMemory().write(0, program, sizeof(program));
+    machine.getMemory().writeWord(2, 0b0011'1000'0000'0100); // add, dst register 0, immediate value 4
+    EXPECT_EQ(machine.loadTranslations(path), status::FILE_STALE_ERROR);
+    EXPECT_EQ(machine.run(programInstructions).retiredInstructions, programInstructions);
+    EXPECT_EQ(machine.getRegisters()[0], 400);
+}
+
+TEST(TranslationCacheTests, damaged_file_is_rejected)
+{
+    const std::string path = saveTranslations("translations_damaged.jit");
+    std::vector<char> data(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(data.data(), data.size());
+
+    cpu machine(execution_tier::JIT);
+    machine.getMemory().write(0, program, sizeof(program));
+    const std::string damagedPath = path + ".damaged";
+    std::vector<char> damaged = data;
+    damaged.back() ^= 0x1;
+    std::ofstream(damagedPath, std::ios::binary | std::ios::trunc).write(damaged.data(), damaged.size());
+    EXPECT_EQ(machine.loadTranslations(damagedPath), status::FILE_CHECKSUM_ERROR);
+
+    std::ofstream(damagedPath, std::ios::binary | std::ios::trunc).write(data.data(), data.size() - 1);
+    EXPECT_EQ(machine.loadTranslations(damagedPath), status::FILE_FORMAT_ERROR);
+
+    damaged = data;
+    damaged[offsetof(translation_cache_header, registersCount)] ^= 0x1;
+    std::ofstream(damagedPath, std::ios::binary | std::ios::trunc).write(damaged.data(), damaged.size());
+    EXPECT_EQ(machine.loadTranslations(damagedPath), status::FILE_FORMAT_ERROR);
+
+    damaged = data;
+    damaged[offsetof(translation_cache_header, buildFingerprint)] ^= 0x1; // made by other build
+    std::ofstream(damagedPath, std::ios::binary | std::ios::trunc).write(damaged.data(), damaged.size());
+    EXPECT_EQ(machine.loadTranslations(damagedPath), status::FILE_FORMAT_ERROR);
+
+    EXPECT_EQ(machine.loadTranslations(path + ".missing"), status::FILE_ACCESS_ERROR);
+    EXPECT_EQ(cpu().loadTranslations(path), status::UNKNOWN_ERROR);
+
+    EXPECT_EQ(machine.run(programInstructions).retiredInstructions, programInstructions);
+    expectProgramDone(machine);
+}
+
+#if defined(__unix__)
+TEST(TranslationCacheTests, file_writable_by_others_is_rejected)
+{
+    using std::filesystem::perms;
+
+    const std::string path = saveTranslations("translations_writable.jit");
+    EXPECT_EQ(std::filesystem::status(path).permissions() & (perms::group_write | perms::others_write), perms::none);
+
+    cpu machine(execution_tier::JIT);
+    machine.getMemory().write(0, program, sizeof(program));
+    for (const perms permission : { perms::group_write, perms::others_write }) {
+        std::filesystem::permissions(path, permission, std::filesystem::perm_options::add);
+        EXPECT_EQ(machine.loadTranslations(path), status::FILE_ACCESS_ERROR);
+        std::filesystem::permissions(path, permission, std::filesystem::perm_options::remove);
+    }
+    EXPECT_EQ(machine.loadTranslations(path), status::STATUS_OK);
+}
+#endif
+
+TEST(TranslationCacheTests, fleet_saves_and_reuses_translations)
+{
+    const std::filesystem::path directory = std::filesystem::path(testing::TempDir()) / "fleet_translations";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    const std::uint8_t* const image = reinterpret_cast<const std::uint8_t*>(program);
+    const std::uint32_t jobsCount = 8;
+
+    auto runFleet = [&]() {
+        cpu_fleet fleet(2, 50, execution_tier::JIT);
+        fleet.setTranslationCache(directory.string());
+        for (std::uint32_t job = 0; job < jobsCount; ++job)
+            fleet.addJob({ image, sizeof(program), 0, 0, programInstructions });
+        const fleet_stats stats = fleet.run();
+        for (const fleet_job_result& result : fleet.getResults()) {
+            EXPECT_EQ(result.result.retiredInstructions, programInstructions);
+            EXPECT_EQ(result.registers[0], 300);
+            EXPECT_EQ(result.instructionPtr, sizeof(program));
+        }
+        EXPECT_EQ(std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator()), 1);
+        return stats;
+    };
+
+    // Jobs started before the first save translate on their own
+    fleet_stats stats = runFleet();
+    EXPECT_LT(stats.cacheHits, jobsCount);
+    EXPECT_EQ(stats.cacheSaves, 1);
+
+    stats = runFleet();
+    EXPECT_EQ(stats.cacheHits, jobsCount);
+    EXPECT_EQ(stats.cacheSaves, 0);
+
+    // Damaged file is rejected and written again, jobs started after that load it
+    const std::filesystem::path path = std::filesystem::directory_iterator(directory)->path();
+    std::vector<char> data(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(data.data(), data.size());
+    data.back() ^= 0x1;
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), data.size());
+    stats = runFleet();
+    EXPECT_LT(stats.cacheHits, jobsCount);
+    EXPECT_EQ(stats.cacheSaves, 1);
+    std::vector<char> rewritten(std::filesystem::file_size(path));
+    std::ifstream(path, std::ios::binary).read(rewritten.data(), rewritten.size());
+    EXPECT_NE(rewritten, data);
+
+    stats = runFleet();
+    EXPECT_EQ(stats.cacheHits, jobsCount);
+    EXPECT_EQ(stats.cacheSaves, 0);
+}
@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+#include "undo_log.h"
+#include "program_image.h"
+#include "shared_image.h"
+#include "cpu.h"
+
+namespace {
+
+const cpu_register_t program[] = {
+    0b0011'1000'0000'0001, // add, dst register 0, immediate value 1
+    0b0001'0010'0000'0000, // st, dst register 1, src register 0, immediate value 0
+    0b0000'0100'0100'0000, // ld, dst register 2, src register 1, immediate value 0
+    0b0011'1001'0000'0001, // add, dst register 1, immediate value 1
+};
+
+template <typename Machine>
+void setUp(Machine& machine)
+{
+    for (std::uint32_t address = 0; address < 0x1000; address += sizeof(program))
+        machine.getMemory().write(address, program, sizeof(program));
+    machine.getRegisters()[1] = 0xfff0; // stores overlap and reach the last memory byte
+}
+
+template <typename Expected, typename Actual>
+void expectSameState(const Expected& expected, const Actual& actual)
+{
+    EXPECT_EQ(expected.getInstructionPtr(), actual.getInstructionPtr());
+    for (std::uint32_t index = 0; index < cpu::geometry::registersCount; ++index)
+        EXPECT_EQ(expected.getRegisters()[index], actual.getRegisters()[index]);
+    EXPECT_TRUE(expected.getMemory() == actual.getMemory());
+}
+
+}
+
+TEST(UndoLogTests, step_back_restores_previous_states)
+{
+    reversible_cpu machine;
+    setUp(machine);
+    ASSERT_EQ(machine.run(64).retiredInstructions, 64);
+    EXPECT_EQ(machine.getProfiler().getSize(), 64);
+
+    for (const std::uint64_t count : { 63, 60, 33, 32, 1, 0 }) {
+        const std::uint64_t retired = 64 - machine.getProfiler().getSize();
+        EXPECT_EQ(machine.stepBack(64 - retired - count), 64 - retired - count);
+        cpu expected;
+        setUp(expected);
+        expected.run(count);
+        expectSameState(expected, machine);
+    }
+    EXPECT_EQ(machine.stepBack(1), 0);
+
+    // History continues from the reverted state
+    ASSERT_EQ(machine.run(10).retiredInstructions, 10);
+    EXPECT_EQ(machine.stepBack(5), 5);
+    cpu expected;
+    setUp(expected);
+    expected.run(5);
+    expectSameState(expected, machine);
+}
+
+TEST(UndoLogTests, history_is_limited_by_capacity)
+{
+    reversible_cpu machine;
+    machine.getProfiler() = undo_log(10);
+    setUp(machine);
+    ASSERT_EQ(machine.run(50).retiredInstructions, 50);
+    EXPECT_EQ(machine.stepBack(100), 10);
+    cpu expected;
+    setUp(expected);
+    expected.run(40);
+    expectSameState(expected, machine);
+
+    // Instruction which ended with error is not recorded
+    machine.getMemory().writeWord(0x100, 0b0110'1000'0001'0001); // srl, dst register 0, immediate value 17
+    machine.setInstructionPtr(0x100);
+    EXPECT_EQ(machine.run(1).reason, stop_reason::ERROR);
+    EXPECT_EQ(machine.getProfiler().getSize(), 0);
+
+    cpu plain;
+    EXPECT_EQ(plain.stepBack(1), 0);
+}
+
+// Loaded state replaces everything history was recorded for
+TEST(UndoLogTests, loading_state_clears_history)
+{
+    const std::string snapshotPath = testing::TempDir() + "undo_log_snapshot.bin";
+    const std::string imagePath = testing::TempDir() + "undo_log_image.bin";
+    {
+        reversible_cpu source;
+        setUp(source);
+        ASSERT_EQ(source.saveSnapshot(snapshotPath), status::STATUS_OK);
+    }
+    ASSERT_EQ(program_image::save(imagePath, 0, { { 0, program, sizeof(program), 0 } }), status::STATUS_OK);
+    const shared_image image = shared_image::fromBuffer(reinterpret_cast<const std::uint8_t*>(program),
+                                                        sizeof(program), 0, 0);
+
+    for (std::uint32_t load = 0; load < 3; ++load) {
+        reversible_cpu machine;
+        setUp(machine);
+        ASSERT_EQ(machine.run(16).retiredInstructions, 16);
+        ASSERT_EQ(machine.getProfiler().getSize(), 16);
+        if (load == 0) {
+            ASSERT_EQ(machine.loadSnapshot(snapshotPath), status::STATUS_OK);
+        }
+        else if (load == 1) {
+            ASSERT_EQ(machine.loadImage(imagePath), status::STATUS_OK);
+        }
+        else {
+            machine.mapImage(image);
+        }
+        EXPECT_EQ(machine.getProfiler().getSize(), 0) << load;
+        EXPECT_EQ(machine.stepBack(1), 0) << load;
+    }
+}